@@ -0,0 +1,87 @@
+#include "AssetStreamer.h"
+
+#include <algorithm>
+
+AssetStreamer::AssetStreamer(const size_t threads_count)
+{
+  size_t count = threads_count;
+  if (count == 0)
+    count = std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 5) - 1;
+
+  for (size_t i = 0; i < count; ++i)
+    workers.emplace_back(&AssetStreamer::Worker, this);
+}
+
+AssetStreamer::~AssetStreamer()
+{
+  Stop();
+}
+
+void AssetStreamer::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    stop = true;
+    jobs.clear();
+  }
+  jobs_condition.notify_all();
+
+  for (auto &worker : workers)
+  {
+    if (worker.joinable())
+      worker.join();
+  }
+}
+
+void AssetStreamer::Enqueue(std::function<void()> job)
+{
+  pending++;
+  {
+    std::lock_guard<std::mutex> lock(jobs_mutex);
+    jobs.push_back(std::move(job));
+  }
+  jobs_condition.notify_one();
+}
+
+void AssetStreamer::Complete(std::function<void()> callback)
+{
+  std::lock_guard<std::mutex> lock(results_mutex);
+  results.push_back(std::move(callback));
+}
+
+size_t AssetStreamer::Update()
+{
+  {
+    std::lock_guard<std::mutex> lock(results_mutex);
+    if (results.empty())
+      return 0;
+    running_results.swap(results);
+  }
+
+  for (auto &callback : running_results)
+    callback();
+
+  size_t count = running_results.size();
+  running_results.clear();
+  return count;
+}
+
+void AssetStreamer::Worker()
+{
+  while (true)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(jobs_mutex);
+      jobs_condition.wait(lock, [this] { return stop || !jobs.empty(); });
+      if (stop)
+        return;
+
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    job();
+    pending--;
+  }
+}
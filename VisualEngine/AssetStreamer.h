@@ -0,0 +1,46 @@
+#ifndef __VISUALENGINE_ASSETSTREAMER_H
+#define __VISUALENGINE_ASSETSTREAMER_H
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <atomic>
+
+// Worker threads for decoding and uploading assets. Jobs run on a worker and
+// hand their results back through Complete(), those callbacks run on the render
+// thread inside Update() so render state is only ever touched there.
+class AssetStreamer
+{
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> jobs;
+  std::mutex jobs_mutex;
+  std::condition_variable jobs_condition;
+  bool stop = false;
+
+  std::mutex results_mutex;
+  std::vector<std::function<void()>> results;
+  std::vector<std::function<void()>> running_results;
+  std::atomic<size_t> pending = 0;
+
+  void Worker();
+public:
+  AssetStreamer(const size_t threads_count = 0);
+  AssetStreamer(const AssetStreamer &obj) = delete;
+  AssetStreamer &operator=(const AssetStreamer &obj) = delete;
+  ~AssetStreamer();
+
+  // Waits for running jobs, queued jobs and undelivered results are dropped. Running jobs may
+  // still call Complete() until it returns, so the streamer has to outlive it.
+  void Stop();
+
+  void Enqueue(std::function<void()> job);
+  void Complete(std::function<void()> callback);
+  size_t Update();
+  bool IsIdle() const { return pending == 0; }
+};
+
+#endif
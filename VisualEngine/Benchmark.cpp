@@ -0,0 +1,256 @@
+#include "Benchmark.h"
+#include "Mesh.h"
+#include "engine.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <string>
+#include <omp.h>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace
+{
+  double ImportTime(const std::filesystem::path obj_file, const bool parallel, MeshData &out_mesh)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    if (!ImportObj(obj_file, obj_file.parent_path(), out_mesh, parallel))
+      return -1.0;
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+  }
+}
+
+int Benchmark::ObjImport(const std::filesystem::path obj_file, const size_t runs)
+{
+  MeshData sequential, parallel;
+  double sequential_best = -1.0, parallel_best = -1.0;
+
+  for (size_t i = 0; i < std::max<size_t>(runs, 1); ++i)
+  {
+    double s = ImportTime(obj_file, false, sequential);
+    double p = ImportTime(obj_file, true, parallel);
+    if (s < 0.0 || p < 0.0)
+    {
+      std::cerr << "Failed to import " << obj_file << std::endl;
+      return 1;
+    }
+    sequential_best = sequential_best < 0.0 ? s : std::min(sequential_best, s);
+    parallel_best = parallel_best < 0.0 ? p : std::min(parallel_best, p);
+  }
+
+  bool same = sequential.vertices.size() == parallel.vertices.size() && sequential.indices == parallel.indices;
+  for (size_t i = 0; same && i < sequential.vertices.size(); ++i)
+    same = sequential.vertices[i] == parallel.vertices[i];
+
+  std::cout << obj_file.filename().string() << ": " << sequential.indices.size() / 3 << " triangles, "
+            << sequential.vertices.size() << " unique vertices" << std::endl;
+  std::cout << "  sequential (unordered_map): " << sequential_best << " ms" << std::endl;
+  std::cout << "  parallel (" << omp_get_max_threads() << " threads, open addressing): " << parallel_best << " ms" << std::endl;
+  std::cout << "  speedup: " << sequential_best / parallel_best << "x, output " << (same ? "identical" : "DIFFERENT") << std::endl;
+
+  return same ? 0 : 1;
+}
+
+int Benchmark::Startup(int argc, char const *argv[], const size_t runs)
+{
+  // The mode switch itself is not an engine argument.
+  std::vector<char const*> args(argv, argv + argc);
+  args.erase(std::remove_if(args.begin() + 1, args.end(), [](char const *arg) { return std::string(arg) == "--bench-startup"; }), args.end());
+  args.push_back("--exit-after-first-frame");
+
+  // Drivers keep shader caches of their own (Mesa, NVIDIA), disable them for a true cold start.
+  // They read these when the device is created, so every run measures only our pipeline cache.
+  setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+  setenv("__GL_SHADER_DISK_CACHE", "0", 1);
+
+  StartupStats cold_best, warm_best;
+  for (size_t i = 0; i < std::max<size_t>(runs, 1); ++i)
+  {
+    for (bool cold : {true, false})
+    {
+      std::vector<char const*> run_args(args);
+      if (cold)
+        run_args.push_back("--cold-pipeline-cache");
+
+      StartupStats stats;
+      {
+        VisualEngine engine((int) run_args.size(), run_args.data());
+        engine.Start();
+        stats = engine.GetStartupStats();
+      }
+
+      if (cold == stats.warm_pipeline_cache)
+      {
+        std::cerr << "Pipeline cache was " << (cold ? "warm on a cold run" : "cold on a warm run") << std::endl;
+        return 1;
+      }
+
+      StartupStats &best = cold ? cold_best : warm_best;
+      if (i == 0 || stats.pipeline_ms < best.pipeline_ms)
+        best.pipeline_ms = stats.pipeline_ms;
+      if (i == 0 || stats.first_frame_ms < best.first_frame_ms)
+        best.first_frame_ms = stats.first_frame_ms;
+    }
+  }
+
+  std::cout << "startup, best of " << std::max<size_t>(runs, 1) << std::endl;
+  std::cout << "  cold cache: pipeline " << cold_best.pipeline_ms << " ms, first frame " << cold_best.first_frame_ms << " ms" << std::endl;
+  std::cout << "  warm cache: pipeline " << warm_best.pipeline_ms << " ms, first frame " << warm_best.first_frame_ms << " ms" << std::endl;
+  std::cout << "  pipeline speedup: " << cold_best.pipeline_ms / std::max(warm_best.pipeline_ms, 1e-3) << "x" << std::endl;
+  return 0;
+}
+
+int Benchmark::Headless(int argc, char const *argv[])
+{
+  size_t frames = 600;
+  size_t captures = 4;
+  double budget_p95 = 0.0;
+  std::filesystem::path output = "benchmark";
+  std::filesystem::path reference;
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--frames")
+      frames = std::max<size_t>(std::stoul(argv[++i]), 1);
+    else if (arg == "--captures")
+      captures = std::stoul(argv[++i]);
+    else if (arg == "--output")
+      output = argv[++i];
+    else if (arg == "--reference")
+      reference = argv[++i];
+    else if (arg == "--budget-p95")
+      budget_p95 = std::stod(argv[++i]);
+  }
+
+  std::error_code err;
+  std::filesystem::create_directories(output, err);
+  if (err)
+  {
+    std::cerr << "Failed to create " << output << std::endl;
+    return 1;
+  }
+
+  std::vector<char const*> args(argv, argv + argc);
+  args.push_back("--headless");
+  VisualEngine engine((int) args.size(), args.data());
+  engine.WaitForAssets();
+
+  // One orbit around the scene over the whole run, with a slow bob so the LOD mix changes.
+  const float radius = std::max(engine.GetSceneRadius() * 1.5f, 14.142f);
+  auto set_camera = [&](const size_t frame)
+  {
+    const float angle = 6.2831853f * (float) frame / (float) frames;
+    const float height = radius * 0.7f + radius * 0.2f * std::sin(2.0f * angle);
+    engine.SetCamera(glm::vec3(radius * std::cos(angle), height, radius * std::sin(angle)), glm::vec3(0.0f, 1.0f, 0.0f));
+  };
+
+  // Warm-up frames settle pipeline creation, caches and clocks before anything is measured.
+  for (size_t f = 0; f < std::min<size_t>(frames, 30); ++f)
+  {
+    set_camera(f);
+    engine.RenderFrame();
+  }
+
+  FrameStats &stats = engine.GetFrameStats();
+  stats.Reset(frames);
+  for (size_t f = 0; f < frames; ++f)
+  {
+    set_camera(f);
+    engine.RenderFrame();
+  }
+
+  SeriesSummary frame = stats.Summary(FrameStats::frame_series);
+  std::cout << "headless, " << frames << " frames at " << engine.GetFrameExtent().width << "x" << engine.GetFrameExtent().height << std::endl;
+  std::cout << "  frame: mean " << frame.mean << " ms, p50 " << frame.p50 << " ms, p95 " << frame.p95 << " ms, p99 " << frame.p99
+            << " ms, max " << frame.max << " ms, " << stats.Stutters() << " stutters" << std::endl;
+  if (!stats.Export(output / "stats.json") || !stats.Export(output / "frames.csv"))
+    std::cerr << "Failed to write statistics into " << output << std::endl;
+
+  // Captures re-render points of the same path outside the timed run, readbacks stall the queue.
+  std::vector<std::pair<std::string, uint64_t>> checksums;
+  std::vector<uint8_t> pixels;
+  for (size_t c = 0; c < captures; ++c)
+  {
+    const size_t f = c * frames / captures;
+    set_camera(f);
+    engine.RenderFrame();
+    if (!engine.ReadFrame(pixels))
+    {
+      std::cerr << "Failed to read back frame " << f << std::endl;
+      return 1;
+    }
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "frame_%05zu.png", f);
+    checksums.push_back({name, PipelineCache::Hash(pixels.data(), pixels.size())});
+
+    cv::Mat rgba((int) engine.GetFrameExtent().height, (int) engine.GetFrameExtent().width, CV_8UC4, pixels.data());
+    cv::Mat bgra;
+    cv::cvtColor(rgba, bgra, cv::COLOR_RGBA2BGRA);
+    if (!cv::imwrite((output / name).string(), bgra))
+      std::cerr << "Failed to write " << output / name << std::endl;
+  }
+
+  {
+    std::ofstream file(output / "checksums.txt", std::ios::trunc);
+    for (auto &checksum : checksums)
+      file << checksum.first << ' ' << std::hex << std::setw(16) << std::setfill('0') << checksum.second << std::dec << '\n';
+  }
+
+  int result = 0;
+  if (budget_p95 > 0.0 && frame.p95 > budget_p95)
+  {
+    std::cerr << "p95 frame time " << frame.p95 << " ms is over the budget of " << budget_p95 << " ms" << std::endl;
+    result = 1;
+  }
+
+  if (!reference.empty())
+  {
+    std::ifstream file(reference);
+    if (!file.is_open())
+    {
+      std::cerr << "Failed to open " << reference << std::endl;
+      return 1;
+    }
+
+    std::map<std::string, uint64_t> expected;
+    std::string name;
+    uint64_t value = 0;
+    while (file >> name >> std::hex >> value >> std::dec)
+      expected[name] = value;
+
+    bool mismatch = false;
+    for (auto &checksum : checksums)
+    {
+      auto it = expected.find(checksum.first);
+      if (it == expected.end() || it->second != checksum.second)
+      {
+        std::cerr << checksum.first << (it == expected.end() ? " is missing from the reference" : " differs from the reference") << std::endl;
+        mismatch = true;
+      }
+      if (it != expected.end())
+        expected.erase(it);
+    }
+    // Whatever is left was not rendered by this run, e.g. with fewer --frames or --captures.
+    for (auto &entry : expected)
+    {
+      std::cerr << entry.first << " from the reference was not rendered" << std::endl;
+      mismatch = true;
+    }
+
+    std::cout << "  images " << (mismatch ? "do not match" : "match") << " " << reference << std::endl;
+    if (mismatch)
+      result = 1;
+  }
+
+  return result;
+}
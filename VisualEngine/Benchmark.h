@@ -0,0 +1,25 @@
+#ifndef __VISUALENGINE_BENCHMARK_H
+#define __VISUALENGINE_BENCHMARK_H
+
+#include <filesystem>
+
+namespace Benchmark
+{
+  // Imports the model with the sequential and the parallel OBJ path, checks that both
+  // produce identical vertex/index output and prints the timings.
+  int ObjImport(const std::filesystem::path obj_file, const size_t runs = 3);
+
+  // Starts the engine until its first frame with assets, alternating a deleted and a
+  // kept pipeline cache, and prints pipeline creation and time to first frame for both.
+  int Startup(int argc, char const *argv[], const size_t runs = 3);
+
+  // Renders offscreen without a window or swapchain: waits for every asset, then flies a
+  // scripted orbit over the scene for --frames frames (600) and reports frame-time statistics
+  // into --output (benchmark/stats.json and frames.csv). --captures frames (4) of the same path
+  // are read back and written as PNGs with FNV-1a checksums; --reference compares them with a
+  // previous checksums.txt and --budget-p95 fails the run above a p95 frame time in ms.
+  // Other arguments, e.g. --objects, are handed to the engine.
+  int Headless(int argc, char const *argv[]);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#include "ComputePipeline.h"
+
+#include <stdexcept>
+
+ComputePipeline::ComputePipeline(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const std::filesystem::path shader_file,
+                                 const std::vector<VkDescriptorSetLayout> &set_layouts, const std::string entry)
+{
+  device = dev;
+
+  VkPipelineLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = (uint32_t) set_layouts.size();
+  layout_info.pSetLayouts = set_layouts.data();
+  if (vkCreatePipelineLayout(device->GetDevice(), &layout_info, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create pipeline layout!");
+
+  VkComputePipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = cache.GetShaderModule(shader_file);
+  pipeline_info.stage.pName = entry.c_str();
+  pipeline_info.layout = layout;
+  pipeline_info.basePipelineIndex = -1;
+
+  if (vkCreateComputePipelines(device->GetDevice(), cache.GetCache(), 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+  {
+    vkDestroyPipelineLayout(device->GetDevice(), layout, nullptr);
+    throw std::runtime_error("failed to create compute pipeline!");
+  }
+}
+
+ComputePipeline::~ComputePipeline()
+{
+  if (pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(device->GetDevice(), pipeline, nullptr);
+  if (layout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(device->GetDevice(), layout, nullptr);
+}
@@ -0,0 +1,33 @@
+#ifndef __VISUALENGINE_COMPUTEPIPELINE_H
+#define __VISUALENGINE_COMPUTEPIPELINE_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "PipelineCache.h"
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Compute counterpart of GraphicsPipeline, one shader and its layout created through the
+// shared PipelineCache.
+class ComputePipeline
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+public:
+  ComputePipeline() = delete;
+  ComputePipeline(const ComputePipeline &obj) = delete;
+  ComputePipeline &operator=(const ComputePipeline &obj) = delete;
+  ComputePipeline(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const std::filesystem::path shader_file,
+                  const std::vector<VkDescriptorSetLayout> &set_layouts, const std::string entry = "main");
+  ~ComputePipeline();
+
+  VkPipeline GetPipeline() const { return pipeline; }
+  VkPipelineLayout GetLayout() const { return layout; }
+};
+
+#endif
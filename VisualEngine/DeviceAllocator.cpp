@@ -0,0 +1,570 @@
+#include "DeviceAllocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_set>
+
+namespace
+{
+  constexpr VkDeviceSize min_slot_size = 256;
+  constexpr VkDeviceSize max_slot_size = 256 * 1024;
+  constexpr VkDeviceSize min_class_block_size = 1024 * 1024;
+  constexpr VkDeviceSize max_range_block_size = 64 * 1024 * 1024;
+  constexpr VkDeviceSize dedicated_image_size = 16 * 1024 * 1024;
+
+  std::mutex registry_mutex;
+  std::unordered_map<VkDevice, std::weak_ptr<DeviceAllocator>> registry;
+
+  VkDeviceSize AlignUp(const VkDeviceSize value, const VkDeviceSize alignment)
+  {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  // Alignments are powers of two, so a slot aligned to its own size satisfies any up to it.
+  VkDeviceSize SlotSize(const VkDeviceSize size, const VkDeviceSize alignment)
+  {
+    VkDeviceSize slot = min_slot_size;
+    while (slot < size || slot < alignment)
+      slot <<= 1;
+    return slot;
+  }
+
+  bool HasExtension(const VkPhysicalDevice physical_device, const char *name)
+  {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(physical_device, nullptr, &count, extensions.data());
+    for (auto &extension : extensions)
+    {
+      if (std::strcmp(extension.extensionName, name) == 0)
+        return true;
+    }
+    return false;
+  }
+}
+
+DeviceAllocator::DeviceAllocator(const std::shared_ptr<Vulkan::Device> dev)
+{
+  device = dev;
+  vkGetPhysicalDeviceMemoryProperties(device->GetPhysicalDevice(), &memory_properties);
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+  max_memory_objects = properties.limits.maxMemoryAllocationCount;
+  // The budget is a physical device query, usable whenever the device lists the extension.
+  memory_budget = properties.apiVersion >= VK_API_VERSION_1_1 && HasExtension(device->GetPhysicalDevice(), VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  heap_allocated.assign(memory_properties.memoryHeapCount, 0);
+  QueryBudget();
+}
+
+DeviceAllocator::~DeviceAllocator()
+{
+  if (move_fence != VK_NULL_HANDLE)
+    vkDestroyFence(device->GetDevice(), move_fence, nullptr);
+  if (move_pool != VK_NULL_HANDLE)
+    vkDestroyCommandPool(device->GetDevice(), move_pool, nullptr);
+
+  // Owners release their allocations before the allocator, whatever is left leaked.
+  for (auto &block : blocks)
+  {
+    if (block->mapped != nullptr)
+      vkUnmapMemory(device->GetDevice(), block->memory);
+    vkFreeMemory(device->GetDevice(), block->memory, nullptr);
+  }
+}
+
+std::shared_ptr<DeviceAllocator> DeviceAllocator::For(const std::shared_ptr<Vulkan::Device> &dev)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto &entry = registry[dev->GetDevice()];
+  std::shared_ptr<DeviceAllocator> allocator = entry.lock();
+  if (!allocator)
+  {
+    allocator = std::make_shared<DeviceAllocator>(dev);
+    entry = allocator;
+  }
+  return allocator;
+}
+
+void DeviceAllocator::QueryBudget()
+{
+  heap_budget.assign(memory_properties.memoryHeapCount, 0);
+  heap_usage.assign(memory_properties.memoryHeapCount, 0);
+  if (memory_budget)
+  {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+    budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    VkPhysicalDeviceMemoryProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    properties.pNext = &budget;
+    vkGetPhysicalDeviceMemoryProperties2(device->GetPhysicalDevice(), &properties);
+    for (uint32_t h = 0; h < memory_properties.memoryHeapCount; ++h)
+    {
+      heap_budget[h] = budget.heapBudget[h];
+      heap_usage[h] = budget.heapUsage[h];
+    }
+    return;
+  }
+
+  for (uint32_t h = 0; h < memory_properties.memoryHeapCount; ++h)
+  {
+    heap_budget[h] = memory_properties.memoryHeaps[h].size / 10 * 8;
+    heap_usage[h] = heap_allocated[h];
+  }
+}
+
+uint32_t DeviceAllocator::ChooseMemoryType(const uint32_t type_bits, const VkMemoryPropertyFlags properties, const VkDeviceSize block_size)
+{
+  // Types come ordered by preference, the first with room in its heap wins.
+  QueryBudget();
+  uint32_t fallback = UINT32_MAX;
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i)
+  {
+    if ((type_bits & (1u << i)) == 0 || (memory_properties.memoryTypes[i].propertyFlags & properties) != properties)
+      continue;
+    const uint32_t heap = memory_properties.memoryTypes[i].heapIndex;
+    if (heap_usage[heap] + block_size <= heap_budget[heap])
+      return i;
+    if (fallback == UINT32_MAX)
+      fallback = i;
+  }
+
+  if (fallback == UINT32_MAX)
+    throw std::runtime_error("failed to find suitable memory type!");
+  if (block_size > 0)
+    ++over_budget;
+  return fallback;
+}
+
+VkDeviceSize DeviceAllocator::RangeBlockSize(const uint32_t memory_type) const
+{
+  // Small heaps, e.g. the 256 MiB host visible device local one, get proportionally smaller blocks.
+  const VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+  VkDeviceSize size = max_range_block_size;
+  while (size > min_class_block_size && size > heap_size / 8)
+    size >>= 1;
+  return size;
+}
+
+DeviceAllocator::Block *DeviceAllocator::CreateBlock(const uint32_t memory_type, const Resource resource, const VkDeviceSize size,
+                                                     const VkDeviceSize slot_size, const bool dedicated)
+{
+  if (max_memory_objects > 0 && blocks.size() >= max_memory_objects)
+    throw std::runtime_error("out of device memory allocations!");
+
+  auto block = std::make_unique<Block>();
+  block->size = size;
+  block->memory_type = memory_type;
+  block->resource = resource;
+  block->slot_size = slot_size;
+  block->dedicated = dedicated;
+
+  VkMemoryAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+  if (vkAllocateMemory(device->GetDevice(), &alloc_info, nullptr, &block->memory) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate device memory!");
+
+  if ((memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 &&
+      vkMapMemory(device->GetDevice(), block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS)
+  {
+    vkFreeMemory(device->GetDevice(), block->memory, nullptr);
+    throw std::runtime_error("failed to map device memory!");
+  }
+
+  if (slot_size != 0)
+  {
+    // Popped from the back, so the first slots go first.
+    const uint32_t slots = (uint32_t) (size / slot_size);
+    block->free_slots.resize(slots);
+    for (uint32_t s = 0; s < slots; ++s)
+      block->free_slots[s] = slots - 1 - s;
+  }
+  else if (!dedicated)
+    block->free_ranges[0] = size;
+
+  heap_allocated[memory_properties.memoryTypes[memory_type].heapIndex] += size;
+  blocks.push_back(std::move(block));
+  return blocks.back().get();
+}
+
+void DeviceAllocator::DestroyBlock(Block *block)
+{
+  if (block->mapped != nullptr)
+    vkUnmapMemory(device->GetDevice(), block->memory);
+  vkFreeMemory(device->GetDevice(), block->memory, nullptr);
+  heap_allocated[memory_properties.memoryTypes[block->memory_type].heapIndex] -= block->size;
+
+  auto found = std::find_if(blocks.begin(), blocks.end(), [block](const std::unique_ptr<Block> &b) { return b.get() == block; });
+  blocks.erase(found);
+}
+
+bool DeviceAllocator::Find(const Block &block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize &offset) const
+{
+  if (block.dedicated)
+    return false;
+  if (block.slot_size != 0)
+  {
+    if (block.free_slots.empty())
+      return false;
+    offset = (VkDeviceSize) block.free_slots.back() * block.slot_size;
+    return true;
+  }
+
+  // Best fit, ties to the lowest offset.
+  VkDeviceSize best_waste = VK_WHOLE_SIZE;
+  for (auto &range : block.free_ranges)
+  {
+    const VkDeviceSize aligned = AlignUp(range.first, alignment);
+    if (aligned + size > range.first + range.second)
+      continue;
+    const VkDeviceSize waste = range.second - size;
+    if (waste < best_waste)
+    {
+      best_waste = waste;
+      offset = aligned;
+    }
+  }
+  return best_waste != VK_WHOLE_SIZE;
+}
+
+void DeviceAllocator::Take(Block &block, const VkDeviceSize offset, const VkDeviceSize size)
+{
+  if (block.slot_size != 0)
+  {
+    // Find always offers the last free slot.
+    block.free_slots.pop_back();
+    block.used += block.slot_size;
+    return;
+  }
+
+  auto range = std::prev(block.free_ranges.upper_bound(offset));
+  const VkDeviceSize begin = range->first;
+  const VkDeviceSize end = range->first + range->second;
+  block.free_ranges.erase(range);
+  if (offset > begin)
+    block.free_ranges[begin] = offset - begin;
+  if (offset + size < end)
+    block.free_ranges[offset + size] = end - offset - size;
+  block.used += size;
+}
+
+void DeviceAllocator::Release(Block &block, const VkDeviceSize offset, const VkDeviceSize size)
+{
+  if (block.dedicated)
+  {
+    block.used = 0;
+    return;
+  }
+  if (block.slot_size != 0)
+  {
+    block.free_slots.push_back((uint32_t) (offset / block.slot_size));
+    block.used -= block.slot_size;
+    return;
+  }
+
+  VkDeviceSize begin = offset;
+  VkDeviceSize end = offset + size;
+  auto next = block.free_ranges.lower_bound(offset);
+  if (next != block.free_ranges.end() && next->first == end)
+  {
+    end += next->second;
+    next = block.free_ranges.erase(next);
+  }
+  if (next != block.free_ranges.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == begin)
+    {
+      begin = previous->first;
+      block.free_ranges.erase(previous);
+    }
+  }
+  block.free_ranges[begin] = end - begin;
+  block.used -= size;
+}
+
+DeviceAllocation DeviceAllocator::Allocate(const VkMemoryRequirements &requirements, const VkMemoryPropertyFlags properties, const Resource resource,
+                                           const bool dedicated)
+{
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  const VkDeviceSize size = requirements.size;
+  const VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+  // The pool is picked from the first acceptable type, so lookups stay stable while budgets shift.
+  const uint32_t preferred_type = ChooseMemoryType(requirements.memoryTypeBits, properties, 0);
+  const VkDeviceSize range_block_size = RangeBlockSize(preferred_type);
+  const bool use_dedicated = dedicated || size > range_block_size / 2 || (resource == Resource::Image && size >= dedicated_image_size);
+  const VkDeviceSize slot_size = use_dedicated || size > max_slot_size || alignment > max_slot_size ? 0 : SlotSize(size, alignment);
+
+  Block *block = nullptr;
+  VkDeviceSize offset = 0;
+  if (!use_dedicated)
+  {
+    // The fullest block with room, so sparse blocks drain and can be released.
+    for (auto &candidate : blocks)
+    {
+      VkDeviceSize candidate_offset = 0;
+      if (candidate->resource != resource || candidate->slot_size != slot_size || candidate->dedicated ||
+          (requirements.memoryTypeBits & (1u << candidate->memory_type)) == 0 ||
+          (memory_properties.memoryTypes[candidate->memory_type].propertyFlags & properties) != properties)
+        continue;
+      if ((!block || candidate->used > block->used) && Find(*candidate, size, alignment, candidate_offset))
+      {
+        block = candidate.get();
+        offset = candidate_offset;
+      }
+    }
+  }
+
+  if (!block)
+  {
+    const VkDeviceSize block_size = use_dedicated ? size : slot_size != 0 ? std::max(slot_size * 64, min_class_block_size) : range_block_size;
+    block = CreateBlock(ChooseMemoryType(requirements.memoryTypeBits, properties, block_size), resource, block_size, slot_size, use_dedicated);
+    if (!use_dedicated)
+      Find(*block, size, alignment, offset);
+  }
+  if (use_dedicated)
+    block->used = size;
+  else
+    Take(*block, offset, size);
+
+  DeviceAllocation allocation;
+  allocation.memory = block->memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = block->mapped != nullptr ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+  allocation.id = next_id++;
+  live[allocation.id] = {block, offset, size, alignment, nullptr};
+  return allocation;
+}
+
+void DeviceAllocator::Free(const DeviceAllocation &allocation)
+{
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  auto found = live.find(allocation.id);
+  if (found == live.end())
+    return;
+
+  Block *block = found->second.block;
+  Release(*block, found->second.offset, found->second.size);
+  live.erase(found);
+  if (block->used == 0)
+    DestroyBlock(block);
+}
+
+void DeviceAllocator::SetMover(const DeviceAllocation &allocation, Mover mover)
+{
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  auto found = live.find(allocation.id);
+  if (found != live.end())
+    found->second.mover = std::move(mover);
+}
+
+VkDeviceSize DeviceAllocator::Defragment(const VkQueue queue, const VkDeviceSize max_bytes)
+{
+  std::unique_lock<std::mutex> lock(allocator_mutex);
+
+  // Per pool, the sparsest blocks are emptied as long as the denser ones have room for them.
+  std::map<std::tuple<uint32_t, Resource, VkDeviceSize>, std::vector<Block*>> pools;
+  for (auto &block : blocks)
+  {
+    if (!block->dedicated)
+      pools[{block->memory_type, block->resource, block->slot_size}].push_back(block.get());
+  }
+  std::vector<Block*> sources;
+  for (auto &pool : pools)
+  {
+    std::vector<Block*> &pool_blocks = pool.second;
+    std::sort(pool_blocks.begin(), pool_blocks.end(), [](const Block *a, const Block *b) { return a->used < b->used; });
+    VkDeviceSize free_after = 0;
+    for (const Block *block : pool_blocks)
+      free_after += block->size - block->used;
+    VkDeviceSize incoming = 0;
+    for (Block *block : pool_blocks)
+    {
+      free_after -= block->size - block->used;
+      if (incoming + block->used > free_after)
+        break;
+      sources.push_back(block);
+      incoming += block->used;
+    }
+  }
+  const std::unordered_set<Block*> evacuated(sources.begin(), sources.end());
+
+  struct Move
+  {
+    uint64_t id;
+    Block *target;
+    VkDeviceSize offset;
+  };
+  std::vector<Move> moves;
+  VkDeviceSize bytes = 0;
+  for (size_t s = 0; s < sources.size() && bytes < max_bytes; ++s)
+  {
+    for (auto &entry : live)
+    {
+      if (entry.second.block != sources[s] || !entry.second.mover || bytes >= max_bytes)
+        continue;
+      for (auto &target : blocks)
+      {
+        VkDeviceSize offset = 0;
+        if (evacuated.count(target.get()) != 0 || target->resource != sources[s]->resource || target->slot_size != sources[s]->slot_size ||
+            target->memory_type != sources[s]->memory_type || !Find(*target, entry.second.size, entry.second.alignment, offset))
+          continue;
+        Take(*target, offset, entry.second.size);
+        moves.push_back({entry.first, target.get(), offset});
+        bytes += entry.second.size;
+        break;
+      }
+    }
+  }
+  if (moves.empty())
+    return 0;
+
+  if (move_pool == VK_NULL_HANDLE)
+  {
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = device->GetGraphicFamilyQueueIndex().value();
+    if (vkCreateCommandPool(device->GetDevice(), &pool_info, nullptr, &move_pool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create defragmentation command pool!");
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = move_pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device->GetDevice(), &alloc_info, &move_commands) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate defragmentation command buffer!");
+
+    VkFenceCreateInfo fence_info = {};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device->GetDevice(), &fence_info, nullptr, &move_fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to create defragmentation fence!");
+  }
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkResetCommandBuffer(move_commands, 0);
+  if (vkBeginCommandBuffer(move_commands, &begin_info) != VK_SUCCESS)
+    throw std::runtime_error("failed to begin defragmentation command buffer!");
+
+  std::vector<std::function<void()>> finished;
+  for (auto &move : moves)
+  {
+    Live &entry = live[move.id];
+    DeviceAllocation destination;
+    destination.memory = move.target->memory;
+    destination.offset = move.offset;
+    destination.size = entry.size;
+    destination.mapped = move.target->mapped != nullptr ? static_cast<uint8_t*>(move.target->mapped) + move.offset : nullptr;
+    destination.id = move.id;
+    finished.push_back(entry.mover(move_commands, destination));
+  }
+
+  if (vkEndCommandBuffer(move_commands) != VK_SUCCESS)
+    throw std::runtime_error("failed to record defragmentation commands!");
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &move_commands;
+  vkResetFences(device->GetDevice(), 1, &move_fence);
+  if (vkQueueSubmit(queue, 1, &submit_info, move_fence) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit defragmentation commands!");
+  vkWaitForFences(device->GetDevice(), 1, &move_fence, VK_TRUE, UINT64_MAX);
+
+  for (auto &move : moves)
+  {
+    Live &entry = live[move.id];
+    Release(*entry.block, entry.offset, entry.size);
+    if (entry.block->used == 0)
+      DestroyBlock(entry.block);
+    entry.block = move.target;
+    entry.offset = move.offset;
+  }
+  moved += bytes;
+
+  // Owners may allocate again while updating their references.
+  lock.unlock();
+  for (auto &done : finished)
+  {
+    if (done)
+      done();
+  }
+  return bytes;
+}
+
+DeviceAllocator::Stats DeviceAllocator::GetStats()
+{
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  QueryBudget();
+
+  Stats stats;
+  stats.heaps.resize(memory_properties.memoryHeapCount);
+  for (uint32_t h = 0; h < memory_properties.memoryHeapCount; ++h)
+  {
+    stats.heaps[h].size = memory_properties.memoryHeaps[h].size;
+    stats.heaps[h].budget = heap_budget[h];
+    stats.heaps[h].usage = heap_usage[h];
+    stats.heaps[h].allocated = heap_allocated[h];
+  }
+  for (auto &block : blocks)
+  {
+    stats.heaps[memory_properties.memoryTypes[block->memory_type].heapIndex].used += block->used;
+    if (block->dedicated)
+      stats.dedicated++;
+    else if (block->slot_size != 0)
+      stats.class_blocks++;
+    else
+      stats.range_blocks++;
+  }
+  for (auto &entry : live)
+  {
+    if (entry.second.mover)
+      stats.movable++;
+  }
+  stats.allocations = live.size();
+  stats.memory_objects = blocks.size();
+  stats.over_budget = over_budget;
+  stats.moved = moved;
+  stats.driver_budget = memory_budget;
+  return stats;
+}
+
+void DeviceAllocator::Print(std::ostream &out)
+{
+  const Stats stats = GetStats();
+  const double mib = 1024.0 * 1024.0;
+  out << std::fixed << std::setprecision(1);
+  out << "device memory: " << stats.allocations << " allocations (" << stats.movable << " movable) in " << stats.memory_objects << " of "
+      << max_memory_objects << " memory objects, " << stats.class_blocks << " size class blocks, " << stats.range_blocks << " range blocks, "
+      << stats.dedicated << " dedicated, " << stats.moved / mib << " MiB moved, " << stats.over_budget << " over budget" << std::endl;
+  for (size_t h = 0; h < stats.heaps.size(); ++h)
+  {
+    const HeapStats &heap = stats.heaps[h];
+    out << "  heap " << h << ": " << heap.used / mib << " used of " << heap.allocated / mib << " MiB allocated, usage "
+        << heap.usage / mib << " of " << heap.budget / mib << " MiB " << (stats.driver_budget ? "budget" : "estimated budget")
+        << ", size " << heap.size / mib << " MiB" << std::endl;
+  }
+
+  std::lock_guard<std::mutex> lock(allocator_mutex);
+  for (auto &block : blocks)
+  {
+    out << "    type " << block->memory_type << (block->resource == Resource::Image ? " image " : " buffer ")
+        << (block->dedicated ? "dedicated" : block->slot_size != 0 ? std::to_string(block->slot_size) + " B slots" : "ranges")
+        << ": " << block->used / mib << " of " << block->size / mib << " MiB";
+    if (!block->dedicated && block->slot_size == 0)
+      out << " in " << block->free_ranges.size() << " free ranges";
+    out << std::endl;
+  }
+}
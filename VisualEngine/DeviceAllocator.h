@@ -0,0 +1,149 @@
+#ifndef __VISUALENGINE_DEVICEALLOCATOR_H
+#define __VISUALENGINE_DEVICEALLOCATOR_H
+
+#include "../VK-nn/Vulkan/Device.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+// A range of device memory handed out by DeviceAllocator, the whole VkDeviceMemory when dedicated.
+struct DeviceAllocation
+{
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr; // host visible memory stays mapped, already at offset
+  uint64_t id = 0;        // 0 for no allocation
+};
+
+// Sub-allocates buffers and images from a few large VkDeviceMemory blocks per memory type instead
+// of one allocation each, keeping far below maxMemoryAllocationCount:
+// - size classes: power of two slots from 256 bytes to 256 KiB, one class per block, so freeing
+//   never fragments a block and alignment follows from the slot size;
+// - range blocks: 64 MiB (less on small heaps) with best-fit free ranges that coalesce on free;
+// - dedicated memory for images of 16 MiB and more, transient attachments and anything over half
+//   a range block.
+// Buffers and images never share a block, so bufferImageGranularity does not apply. Empty blocks
+// are released at once. New blocks go to the matching memory type with room in its heap budget,
+// from VK_EXT_memory_budget when the device has it, otherwise 80% of the heap size.
+// One allocator is shared per device, see For.
+class DeviceAllocator
+{
+public:
+  enum class Resource
+  {
+    Buffer,
+    Image
+  };
+
+  // Binds the owner's resource to destination and records the copy of its contents into
+  // command_buffer, or copies host visible memory right away. The returned function runs once
+  // the copy has completed, to destroy the old resource and update references to it.
+  using Mover = std::function<std::function<void()>(const VkCommandBuffer command_buffer, const DeviceAllocation &destination)>;
+
+  struct HeapStats
+  {
+    VkDeviceSize size = 0;
+    VkDeviceSize budget = 0;
+    VkDeviceSize usage = 0;     // whole process as reported by the driver, or allocated
+    VkDeviceSize allocated = 0; // VkDeviceMemory owned by the allocator
+    VkDeviceSize used = 0;      // by live allocations, slots count whole
+  };
+
+  struct Stats
+  {
+    std::vector<HeapStats> heaps;
+    size_t allocations = 0;
+    size_t movable = 0;
+    size_t memory_objects = 0;
+    size_t class_blocks = 0;
+    size_t range_blocks = 0;
+    size_t dedicated = 0;
+    size_t over_budget = 0; // blocks allocated although no memory type had budget left
+    VkDeviceSize moved = 0;
+    bool driver_budget = false;
+  };
+private:
+  struct Block
+  {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    void *mapped = nullptr;
+    uint32_t memory_type = 0;
+    Resource resource = Resource::Buffer;
+    VkDeviceSize slot_size = 0; // size class, 0 for range blocks and dedicated memory
+    bool dedicated = false;
+    VkDeviceSize used = 0;
+    std::vector<uint32_t> free_slots;
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges; // offset to size, never adjacent
+  };
+
+  struct Live
+  {
+    Block *block = nullptr;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 1;
+    Mover mover;
+  };
+
+  std::shared_ptr<Vulkan::Device> device;
+  VkPhysicalDeviceMemoryProperties memory_properties = {};
+  uint32_t max_memory_objects = 0;
+  bool memory_budget = false;
+
+  std::mutex allocator_mutex;
+  std::vector<std::unique_ptr<Block>> blocks;
+  std::unordered_map<uint64_t, Live> live;
+  uint64_t next_id = 1;
+  std::vector<VkDeviceSize> heap_allocated;
+  std::vector<VkDeviceSize> heap_budget;
+  std::vector<VkDeviceSize> heap_usage;
+  size_t over_budget = 0;
+  VkDeviceSize moved = 0;
+
+  VkCommandPool move_pool = VK_NULL_HANDLE;
+  VkCommandBuffer move_commands = VK_NULL_HANDLE;
+  VkFence move_fence = VK_NULL_HANDLE;
+
+  void QueryBudget();
+  uint32_t ChooseMemoryType(const uint32_t type_bits, const VkMemoryPropertyFlags properties, const VkDeviceSize block_size);
+  Block *CreateBlock(const uint32_t memory_type, const Resource resource, const VkDeviceSize size, const VkDeviceSize slot_size, const bool dedicated);
+  void DestroyBlock(Block *block);
+  bool Find(const Block &block, const VkDeviceSize size, const VkDeviceSize alignment, VkDeviceSize &offset) const;
+  void Take(Block &block, const VkDeviceSize offset, const VkDeviceSize size);
+  void Release(Block &block, const VkDeviceSize offset, const VkDeviceSize size);
+  VkDeviceSize RangeBlockSize(const uint32_t memory_type) const;
+public:
+  DeviceAllocator() = delete;
+  DeviceAllocator(const DeviceAllocator &obj) = delete;
+  DeviceAllocator &operator=(const DeviceAllocator &obj) = delete;
+  DeviceAllocator(const std::shared_ptr<Vulkan::Device> dev);
+  ~DeviceAllocator();
+
+  // The allocator of dev, created on first use and released with its last user.
+  static std::shared_ptr<DeviceAllocator> For(const std::shared_ptr<Vulkan::Device> &dev);
+
+  DeviceAllocation Allocate(const VkMemoryRequirements &requirements, const VkMemoryPropertyFlags properties, const Resource resource,
+                            const bool dedicated = false);
+  void Free(const DeviceAllocation &allocation);
+  // Allocations without a mover are never moved.
+  void SetMover(const DeviceAllocation &allocation, Mover mover);
+
+  // One incremental step: moves movable allocations out of the sparsest blocks of each pool into
+  // free space of its denser blocks, until max_bytes are moved, and releases blocks left empty.
+  // Copies are submitted to queue and waited for. The caller keeps the device idle and queue
+  // access synchronized meanwhile. Returns the bytes moved, 0 once nothing is left to gain.
+  VkDeviceSize Defragment(const VkQueue queue, const VkDeviceSize max_bytes);
+
+  Stats GetStats();
+  void Print(std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+  // Fraction of the budget above which the scale goes down and below which it goes up,
+  // far enough apart that one step does not cross both.
+  constexpr double over_budget = 0.95;
+  constexpr double under_budget = 0.75;
+  // Weight of the newest timing in the moving average.
+  constexpr double smoothing = 0.1;
+}
+
+DynamicResolution::DynamicResolution(const Config &cfg, const VkSampleCountFlagBits samples_count, const float sample_shading)
+{
+  config = cfg;
+  config.min_scale = std::clamp(config.min_scale, 0.1f, 1.0f);
+  max_samples = samples_count;
+  max_sample_shading = sample_shading;
+  if (config.adaptive_quality)
+  {
+    // One step for sample shading, then one per halving of the sample count.
+    max_quality_drop = sample_shading > 0.0f ? 1 : 0;
+    for (uint32_t samples = (uint32_t) samples_count; samples > 1; samples >>= 1)
+      ++max_quality_drop;
+  }
+}
+
+VkSampleCountFlagBits DynamicResolution::Samples() const
+{
+  const size_t shading_steps = max_sample_shading > 0.0f ? 1 : 0;
+  const size_t halvings = quality_drop > shading_steps ? quality_drop - shading_steps : 0;
+  return (VkSampleCountFlagBits) std::max<uint32_t>((uint32_t) max_samples >> halvings, 1);
+}
+
+float DynamicResolution::SampleShading() const
+{
+  return quality_drop > 0 ? 0.0f : max_sample_shading;
+}
+
+DynamicResolution::Change DynamicResolution::Changed(const Change change)
+{
+  frames_since_change = 0;
+  // A different sample count costs differently, timings from before it say nothing.
+  if (change == Change::Quality)
+    smoothed_ms = 0.0;
+  return change;
+}
+
+DynamicResolution::Change DynamicResolution::Update(const double gpu_ms)
+{
+  if (std::isnan(gpu_ms))
+    return Change::None;
+  smoothed_ms = smoothed_ms == 0.0 ? gpu_ms : smoothed_ms + (gpu_ms - smoothed_ms) * smoothing;
+  if (++frames_since_change < config.cooldown_frames)
+    return Change::None;
+
+  // GPU time grows roughly with the pixel count, the square of the scale. Steps are clamped
+  // so one bad spike cannot halve the resolution.
+  if (smoothed_ms > config.budget_ms * over_budget)
+  {
+    if (scale > config.min_scale)
+    {
+      const float step = (float) std::clamp(std::sqrt(config.budget_ms * over_budget / smoothed_ms), 0.8, 0.97);
+      scale = std::max(scale * step, config.min_scale);
+      return Changed(Change::Scale);
+    }
+    if (quality_drop < max_quality_drop)
+    {
+      ++quality_drop;
+      return Changed(Change::Quality);
+    }
+  }
+  else if (smoothed_ms < config.budget_ms * under_budget)
+  {
+    if (quality_drop > 0)
+    {
+      --quality_drop;
+      return Changed(Change::Quality);
+    }
+    if (scale < 1.0f)
+    {
+      const float step = (float) std::clamp(std::sqrt(config.budget_ms * under_budget / smoothed_ms), 1.03, 1.1);
+      scale = std::min(scale * step, 1.0f);
+      return Changed(Change::Scale);
+    }
+  }
+  return Change::None;
+}
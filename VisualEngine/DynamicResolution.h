@@ -0,0 +1,58 @@
+#ifndef __VISUALENGINE_DYNAMICRESOLUTION_H
+#define __VISUALENGINE_DYNAMICRESOLUTION_H
+
+#include <vulkan/vulkan.h>
+#include <cstddef>
+
+// Picks the render scale, and optionally the sample count and sample shading, that keeps the
+// measured GPU frame time under a budget. Timings arrive a few frames late and are noisy, so
+// they are smoothed and every change is followed by a cooldown before the next one is considered.
+// Over budget it first lowers the scale; at the minimum scale, with adaptive quality, it turns
+// sample shading off and then halves MSAA. With headroom the steps are undone in reverse order.
+class DynamicResolution
+{
+public:
+  struct Config
+  {
+    double budget_ms = 16.6;
+    float min_scale = 0.5f;
+    bool adaptive_quality = false;
+    size_t cooldown_frames = 30;
+  };
+
+  enum class Change
+  {
+    None,
+    Scale,  // only the render area changes
+    Quality // samples or sample shading change, the render pass or pipeline variant with them
+  };
+private:
+  Config config;
+  VkSampleCountFlagBits max_samples = VK_SAMPLE_COUNT_1_BIT;
+  float max_sample_shading = 0.0f;
+  size_t max_quality_drop = 0;
+
+  float scale = 1.0f;
+  size_t quality_drop = 0;
+  double smoothed_ms = 0.0;
+  size_t frames_since_change = 0;
+
+  Change Changed(const Change change);
+public:
+  DynamicResolution() = delete;
+  DynamicResolution(const DynamicResolution &obj) = delete;
+  DynamicResolution &operator=(const DynamicResolution &obj) = delete;
+  // samples_count and sample_shading are the full quality the controller never goes above.
+  DynamicResolution(const Config &cfg, const VkSampleCountFlagBits samples_count, const float sample_shading);
+  ~DynamicResolution() = default;
+
+  // Once per frame with the GPU time of the latest measured frame, NaN when there is none yet.
+  Change Update(const double gpu_ms);
+
+  float Scale() const { return scale; }
+  VkSampleCountFlagBits Samples() const;
+  float SampleShading() const;
+  double SmoothedTime() const { return smoothed_ms; }
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "FrameRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FrameRing::FrameRing(const std::shared_ptr<Vulkan::Device> dev, const VkDeviceSize bytes_per_frame, const size_t frames_count, const VkBufferUsageFlags usage)
+{
+  alignment = OffsetAlignment(dev->GetPhysicalDevice());
+  frames = frames_count;
+  frame_size = AlignedSize(bytes_per_frame, alignment);
+  buffer = std::make_unique<GpuBuffer>(dev, frame_size * frames, usage,
+                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+void FrameRing::BeginFrame(const size_t frame)
+{
+  frame_begin = frame_size * (frame % frames);
+  head = frame_begin;
+}
+
+VkDeviceSize FrameRing::Allocate(const VkDeviceSize bytes)
+{
+  VkDeviceSize offset = head;
+  VkDeviceSize end = offset + AlignedSize(bytes, alignment);
+  if (end > frame_begin + frame_size)
+    throw std::runtime_error("frame ring is out of space!");
+
+  head = end;
+  return offset;
+}
+
+VkDeviceSize FrameRing::OffsetAlignment(const VkPhysicalDevice physical_device)
+{
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  return std::max<VkDeviceSize>({16, properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment});
+}
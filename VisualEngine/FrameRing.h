@@ -0,0 +1,44 @@
+#ifndef __VISUALENGINE_FRAMERING_H
+#define __VISUALENGINE_FRAMERING_H
+
+#include "GpuBuffer.h"
+
+#include <memory>
+
+// One persistently mapped buffer split into a region per frame in flight.
+// Every frame allocates linearly from its own region, the returned offsets
+// are used as dynamic offsets or indirect offsets into GetBuffer().
+class FrameRing
+{
+private:
+  std::unique_ptr<GpuBuffer> buffer;
+  VkDeviceSize alignment = 1;
+  VkDeviceSize frame_size = 0;
+  VkDeviceSize frame_begin = 0;
+  VkDeviceSize head = 0;
+  size_t frames = 0;
+public:
+  FrameRing() = delete;
+  FrameRing(const FrameRing &obj) = delete;
+  FrameRing &operator=(const FrameRing &obj) = delete;
+  FrameRing(const std::shared_ptr<Vulkan::Device> dev, const VkDeviceSize bytes_per_frame, const size_t frames_count, const VkBufferUsageFlags usage);
+  ~FrameRing() = default;
+
+  // The caller guarantees the GPU is done with the frame, usually by waiting on its fence.
+  void BeginFrame(const size_t frame);
+  VkDeviceSize Allocate(const VkDeviceSize bytes);
+
+  template <class T>
+  T *Data(const VkDeviceSize offset) const { return reinterpret_cast<T*>(buffer->Data<uint8_t>() + offset); }
+
+  VkBuffer GetBuffer() const { return buffer->GetBuffer(); }
+  VkDeviceSize Alignment() const { return alignment; }
+  VkDeviceSize FrameSize() const { return frame_size; }
+  size_t FramesCount() const { return frames; }
+
+  // Smallest alignment valid for both uniform and storage dynamic offsets.
+  static VkDeviceSize OffsetAlignment(const VkPhysicalDevice physical_device);
+  static VkDeviceSize AlignedSize(const VkDeviceSize bytes, const VkDeviceSize alignment) { return (bytes + alignment - 1) / alignment * alignment; }
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "FrameStats.h"
+
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+RollingHistogram::RollingHistogram(const size_t window, const double bucket_width_ms, const double range_ms)
+{
+  bucket_ms = std::max(bucket_width_ms, 1e-3);
+  buckets.assign((size_t) std::ceil(range_ms / bucket_ms) + 1, 0);
+  samples.assign(std::max<size_t>(window, 1), std::numeric_limits<double>::quiet_NaN());
+}
+
+void RollingHistogram::Add(const double ms)
+{
+  double &slot = samples[head];
+  if (filled == samples.size() && !std::isnan(slot))
+  {
+    buckets[Bucket(slot)]--;
+    sum -= slot;
+    count--;
+  }
+
+  slot = ms;
+  if (!std::isnan(ms))
+  {
+    buckets[Bucket(ms)]++;
+    sum += ms;
+    count++;
+  }
+
+  head = (head + 1) % samples.size();
+  filled = std::min(filled + 1, samples.size());
+}
+
+double RollingHistogram::Percentile(const double p) const
+{
+  if (count == 0)
+    return 0.0;
+
+  const double rank = std::clamp(p, 0.0, 100.0) / 100.0 * count;
+  double below = 0.0;
+  for (size_t b = 0; b < buckets.size(); ++b)
+  {
+    if (buckets[b] == 0 || below + buckets[b] < rank)
+    {
+      below += buckets[b];
+      continue;
+    }
+    if (b == buckets.size() - 1)
+      return Max();
+    return std::min((b + (rank - below) / buckets[b]) * bucket_ms, Max());
+  }
+  return Max();
+}
+
+double RollingHistogram::Max() const
+{
+  double max = 0.0;
+  for (size_t i = 0; i < filled; ++i)
+  {
+    if (!std::isnan(samples[i]))
+      max = std::max(max, samples[i]);
+  }
+  return max;
+}
+
+FrameStats::FrameStats(const size_t window_frames, const double stutter)
+{
+  window = std::max<size_t>(window_frames, 1);
+  stutter_factor = stutter;
+  AddSeries("frame");
+}
+
+size_t FrameStats::AddSeries(const std::string &name)
+{
+  for (size_t i = 0; i < series.size(); ++i)
+  {
+    if (series[i].name == name)
+      return i;
+  }
+
+  // A late series is padded with empty frames so every window stays aligned by frame.
+  series.push_back({name, RollingHistogram(window), std::numeric_limits<double>::quiet_NaN(), {}});
+  const size_t recorded = series[frame_series].histogram.Filled();
+  for (size_t i = 0; i < recorded; ++i)
+    series.back().histogram.Add(std::numeric_limits<double>::quiet_NaN());
+  return series.size() - 1;
+}
+
+void FrameStats::End(const size_t id)
+{
+  auto now = std::chrono::steady_clock::now();
+  series[id].pending = std::chrono::duration<double, std::milli>(now - series[id].started).count();
+}
+
+void FrameStats::RecordStatistics(const PipelineStatistics &statistics)
+{
+  statistics_sum.input_vertices += statistics.input_vertices;
+  statistics_sum.input_primitives += statistics.input_primitives;
+  statistics_sum.vertex_invocations += statistics.vertex_invocations;
+  statistics_sum.clipping_invocations += statistics.clipping_invocations;
+  statistics_sum.clipping_primitives += statistics.clipping_primitives;
+  statistics_sum.fragment_invocations += statistics.fragment_invocations;
+  statistics_frames++;
+}
+
+void FrameStats::EndFrame()
+{
+  auto now = std::chrono::steady_clock::now();
+  if (frames > 0)
+  {
+    const double frame_ms = std::chrono::duration<double, std::milli>(now - last_frame).count();
+    // Warm up before judging, the median of a handful of frames is mostly loading noise.
+    const RollingHistogram &frame_times = series[frame_series].histogram;
+    if (frame_times.Count() >= 30 && frame_ms > stutter_factor * frame_times.Percentile(50.0))
+      stutters++;
+    series[frame_series].pending = frame_ms;
+  }
+  last_frame = now;
+  frames++;
+
+  for (auto &s : series)
+  {
+    s.histogram.Add(s.pending);
+    s.pending = std::numeric_limits<double>::quiet_NaN();
+  }
+}
+
+void FrameStats::Reset(const size_t window_frames)
+{
+  if (window_frames > 0)
+    window = window_frames;
+  for (auto &s : series)
+  {
+    s.histogram = RollingHistogram(window);
+    s.pending = std::numeric_limits<double>::quiet_NaN();
+  }
+  frames = 0;
+  stutters = 0;
+  statistics_sum = PipelineStatistics();
+  statistics_frames = 0;
+}
+
+SeriesSummary FrameStats::Summary(const size_t id) const
+{
+  const RollingHistogram &histogram = series[id].histogram;
+  SeriesSummary summary;
+  summary.mean = histogram.Mean();
+  summary.p50 = histogram.Percentile(50.0);
+  summary.p95 = histogram.Percentile(95.0);
+  summary.p99 = histogram.Percentile(99.0);
+  summary.max = histogram.Max();
+  summary.samples = histogram.Count();
+  return summary;
+}
+
+double FrameStats::Fps() const
+{
+  const double mean = series[frame_series].histogram.Mean();
+  return mean > 0.0 ? 1000.0 / mean : 0.0;
+}
+
+void FrameStats::SetInfo(const std::string &key, const std::string &value)
+{
+  for (auto &entry : info)
+  {
+    if (entry.first == key)
+    {
+      entry.second = value;
+      return;
+    }
+  }
+  info.push_back({key, value});
+}
+
+bool FrameStats::Export(const std::filesystem::path &file) const
+{
+  std::filesystem::path tmp_file = file;
+  tmp_file += ".tmp";
+  {
+    std::ofstream out(tmp_file, std::ios::trunc);
+    if (!out.is_open())
+      return false;
+
+    bool written = file.extension() == ".json" ? ExportJson(out) : ExportCsv(out);
+    if (!written || !out.good())
+      return false;
+  }
+
+  std::error_code err;
+  std::filesystem::rename(tmp_file, file, err);
+  return !err;
+}
+
+bool FrameStats::ExportCsv(std::ostream &out) const
+{
+  out << "index";
+  for (auto &s : series)
+    out << ',' << s.name << "_ms";
+  out << '\n';
+
+  // Missing values stay empty so spreadsheets and pandas read them as gaps.
+  const size_t rows = series[frame_series].histogram.Filled();
+  for (size_t r = 0; r < rows; ++r)
+  {
+    out << frames - rows + r;
+    for (auto &s : series)
+    {
+      out << ',';
+      const double value = s.histogram.Sample(r);
+      if (!std::isnan(value))
+        out << value;
+    }
+    out << '\n';
+  }
+  return true;
+}
+
+bool FrameStats::ExportJson(std::ostream &out) const
+{
+  auto quoted = [](const std::string &text)
+  {
+    std::string result = "\"";
+    for (char c : text)
+    {
+      if (c == '"' || c == '\\')
+        result += '\\';
+      if ((unsigned char) c >= 0x20)
+        result += c;
+    }
+    return result + "\"";
+  };
+
+  out << "{\n  \"info\": {";
+  for (size_t i = 0; i < info.size(); ++i)
+    out << (i > 0 ? ", " : "") << quoted(info[i].first) << ": " << quoted(info[i].second);
+  out << "},\n";
+  out << "  \"frames\": " << frames << ",\n";
+  out << "  \"window\": " << window << ",\n";
+  out << "  \"stutters\": " << stutters << ",\n";
+  out << "  \"stutter_factor\": " << stutter_factor << ",\n";
+  out << "  \"fps\": " << Fps() << ",\n";
+
+  out << "  \"series_ms\": {\n";
+  for (size_t i = 0; i < series.size(); ++i)
+  {
+    SeriesSummary summary = Summary(i);
+    out << "    " << quoted(series[i].name) << ": {\"mean\": " << summary.mean << ", \"p50\": " << summary.p50
+        << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99 << ", \"max\": " << summary.max
+        << ", \"samples\": " << summary.samples << "}" << (i + 1 < series.size() ? "," : "") << "\n";
+  }
+  out << "  },\n";
+
+  // Averages per frame over every frame that returned statistics, not only the window.
+  const double n = (double) std::max<size_t>(statistics_frames, 1);
+  out << "  \"pipeline_statistics_per_frame\": {"
+      << "\"input_vertices\": " << statistics_sum.input_vertices / n
+      << ", \"input_primitives\": " << statistics_sum.input_primitives / n
+      << ", \"vertex_invocations\": " << statistics_sum.vertex_invocations / n
+      << ", \"clipping_invocations\": " << statistics_sum.clipping_invocations / n
+      << ", \"clipping_primitives\": " << statistics_sum.clipping_primitives / n
+      << ", \"fragment_invocations\": " << statistics_sum.fragment_invocations / n
+      << ", \"frames\": " << statistics_frames << "}\n";
+  out << "}\n";
+  return true;
+}
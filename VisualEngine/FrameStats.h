@@ -0,0 +1,110 @@
+#ifndef __VISUALENGINE_FRAMESTATS_H
+#define __VISUALENGINE_FRAMESTATS_H
+
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Fixed-width buckets over the last window samples, adding a sample evicts the oldest one
+// so percentiles cost one pass over the buckets no matter how many frames were recorded.
+// NaN samples keep their slot in the window but are not counted.
+class RollingHistogram
+{
+private:
+  std::vector<uint32_t> buckets; // the last bucket collects everything above the range
+  std::vector<double> samples;
+  size_t head = 0;
+  size_t filled = 0;
+  size_t count = 0;
+  double bucket_ms = 0.05;
+  double sum = 0.0;
+
+  size_t Bucket(const double ms) const { return std::min(buckets.size() - 1, (size_t) std::max(ms / bucket_ms, 0.0)); }
+public:
+  RollingHistogram() = delete;
+  RollingHistogram(const size_t window, const double bucket_width_ms = 0.05, const double range_ms = 250.0);
+
+  void Add(const double ms);
+  // p in [0, 100], interpolated inside the bucket it falls into.
+  double Percentile(const double p) const;
+  double Mean() const { return count > 0 ? sum / count : 0.0; }
+  double Max() const;
+  size_t Count() const { return count; }
+  size_t Window() const { return samples.size(); }
+  // Samples of the window from the oldest to the newest.
+  double Sample(const size_t age) const { return samples[(head + samples.size() - filled + age) % samples.size()]; }
+  size_t Filled() const { return filled; }
+};
+
+struct SeriesSummary
+{
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+  size_t samples = 0;
+};
+
+// Per-frame timing series with rolling histograms. Series 0 is the frame time measured
+// between EndFrame calls, the others are CPU phases timed with Begin/End or values such
+// as GPU pass times handed in with Record. A frame counts as a stutter when it takes
+// longer than stutter_factor times the rolling median.
+class FrameStats
+{
+private:
+  struct Series
+  {
+    std::string name;
+    RollingHistogram histogram;
+    double pending;
+    std::chrono::steady_clock::time_point started;
+  };
+
+  std::vector<Series> series;
+  std::vector<std::pair<std::string, std::string>> info;
+  size_t window = 0;
+  double stutter_factor = 2.0;
+  size_t frames = 0;
+  size_t stutters = 0;
+  std::chrono::steady_clock::time_point last_frame;
+  PipelineStatistics statistics_sum;
+  size_t statistics_frames = 0;
+
+  bool ExportCsv(std::ostream &out) const;
+  bool ExportJson(std::ostream &out) const;
+public:
+  static constexpr size_t frame_series = 0;
+
+  FrameStats(const size_t window_frames = 1024, const double stutter = 2.0);
+  FrameStats(const FrameStats &obj) = delete;
+  FrameStats &operator=(const FrameStats &obj) = delete;
+  ~FrameStats() = default;
+
+  size_t AddSeries(const std::string &name);
+  void Begin(const size_t id) { series[id].started = std::chrono::steady_clock::now(); }
+  void End(const size_t id);
+  void Record(const size_t id, const double ms) { series[id].pending = ms; }
+  void RecordStatistics(const PipelineStatistics &statistics);
+  // Closes the frame: every series gets its pending value, NaN when nothing was recorded.
+  void EndFrame();
+  // Drops every recorded frame, series stay registered. Used to cut off warm-up frames,
+  // a window_frames other than 0 resizes the window, e.g. to hold a whole benchmark run.
+  void Reset(const size_t window_frames = 0);
+
+  SeriesSummary Summary(const size_t id) const;
+  size_t Frames() const { return frames; }
+  size_t Stutters() const { return stutters; }
+  double Fps() const;
+
+  // Free form key/value pairs written into JSON exports, e.g. the device or the build.
+  void SetInfo(const std::string &key, const std::string &value);
+  // JSON summary for .json paths, the per-frame window as CSV otherwise.
+  bool Export(const std::filesystem::path &file) const;
+};
+
+#endif
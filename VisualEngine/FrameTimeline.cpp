@@ -0,0 +1,105 @@
+#include "FrameTimeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FrameTimeline::FrameTimeline(const std::shared_ptr<Vulkan::Device> dev, const size_t frames_in_flight)
+{
+  device = dev;
+  CreateFences(frames_in_flight);
+}
+
+FrameTimeline::~FrameTimeline()
+{
+  WaitIdle();
+  DestroyFences();
+}
+
+void FrameTimeline::CreateFences(const size_t frames_in_flight)
+{
+  // Fences start unsignaled, nothing waits on a value before it was submitted.
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  fences.assign(std::max<size_t>(frames_in_flight, 1), VK_NULL_HANDLE);
+  fence_values.assign(fences.size(), 0);
+  completion_times.assign(fences.size(), std::chrono::steady_clock::now());
+  for (auto &fence : fences)
+  {
+    if (vkCreateFence(device->GetDevice(), &fence_info, nullptr, &fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to create frame fence!");
+  }
+}
+
+void FrameTimeline::DestroyFences()
+{
+  for (auto fence : fences)
+  {
+    if (fence != VK_NULL_HANDLE)
+      vkDestroyFence(device->GetDevice(), fence, nullptr);
+  }
+  fences.clear();
+}
+
+bool FrameTimeline::RetireOldest(const bool wait)
+{
+  if (completed == submitted)
+    return false;
+
+  // Submissions go to one queue, so their fences signal in order.
+  const size_t slot = SlotOf(completed + 1);
+  if (wait)
+    vkWaitForFences(device->GetDevice(), 1, &fences[slot], VK_TRUE, UINT64_MAX);
+  else if (vkGetFenceStatus(device->GetDevice(), fences[slot]) != VK_SUCCESS)
+    return false;
+
+  completed = fence_values[slot];
+  completion_times[slot] = std::chrono::steady_clock::now();
+  return true;
+}
+
+uint64_t FrameTimeline::Poll()
+{
+  while (RetireOldest(false));
+  return completed;
+}
+
+void FrameTimeline::Wait(const uint64_t value)
+{
+  while (completed < std::min(value, submitted) && RetireOldest(true));
+}
+
+VkFence FrameTimeline::Begin()
+{
+  const size_t slot = Slot();
+  if (pending)
+    return fences[slot];
+
+  // The fence of the next value last guarded the value frames_in_flight before it.
+  while (submitted - completed >= fences.size() && RetireOldest(true));
+  vkResetFences(device->GetDevice(), 1, &fences[slot]);
+  pending = true;
+  return fences[slot];
+}
+
+uint64_t FrameTimeline::Signal()
+{
+  if (!pending)
+    throw std::runtime_error("frame signaled without a fence from Begin!");
+
+  const size_t slot = Slot();
+  fence_values[slot] = ++submitted;
+  pending = false;
+  return submitted;
+}
+
+void FrameTimeline::SetFramesInFlight(const size_t frames_in_flight)
+{
+  if (std::max<size_t>(frames_in_flight, 1) == fences.size())
+    return;
+
+  WaitIdle();
+  DestroyFences();
+  CreateFences(frames_in_flight);
+  pending = false;
+}
@@ -0,0 +1,62 @@
+#ifndef __VISUALENGINE_FRAMETIMELINE_H
+#define __VISUALENGINE_FRAMETIMELINE_H
+
+#include "../VK-nn/Vulkan/Device.h"
+
+#include <vulkan/vulkan.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+// Frames numbered like the values of a timeline semaphore: every submission signals the next
+// value, values grow monotonically and a value is complete once all smaller values are, so
+// per-image and per-resource state keeps one value and waits on it, and frames_in_flight is a
+// plain limit on Submitted() - Completed(). The device is created without VK_KHR_timeline_semaphore,
+// so the values are backed by one fence per frame in flight, reused round-robin as in UploadManager.
+// Completions are only seen by Poll and Wait, which stamp them with the time they were seen.
+class FrameTimeline
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  std::vector<VkFence> fences;
+  std::vector<uint64_t> fence_values;
+  std::vector<std::chrono::steady_clock::time_point> completion_times;
+  uint64_t submitted = 0;
+  uint64_t completed = 0;
+  bool pending = false; // Begin returned a fence that no submission has taken yet
+
+  size_t SlotOf(const uint64_t value) const { return value % fences.size(); }
+  bool RetireOldest(const bool wait);
+  void CreateFences(const size_t frames_in_flight);
+  void DestroyFences();
+public:
+  FrameTimeline() = delete;
+  FrameTimeline(const FrameTimeline &obj) = delete;
+  FrameTimeline &operator=(const FrameTimeline &obj) = delete;
+  FrameTimeline(const std::shared_ptr<Vulkan::Device> dev, const size_t frames_in_flight);
+  ~FrameTimeline();
+
+  uint64_t Submitted() const { return submitted; }
+  uint64_t Completed() const { return completed; }
+  uint64_t NextValue() const { return submitted + 1; }
+  size_t FramesInFlight() const { return fences.size(); }
+  // Per frame-in-flight resources of the next value, such as acquire semaphores.
+  size_t Slot() const { return SlotOf(NextValue()); }
+
+  // Takes in every completion that already happened, without blocking. Returns Completed().
+  uint64_t Poll();
+  void Wait(const uint64_t value);
+  void WaitIdle() { Wait(submitted); }
+  // When the completion of value was seen, valid until value + FramesInFlight() completes.
+  std::chrono::steady_clock::time_point CompletionTime(const uint64_t value) const { return completion_times[SlotOf(value)]; }
+
+  // Waits until fewer than frames_in_flight values are pending and returns the unsignaled fence
+  // of the next value, for vkQueueSubmit. Signal then counts the submission, once it succeeded.
+  VkFence Begin();
+  uint64_t Signal();
+
+  // Waits for every value, the numbering goes on.
+  void SetFramesInFlight(const size_t frames_in_flight);
+};
+
+#endif
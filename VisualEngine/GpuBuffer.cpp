@@ -0,0 +1,88 @@
+#include "GpuBuffer.h"
+
+#include <cstring>
+#include <stdexcept>
+
+GpuBuffer::GpuBuffer(const std::shared_ptr<Vulkan::Device> dev, const VkDeviceSize buffer_size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties)
+{
+  device = dev;
+  allocator = DeviceAllocator::For(device);
+  size = buffer_size;
+  // Device local contents are copied when the buffer moves.
+  buffer_usage = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0 ? usage : usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+  buffer = CreateBuffer();
+
+  VkMemoryRequirements requirements = {};
+  vkGetBufferMemoryRequirements(device->GetDevice(), buffer, &requirements);
+
+  try
+  {
+    allocation = allocator->Allocate(requirements, properties, DeviceAllocator::Resource::Buffer);
+  }
+  catch (const std::runtime_error &)
+  {
+    vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+    throw;
+  }
+
+  vkBindBufferMemory(device->GetDevice(), buffer, allocation.memory, allocation.offset);
+  mapped = allocation.mapped;
+}
+
+GpuBuffer::~GpuBuffer()
+{
+  if (buffer != VK_NULL_HANDLE)
+    vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+  allocator->Free(allocation);
+}
+
+VkBuffer GpuBuffer::CreateBuffer() const
+{
+  VkBufferCreateInfo buffer_info = {};
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.size = size;
+  buffer_info.usage = buffer_usage;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer new_buffer = VK_NULL_HANDLE;
+  if (vkCreateBuffer(device->GetDevice(), &buffer_info, nullptr, &new_buffer) != VK_SUCCESS)
+    throw std::runtime_error("failed to create buffer!");
+  return new_buffer;
+}
+
+void GpuBuffer::SetMovable(std::function<void()> moved)
+{
+  on_moved = std::move(moved);
+  allocator->SetMover(allocation, [this](const VkCommandBuffer command_buffer, const DeviceAllocation &destination)
+  {
+    return Move(command_buffer, destination);
+  });
+}
+
+std::function<void()> GpuBuffer::Move(const VkCommandBuffer command_buffer, const DeviceAllocation &destination)
+{
+  const VkBuffer old_buffer = buffer;
+  buffer = CreateBuffer();
+  vkBindBufferMemory(device->GetDevice(), buffer, destination.memory, destination.offset);
+
+  if (mapped != nullptr)
+    std::memcpy(destination.mapped, mapped, size);
+  else
+  {
+    VkBufferCopy region = {};
+    region.size = size;
+    vkCmdCopyBuffer(command_buffer, old_buffer, buffer, 1, &region);
+  }
+  allocation = destination;
+  mapped = destination.mapped;
+
+  const std::shared_ptr<Vulkan::Device> dev = device;
+  const std::function<void()> moved = on_moved;
+  return [dev, old_buffer, moved]()
+  {
+    vkDestroyBuffer(dev->GetDevice(), old_buffer, nullptr);
+    if (moved)
+      moved();
+  };
+}
@@ -0,0 +1,46 @@
+#ifndef __VISUALENGINE_GPUBUFFER_H
+#define __VISUALENGINE_GPUBUFFER_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "DeviceAllocator.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+
+// Plain VkBuffer for usages StorageArray does not cover (indirect draw arguments, persistently
+// mapped per frame data), placed by the device's DeviceAllocator.
+class GpuBuffer
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  std::shared_ptr<DeviceAllocator> allocator;
+  DeviceAllocation allocation;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkBufferUsageFlags buffer_usage = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr;
+  std::function<void()> on_moved;
+
+  VkBuffer CreateBuffer() const;
+  std::function<void()> Move(const VkCommandBuffer command_buffer, const DeviceAllocation &destination);
+public:
+  GpuBuffer() = delete;
+  GpuBuffer(const GpuBuffer &obj) = delete;
+  GpuBuffer &operator=(const GpuBuffer &obj) = delete;
+  GpuBuffer(const std::shared_ptr<Vulkan::Device> dev, const VkDeviceSize buffer_size, const VkBufferUsageFlags usage, const VkMemoryPropertyFlags properties);
+  ~GpuBuffer();
+
+  VkBuffer GetBuffer() const { return buffer; }
+  VkDeviceSize Size() const { return size; }
+  // Host visible buffers stay mapped for their whole lifetime.
+  void *Data() const { return mapped; }
+  template <class T>
+  T *Data() const { return reinterpret_cast<T*>(mapped); }
+
+  // Lets DeviceAllocator::Defragment move the buffer. GetBuffer and Data change then, moved
+  // runs afterwards to rewrite descriptors and invalidate recorded commands using them.
+  void SetMovable(std::function<void()> moved);
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "GpuCulling.h"
+#include "FrameRing.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+  const VkDescriptorType descriptor_types[4] = {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC};
+}
+
+GpuCulling::GpuCulling(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const std::filesystem::path shader_file,
+                       UploadManager &uploader, const std::vector<glm::mat4> &object_matrices, const size_t images,
+                       const VkBuffer params_buffer, const VkDeviceSize instance_bytes)
+{
+  device = dev;
+  objects_count = (uint32_t) object_matrices.size();
+  instance_size = instance_bytes;
+
+  const VkDeviceSize alignment = FrameRing::OffsetAlignment(device->GetPhysicalDevice());
+  const VkDeviceSize objects_slots = std::max<VkDeviceSize>(objects_count, 1);
+  instances_stride = FrameRing::AlignedSize(instance_size * objects_slots, alignment);
+  draws_stride = FrameRing::AlignedSize(count_size + objects_slots * sizeof(VkDrawIndexedIndirectCommand), alignment);
+
+  objects = std::make_unique<GpuBuffer>(device, objects_slots * sizeof(glm::mat4),
+                                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  instances = std::make_unique<GpuBuffer>(device, instances_stride * images, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  draws = std::make_unique<GpuBuffer>(device, draws_stride * images,
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  if (!object_matrices.empty())
+    upload_value = uploader.UploadBuffer(objects->GetBuffer(), 0, object_matrices);
+
+  PrepareDescriptors(params_buffer);
+  // The defragmenter may move them, recorded commands that used them are recorded again.
+  objects->SetMovable([this]() { WriteDescriptors(); });
+  instances->SetMovable([this]() { WriteDescriptors(); });
+  draws->SetMovable([this]() { WriteDescriptors(); });
+  pipeline = std::make_unique<ComputePipeline>(device, cache, shader_file, std::vector<VkDescriptorSetLayout>{set_layout});
+}
+
+GpuCulling::~GpuCulling()
+{
+  pipeline.reset();
+  if (descriptor_pool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device->GetDevice(), descriptor_pool, nullptr);
+  if (set_layout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device->GetDevice(), set_layout, nullptr);
+}
+
+void GpuCulling::PrepareDescriptors(const VkBuffer params_buffer)
+{
+  VkDescriptorSetLayoutBinding bindings[4] = {};
+  VkDescriptorPoolSize pool_sizes[4] = {};
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = descriptor_types[i];
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pool_sizes[i].type = descriptor_types[i];
+    pool_sizes[i].descriptorCount = 1;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 4;
+  layout_info.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device->GetDevice(), &layout_info, nullptr, &set_layout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 4;
+  pool_info.pPoolSizes = pool_sizes;
+  if (vkCreateDescriptorPool(device->GetDevice(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &set_layout;
+  if (vkAllocateDescriptorSets(device->GetDevice(), &alloc_info, &descriptor_set) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor set!");
+
+  params = params_buffer;
+  WriteDescriptors();
+}
+
+void GpuCulling::WriteDescriptors()
+{
+  const VkDeviceSize objects_slots = std::max<VkDeviceSize>(objects_count, 1);
+  VkDescriptorBufferInfo buffer_infos[4] = {
+    {params, 0, sizeof(CullParams)},
+    {objects->GetBuffer(), 0, objects_slots * sizeof(glm::mat4)},
+    {instances->GetBuffer(), 0, instance_size * objects_slots},
+    {draws->GetBuffer(), 0, count_size + objects_slots * sizeof(VkDrawIndexedIndirectCommand)}
+  };
+
+  VkWriteDescriptorSet writes[4] = {};
+  for (uint32_t i = 0; i < 4; ++i)
+  {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptor_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = descriptor_types[i];
+    writes[i].pBufferInfo = &buffer_infos[i];
+  }
+  vkUpdateDescriptorSets(device->GetDevice(), 4, writes, 0, nullptr);
+}
+
+void GpuCulling::Dispatch(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t params_offset)
+{
+  // The image's previous submission has completed, its region only needs the count reset.
+  // Every command is drawn, so those past the count have to be empty.
+  const VkDeviceSize draws_offset = draws_stride * image_index;
+  const VkDeviceSize clear_size = count_size + (VkDeviceSize) objects_count * sizeof(VkDrawIndexedIndirectCommand);
+  vkCmdFillBuffer(command_buffer, draws->GetBuffer(), draws_offset, clear_size, 0);
+
+  VkMemoryBarrier cleared = {};
+  cleared.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  cleared.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  cleared.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &cleared, 0, nullptr, 0, nullptr);
+
+  if (objects_count > 0)
+  {
+    const uint32_t dynamic_offsets[] = {params_offset, (uint32_t) GetInstancesOffset(image_index), (uint32_t) draws_offset};
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetPipeline());
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->GetLayout(), 0, 1, &descriptor_set, 3, dynamic_offsets);
+    vkCmdDispatch(command_buffer, (objects_count + group_size - 1) / group_size, 1, 1);
+  }
+}
+
+void GpuCulling::Draw(const VkCommandBuffer command_buffer, const size_t image_index)
+{
+  const VkDeviceSize draws_offset = draws_stride * image_index;
+  vkCmdDrawIndexedIndirect(command_buffer, draws->GetBuffer(), draws_offset + count_size, objects_count, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,94 @@
+#ifndef __VISUALENGINE_GPUCULLING_H
+#define __VISUALENGINE_GPUCULLING_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "ComputePipeline.h"
+#include "UploadManager.h"
+#include "GpuBuffer.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+// Per frame input of Shaders/cull.comp (std140), written into the frame ring.
+struct CullParams
+{
+  glm::vec4 planes[6];        // Frustum::planes
+  glm::mat4 object_transform; // shared by every object, applied after its own matrix
+  glm::mat4 vertex_transform; // packed positions to object space
+  glm::vec4 eye;              // xyz: camera position, w: projection scale as in TestObject::SelectLod
+  glm::vec4 bounds_min;       // xyz: object space box, w: LOD pixel error
+  glm::vec4 bounds_max;
+  glm::vec4 sphere;           // xyz: object space center, w: radius
+  uint32_t objects_count;
+  uint32_t lods_count;
+  uint32_t material;          // written into every instance
+  uint32_t padding;
+  struct
+  {
+    uint32_t index_offset;
+    uint32_t index_count;
+    float error;
+    float padding;
+  } lods[8];
+};
+
+// Frustum culling, LOD selection and draw compaction in a compute pass. Object matrices live
+// in a device local buffer written once, every frame the shader appends one instance and one
+// indirect command per visible object, so the CPU cost no longer grows with the object count.
+// Instances and commands have a region per image, selected with dynamic offsets like the
+// frame ring. Commands past the draw count are zeroed beforehand and all of them are drawn:
+// vkCmdDrawIndexedIndirectCount needs VK_KHR_draw_indirect_count or the Vulkan 1.2 feature,
+// and VK-nn creates the device without either.
+class GpuCulling
+{
+private:
+  static constexpr uint32_t group_size = 64;
+  static constexpr VkDeviceSize count_size = 16; // draw count, padded to the start of the commands
+
+  std::shared_ptr<Vulkan::Device> device;
+  std::unique_ptr<ComputePipeline> pipeline;
+  std::unique_ptr<GpuBuffer> objects;
+  std::unique_ptr<GpuBuffer> instances;
+  std::unique_ptr<GpuBuffer> draws;
+  VkDeviceSize instances_stride = 0;
+  VkDeviceSize draws_stride = 0;
+  VkDeviceSize instance_size = 0;
+  uint32_t objects_count = 0;
+  uint64_t upload_value = 0;
+
+  VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+  VkBuffer params = VK_NULL_HANDLE;
+
+  void PrepareDescriptors(const VkBuffer params_buffer);
+  void WriteDescriptors();
+public:
+  GpuCulling() = delete;
+  GpuCulling(const GpuCulling &obj) = delete;
+  GpuCulling &operator=(const GpuCulling &obj) = delete;
+  // params_buffer holds a CullParams at the offset given to Dispatch, instance_bytes is the
+  // size of one InstanceData as read by the vertex shader.
+  GpuCulling(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const std::filesystem::path shader_file,
+             UploadManager &uploader, const std::vector<glm::mat4> &object_matrices, const size_t images,
+             const VkBuffer params_buffer, const VkDeviceSize instance_bytes);
+  ~GpuCulling();
+
+  // Wait on this value before the first dispatch.
+  uint64_t GetUploadValue() const { return upload_value; }
+
+  // Recorded into the image's primary buffer before the render pass that draws. Instances and
+  // commands are written by the compute stage, the caller makes them visible to the draws.
+  void Dispatch(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t params_offset);
+  void Draw(const VkCommandBuffer command_buffer, const size_t image_index);
+
+  // Compacted instances of every image, bound in place of the frame ring instances.
+  VkBuffer GetInstancesBuffer() const { return instances->GetBuffer(); }
+  VkDeviceSize GetInstancesRange() const { return instance_size * objects_count; }
+  VkDeviceSize GetInstancesOffset(const size_t image_index) const { return instances_stride * image_index; }
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+  const VkQueryPipelineStatisticFlags statistics_flags = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+                                                         VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+                                                         VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+                                                         VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+                                                         VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+                                                         VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+  // Counters come back in bit order, followed by the availability word.
+  const size_t statistics_words = 6 + 1;
+
+  VkQueryPool CreateQueryPool(const VkDevice device, const VkQueryType type, const uint32_t count, const VkQueryPipelineStatisticFlags flags)
+  {
+    VkQueryPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = type;
+    pool_info.queryCount = count;
+    pool_info.pipelineStatistics = flags;
+
+    VkQueryPool pool = VK_NULL_HANDLE;
+    if (vkCreateQueryPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create query pool!");
+    return pool;
+  }
+}
+
+GpuProfiler::GpuProfiler(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const size_t images, const bool pipeline_statistics,
+                         const uint32_t passes_count, const uint32_t statistics_count)
+{
+  device = dev;
+  images_count = std::max<size_t>(images, 1);
+  max_passes = std::max<uint32_t>(passes_count, 1);
+  statistics_slots = std::max<uint32_t>(statistics_count, 1);
+  submitted.assign(images_count, false);
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+  timestamp_period = properties.limits.timestampPeriod;
+
+  uint32_t families_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device->GetPhysicalDevice(), &families_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(families_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(device->GetPhysicalDevice(), &families_count, families.data());
+  const uint32_t valid_bits = queue_family < families_count ? families[queue_family].timestampValidBits : 0;
+
+  // Queues without timestamp support leave the pass times empty, statistics still work.
+  if (valid_bits > 0)
+  {
+    timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+    timestamps = CreateQueryPool(device->GetDevice(), VK_QUERY_TYPE_TIMESTAMP, (uint32_t) images_count * max_passes * 2, 0);
+  }
+  if (pipeline_statistics)
+    statistics = CreateQueryPool(device->GetDevice(), VK_QUERY_TYPE_PIPELINE_STATISTICS, (uint32_t) images_count * statistics_slots, statistics_flags);
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  if (timestamps != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device->GetDevice(), timestamps, nullptr);
+  if (statistics != VK_NULL_HANDLE)
+    vkDestroyQueryPool(device->GetDevice(), statistics, nullptr);
+}
+
+uint32_t GpuProfiler::AddPass(const std::string &name)
+{
+  auto it = std::find(passes.begin(), passes.end(), name);
+  if (it != passes.end())
+    return (uint32_t) (it - passes.begin());
+
+  if (passes.size() >= max_passes)
+    throw std::runtime_error("too many profiled passes!");
+  passes.push_back(name);
+  return (uint32_t) passes.size() - 1;
+}
+
+void GpuProfiler::Reset(const VkCommandBuffer command_buffer, const size_t image_index)
+{
+  if (HasTimestamps())
+    vkCmdResetQueryPool(command_buffer, timestamps, TimestampQuery(image_index, 0, false), max_passes * 2);
+  if (HasStatistics())
+    vkCmdResetQueryPool(command_buffer, statistics, StatisticsQuery(image_index, 0), statistics_slots);
+}
+
+void GpuProfiler::BeginPass(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t pass)
+{
+  if (HasTimestamps() && pass < max_passes)
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamps, TimestampQuery(image_index, pass, false));
+}
+
+void GpuProfiler::EndPass(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t pass)
+{
+  if (HasTimestamps() && pass < max_passes)
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestamps, TimestampQuery(image_index, pass, true));
+}
+
+void GpuProfiler::BeginStatistics(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t slot)
+{
+  if (HasStatistics() && slot < statistics_slots)
+    vkCmdBeginQuery(command_buffer, statistics, StatisticsQuery(image_index, slot), 0);
+}
+
+void GpuProfiler::EndStatistics(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t slot)
+{
+  if (HasStatistics() && slot < statistics_slots)
+    vkCmdEndQuery(command_buffer, statistics, StatisticsQuery(image_index, slot));
+}
+
+bool GpuProfiler::Collect(const size_t image_index, GpuFrameTimings &timings)
+{
+  const size_t image = image_index % images_count;
+  if (!submitted[image])
+    return false;
+  submitted[image] = false;
+
+  // Availability is read per query: passes and slots that were not written this
+  // execution stay unavailable after the reset and are skipped instead of blocking.
+  const VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT;
+  timings.pass_ms.assign(passes.size(), std::numeric_limits<double>::quiet_NaN());
+  timings.statistics = PipelineStatistics();
+
+  if (HasTimestamps() && !passes.empty())
+  {
+    std::vector<uint64_t> results(passes.size() * 2 * 2);
+    VkResult res = vkGetQueryPoolResults(device->GetDevice(), timestamps, TimestampQuery(image, 0, false), (uint32_t) passes.size() * 2,
+                                         results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), flags);
+    if (res == VK_SUCCESS || res == VK_NOT_READY)
+    {
+      for (size_t p = 0; p < passes.size(); ++p)
+      {
+        const uint64_t *begin = &results[p * 4];
+        const uint64_t *end = &results[p * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0)
+          continue;
+        const uint64_t ticks = ((end[0] & timestamp_mask) - (begin[0] & timestamp_mask)) & timestamp_mask;
+        timings.pass_ms[p] = ticks * timestamp_period * 1e-6;
+      }
+    }
+  }
+
+  if (HasStatistics())
+  {
+    std::vector<uint64_t> results(statistics_slots * statistics_words);
+    VkResult res = vkGetQueryPoolResults(device->GetDevice(), statistics, StatisticsQuery(image, 0), statistics_slots,
+                                         results.size() * sizeof(uint64_t), results.data(), statistics_words * sizeof(uint64_t), flags);
+    if (res == VK_SUCCESS || res == VK_NOT_READY)
+    {
+      for (uint32_t s = 0; s < statistics_slots; ++s)
+      {
+        const uint64_t *slot = &results[s * statistics_words];
+        if (slot[statistics_words - 1] == 0)
+          continue;
+        timings.statistics.input_vertices += slot[0];
+        timings.statistics.input_primitives += slot[1];
+        timings.statistics.vertex_invocations += slot[2];
+        timings.statistics.clipping_invocations += slot[3];
+        timings.statistics.clipping_primitives += slot[4];
+        timings.statistics.fragment_invocations += slot[5];
+      }
+    }
+  }
+
+  return true;
+}
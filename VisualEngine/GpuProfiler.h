@@ -0,0 +1,85 @@
+#ifndef __VISUALENGINE_GPUPROFILER_H
+#define __VISUALENGINE_GPUPROFILER_H
+
+#include "../VK-nn/Vulkan/Device.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct PipelineStatistics
+{
+  uint64_t input_vertices = 0;
+  uint64_t input_primitives = 0;
+  uint64_t vertex_invocations = 0;
+  uint64_t clipping_invocations = 0;
+  uint64_t clipping_primitives = 0;
+  uint64_t fragment_invocations = 0;
+};
+
+// Results of one execution of an image's command buffer, pass times are NaN when a
+// pass was not written by that execution.
+struct GpuFrameTimings
+{
+  std::vector<double> pass_ms;
+  PipelineStatistics statistics;
+};
+
+// Timestamp and pipeline statistics queries with one range per swapchain image, so the
+// queries live in the pre-recorded command buffers and are read back once the image's
+// fence has signaled, without ever stalling on the GPU.
+// Timestamps bracket whole passes from the primary buffer, statistics slots bracket
+// draws and may be begun and ended inside secondary buffers.
+class GpuProfiler
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkQueryPool timestamps = VK_NULL_HANDLE;
+  VkQueryPool statistics = VK_NULL_HANDLE;
+  size_t images_count = 0;
+  uint32_t max_passes = 0;
+  uint32_t statistics_slots = 0;
+  double timestamp_period = 1.0;
+  uint64_t timestamp_mask = 0;
+  std::vector<std::string> passes;
+  std::vector<bool> submitted;
+
+  uint32_t TimestampQuery(const size_t image_index, const uint32_t pass, const bool end) const
+  {
+    return (uint32_t) (image_index % images_count) * max_passes * 2 + pass * 2 + (end ? 1 : 0);
+  }
+  uint32_t StatisticsQuery(const size_t image_index, const uint32_t slot) const
+  {
+    return (uint32_t) (image_index % images_count) * statistics_slots + slot;
+  }
+public:
+  GpuProfiler() = delete;
+  GpuProfiler(const GpuProfiler &obj) = delete;
+  GpuProfiler &operator=(const GpuProfiler &obj) = delete;
+  // pipeline_statistics must match the pipelineStatisticsQuery feature the device was created with.
+  GpuProfiler(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const size_t images, const bool pipeline_statistics,
+              const uint32_t passes_count = 8, const uint32_t statistics_count = 8);
+  ~GpuProfiler();
+
+  // Passes are registered before recording, the index is what Begin/EndPass take.
+  uint32_t AddPass(const std::string &name);
+  const std::vector<std::string> &PassNames() const { return passes; }
+  bool HasTimestamps() const { return timestamps != VK_NULL_HANDLE; }
+  bool HasStatistics() const { return statistics != VK_NULL_HANDLE; }
+
+  // Recorded first into the image's primary buffer, outside any render pass.
+  void Reset(const VkCommandBuffer command_buffer, const size_t image_index);
+  // Timestamps are outside render passes whose contents are secondary buffers.
+  void BeginPass(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t pass);
+  void EndPass(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t pass);
+  void BeginStatistics(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t slot);
+  void EndStatistics(const VkCommandBuffer command_buffer, const size_t image_index, const uint32_t slot);
+
+  void Submitted(const size_t image_index) { submitted[image_index % images_count] = true; }
+  // Reads the last submission of the image, the caller has waited for its fence.
+  // Returns false when the image was not submitted since the previous Collect.
+  bool Collect(const size_t image_index, GpuFrameTimings &timings);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "GraphicsPipeline.h"
+
+#include <stdexcept>
+
+GraphicsPipeline::GraphicsPipeline(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const VkRenderPass render_pass, const PipelineConfig &config)
+{
+  device = dev;
+
+  VkPipelineLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = (uint32_t) config.set_layouts.size();
+  layout_info.pSetLayouts = config.set_layouts.data();
+  if (vkCreatePipelineLayout(device->GetDevice(), &layout_info, nullptr, &layout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create pipeline layout!");
+
+  std::vector<VkPipelineShaderStageCreateInfo> stages(config.shaders.size());
+  std::vector<std::vector<VkSpecializationMapEntry>> specialization_entries(stages.size());
+  std::vector<std::vector<uint32_t>> specialization_data(stages.size());
+  std::vector<VkSpecializationInfo> specialization_infos(stages.size());
+  for (size_t i = 0; i < stages.size(); ++i)
+  {
+    stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[i].stage = config.shaders[i].stage;
+    stages[i].module = cache.GetShaderModule(config.shaders[i].file);
+    stages[i].pName = config.shaders[i].entry.c_str();
+
+    for (auto &specialization : config.specializations)
+    {
+      if (specialization.stage != stages[i].stage)
+        continue;
+      const uint32_t offset = (uint32_t) (specialization_data[i].size() * sizeof(uint32_t));
+      specialization_entries[i].push_back({specialization.id, offset, sizeof(uint32_t)});
+      specialization_data[i].push_back(specialization.value);
+    }
+    if (specialization_entries[i].empty())
+      continue;
+    specialization_infos[i].mapEntryCount = (uint32_t) specialization_entries[i].size();
+    specialization_infos[i].pMapEntries = specialization_entries[i].data();
+    specialization_infos[i].dataSize = specialization_data[i].size() * sizeof(uint32_t);
+    specialization_infos[i].pData = specialization_data[i].data();
+    stages[i].pSpecializationInfo = &specialization_infos[i];
+  }
+
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  for (auto &input_binding : config.input_bindings)
+  {
+    bindings.push_back(input_binding.first);
+    attributes.insert(attributes.end(), input_binding.second.begin(), input_binding.second.end());
+  }
+
+  VkPipelineVertexInputStateCreateInfo vertex_input = {};
+  vertex_input.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input.vertexBindingDescriptionCount = (uint32_t) bindings.size();
+  vertex_input.pVertexBindingDescriptions = bindings.data();
+  vertex_input.vertexAttributeDescriptionCount = (uint32_t) attributes.size();
+  vertex_input.pVertexAttributeDescriptions = attributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+  input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+  // Viewport and scissor are expected to be dynamic, so the pipeline outlives swapchain resizes.
+  VkPipelineViewportStateCreateInfo viewport_state = {};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterization = {};
+  rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization.polygonMode = config.polygon_mode;
+  rasterization.cullMode = config.cull_mode;
+  rasterization.frontFace = config.front_face;
+  rasterization.depthBiasEnable = config.depth_bias ? VK_TRUE : VK_FALSE;
+  rasterization.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisample = {};
+  multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample.rasterizationSamples = config.samples;
+  multisample.sampleShadingEnable = config.sample_shading ? VK_TRUE : VK_FALSE;
+  multisample.minSampleShading = config.min_sample_shading;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+  depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil.depthTestEnable = config.depth_test ? VK_TRUE : VK_FALSE;
+  depth_stencil.depthWriteEnable = config.depth_test ? VK_TRUE : VK_FALSE;
+  depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+  depth_stencil.maxDepthBounds = 1.0f;
+
+  VkPipelineColorBlendAttachmentState blend_attachment = {};
+  blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+  VkPipelineColorBlendStateCreateInfo color_blend = {};
+  color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  color_blend.logicOp = VK_LOGIC_OP_COPY;
+  color_blend.attachmentCount = 1;
+  color_blend.pAttachments = &blend_attachment;
+
+  VkPipelineDynamicStateCreateInfo dynamic_state = {};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = (uint32_t) config.dynamic_states.size();
+  dynamic_state.pDynamicStates = config.dynamic_states.data();
+
+  VkGraphicsPipelineCreateInfo pipeline_info = {};
+  pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipeline_info.stageCount = (uint32_t) stages.size();
+  pipeline_info.pStages = stages.data();
+  pipeline_info.pVertexInputState = &vertex_input;
+  pipeline_info.pInputAssemblyState = &input_assembly;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pRasterizationState = &rasterization;
+  pipeline_info.pMultisampleState = &multisample;
+  pipeline_info.pDepthStencilState = &depth_stencil;
+  pipeline_info.pColorBlendState = &color_blend;
+  pipeline_info.pDynamicState = &dynamic_state;
+  pipeline_info.layout = layout;
+  pipeline_info.renderPass = render_pass;
+  pipeline_info.subpass = 0;
+  pipeline_info.basePipelineIndex = -1;
+
+  if (vkCreateGraphicsPipelines(device->GetDevice(), cache.GetCache(), 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+  {
+    vkDestroyPipelineLayout(device->GetDevice(), layout, nullptr);
+    throw std::runtime_error("failed to create graphics pipeline!");
+  }
+}
+
+GraphicsPipeline::~GraphicsPipeline()
+{
+  if (pipeline != VK_NULL_HANDLE)
+    vkDestroyPipeline(device->GetDevice(), pipeline, nullptr);
+  if (layout != VK_NULL_HANDLE)
+    vkDestroyPipelineLayout(device->GetDevice(), layout, nullptr);
+}
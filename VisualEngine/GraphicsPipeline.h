@@ -0,0 +1,82 @@
+#ifndef __VISUALENGINE_GRAPHICSPIPELINE_H
+#define __VISUALENGINE_GRAPHICSPIPELINE_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "PipelineCache.h"
+#include "Vertex.h"
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+class PipelineConfig
+{
+private:
+  friend class GraphicsPipeline;
+  struct Shader
+  {
+    VkShaderStageFlagBits stage;
+    std::filesystem::path file;
+    std::string entry;
+  };
+
+  struct Specialization
+  {
+    VkShaderStageFlagBits stage;
+    uint32_t id;
+    uint32_t value;
+  };
+
+  std::vector<Shader> shaders;
+  std::vector<Specialization> specializations;
+  std::vector<VertexBindingDescription> input_bindings;
+  std::vector<VkDescriptorSetLayout> set_layouts;
+  std::vector<VkDynamicState> dynamic_states;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  bool sample_shading = false;
+  float min_sample_shading = 1.0f;
+  bool depth_test = false;
+  bool depth_bias = false;
+  VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
+  VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+public:
+  PipelineConfig() = default;
+  ~PipelineConfig() = default;
+  PipelineConfig &AddShader(const VkShaderStageFlagBits stage, const std::filesystem::path file, const std::string entry = "main") { shaders.push_back({stage, file, entry}); return *this; }
+  // 32 bit constant_id values, e.g. array sizes only known once the device is.
+  PipelineConfig &AddSpecializationConstant(const VkShaderStageFlagBits stage, const uint32_t id, const uint32_t value) { specializations.push_back({stage, id, value}); return *this; }
+  PipelineConfig &AddInputBinding(const VertexBindingDescription &binding) { input_bindings.push_back(binding); return *this; }
+  PipelineConfig &AddDescriptorSetLayouts(const std::vector<VkDescriptorSetLayout> &layouts) { set_layouts.insert(set_layouts.end(), layouts.begin(), layouts.end()); return *this; }
+  PipelineConfig &AddDynamicState(const VkDynamicState state) { dynamic_states.push_back(state); return *this; }
+  PipelineConfig &SetSamplesCount(const VkSampleCountFlagBits count) { samples = count; return *this; }
+  PipelineConfig &UseSampleShading(const bool enable, const float min_fraction = 1.0f) { sample_shading = enable; min_sample_shading = min_fraction; return *this; }
+  PipelineConfig &UseDepthTesting(const bool enable) { depth_test = enable; return *this; }
+  PipelineConfig &UseDepthBias(const bool enable) { depth_bias = enable; return *this; }
+  PipelineConfig &SetCullMode(const VkCullModeFlags mode) { cull_mode = mode; return *this; }
+  PipelineConfig &SetFace(const VkFrontFace face) { front_face = face; return *this; }
+  PipelineConfig &SetPolygonMode(const VkPolygonMode mode) { polygon_mode = mode; return *this; }
+};
+
+// Graphics pipeline and its layout, created through the shared PipelineCache so
+// shader modules are reused and compiled state survives restarts.
+class GraphicsPipeline
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout layout = VK_NULL_HANDLE;
+public:
+  GraphicsPipeline() = delete;
+  GraphicsPipeline(const GraphicsPipeline &obj) = delete;
+  GraphicsPipeline &operator=(const GraphicsPipeline &obj) = delete;
+  GraphicsPipeline(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &cache, const VkRenderPass render_pass, const PipelineConfig &config);
+  ~GraphicsPipeline();
+
+  VkPipeline GetPipeline() const { return pipeline; }
+  VkPipelineLayout GetLayout() const { return layout; }
+};
+
+#endif
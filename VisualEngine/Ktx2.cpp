@@ -0,0 +1,250 @@
+#include "Ktx2.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+  // Khronos Data Format values used by the basic descriptor block.
+  constexpr uint32_t model_bc1a = 128;
+  constexpr uint32_t model_bc3 = 130;
+  constexpr uint32_t model_bc5 = 132;
+  constexpr uint32_t model_bc7 = 134;
+  constexpr uint32_t primaries_bt709 = 1;
+  constexpr uint32_t transfer_linear = 1;
+  constexpr uint32_t transfer_srgb = 2;
+  constexpr uint32_t channel_color = 0;
+  constexpr uint32_t channel_green = 1;
+  constexpr uint32_t channel_alpha = 15;
+  constexpr uint32_t basic_block_header = 24;
+  constexpr uint32_t sample_size = 16;
+
+  bool IsSrgb(const VkFormat format)
+  {
+    return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+  }
+
+  uint64_t Align(const uint64_t offset, const uint64_t alignment)
+  {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+}
+
+size_t Ktx2Texture::BlockSize(const VkFormat format)
+{
+  switch (format)
+  {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      return 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+size_t Ktx2Texture::LevelSize(const VkFormat format, const uint32_t width, const uint32_t height)
+{
+  return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * BlockSize(format);
+}
+
+std::vector<uint32_t> Ktx2Texture::DataFormatDescriptor(const VkFormat format)
+{
+  // One sample per 64 bit half of the block: BC3 is alpha + color, BC5 is red + green.
+  struct Sample { uint32_t bit_offset; uint32_t bit_length; uint32_t channel; };
+  std::vector<Sample> samples;
+  uint32_t model = 0;
+  switch (format)
+  {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+      model = model_bc1a;
+      samples = { { 0, 64, channel_color } };
+      break;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      model = model_bc3;
+      samples = { { 0, 64, channel_alpha }, { 64, 64, channel_color } };
+      break;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      model = model_bc5;
+      samples = { { 0, 64, channel_color }, { 64, 64, channel_green } };
+      break;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      model = model_bc7;
+      samples = { { 0, 128, channel_color } };
+      break;
+    default:
+      return {};
+  }
+
+  const uint32_t block_size = basic_block_header + sample_size * (uint32_t) samples.size();
+  std::vector<uint32_t> dfd =
+  {
+    block_size + 4,
+    0,
+    2 | (block_size << 16),
+    model | (primaries_bt709 << 8) | ((IsSrgb(format) ? transfer_srgb : transfer_linear) << 16),
+    3 | (3 << 8),
+    (uint32_t) BlockSize(format),
+    0
+  };
+  for (auto &sample : samples)
+  {
+    dfd.push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+    dfd.push_back(0);
+    dfd.push_back(0);
+    dfd.push_back(UINT32_MAX);
+  }
+
+  return dfd;
+}
+
+bool Ktx2Texture::Save(const std::filesystem::path ktx2_file) const
+{
+  const size_t block_size = BlockSize(format);
+  if (block_size == 0 || levels.empty() || width == 0 || height == 0)
+  {
+    return false;
+  }
+
+  std::vector<uint32_t> dfd = DataFormatDescriptor(format);
+
+  Header header = {};
+  std::memcpy(header.identifier, file_identifier, sizeof(file_identifier));
+  header.vk_format = (uint32_t) format;
+  header.type_size = 1;
+  header.pixel_width = width;
+  header.pixel_height = height;
+  header.face_count = 1;
+  header.level_count = (uint32_t) levels.size();
+  header.dfd_byte_offset = (uint32_t) (sizeof(Header) + sizeof(LevelIndex) * levels.size());
+  header.dfd_byte_length = (uint32_t) (dfd.size() * sizeof(uint32_t));
+
+  std::vector<LevelIndex> index(levels.size());
+  uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+  for (size_t i = levels.size(); i-- > 0;)
+  {
+    const uint32_t level_w = std::max<uint32_t>(width >> i, 1);
+    const uint32_t level_h = std::max<uint32_t>(height >> i, 1);
+    if (levels[i].size() != LevelSize(format, level_w, level_h))
+    {
+      return false;
+    }
+
+    offset = Align(offset, block_size);
+    index[i] = { offset, levels[i].size(), levels[i].size() };
+    offset += levels[i].size();
+  }
+
+  // Written next to the final name first, so a reader never sees a partial file.
+  std::filesystem::path tmp_file = ktx2_file;
+  tmp_file += ".tmp";
+  {
+    std::ofstream file(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+      return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(index.data()), sizeof(LevelIndex) * index.size());
+    file.write(reinterpret_cast<const char*>(dfd.data()), header.dfd_byte_length);
+
+    uint64_t position = header.dfd_byte_offset + header.dfd_byte_length;
+    const char padding[16] = {};
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+      file.write(padding, (std::streamsize) (index[i].byte_offset - position));
+      file.write(reinterpret_cast<const char*>(levels[i].data()), (std::streamsize) levels[i].size());
+      position = index[i].byte_offset + index[i].byte_length;
+    }
+
+    if (!file.good())
+    {
+      return false;
+    }
+  }
+
+  std::error_code err;
+  std::filesystem::rename(tmp_file, ktx2_file, err);
+  return !err;
+}
+
+bool Ktx2Texture::Load(const std::filesystem::path ktx2_file)
+{
+  levels.clear();
+
+  std::ifstream file(ktx2_file, std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  const uint64_t file_size = (uint64_t) file.tellg();
+  file.seekg(0);
+
+  Header header = {};
+  if (file_size < sizeof(Header) || !file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+  {
+    return false;
+  }
+
+  // Only what Save produces is accepted: a single 2D face, every level present, no supercompression.
+  const VkFormat file_format = (VkFormat) header.vk_format;
+  bool valid = std::memcmp(header.identifier, file_identifier, sizeof(file_identifier)) == 0 &&
+               BlockSize(file_format) != 0 &&
+               header.type_size == 1 &&
+               header.pixel_width > 0 && header.pixel_height > 0 &&
+               header.pixel_depth == 0 && header.layer_count == 0 && header.face_count == 1 &&
+               header.level_count > 0 && header.level_count <= 32 &&
+               header.supercompression_scheme == 0 &&
+               (uint64_t) header.dfd_byte_offset + header.dfd_byte_length <= file_size;
+  if (!valid)
+  {
+    return false;
+  }
+
+  std::vector<LevelIndex> index(header.level_count);
+  std::vector<uint32_t> dfd(header.dfd_byte_length / sizeof(uint32_t));
+  if (!file.read(reinterpret_cast<char*>(index.data()), sizeof(LevelIndex) * index.size()) ||
+      !file.seekg(header.dfd_byte_offset) ||
+      !file.read(reinterpret_cast<char*>(dfd.data()), dfd.size() * sizeof(uint32_t)) ||
+      dfd != DataFormatDescriptor(file_format))
+  {
+    return false;
+  }
+
+  levels.resize(header.level_count);
+  for (size_t i = 0; i < levels.size(); ++i)
+  {
+    const uint32_t level_w = std::max<uint32_t>(header.pixel_width >> i, 1);
+    const uint32_t level_h = std::max<uint32_t>(header.pixel_height >> i, 1);
+    const uint64_t expected = LevelSize(file_format, level_w, level_h);
+    if (index[i].byte_length != expected || index[i].uncompressed_byte_length != expected ||
+        index[i].byte_offset + index[i].byte_length > file_size)
+    {
+      levels.clear();
+      return false;
+    }
+
+    levels[i].resize(expected);
+    if (!file.seekg((std::streamoff) index[i].byte_offset) || !file.read(reinterpret_cast<char*>(levels[i].data()), (std::streamsize) expected))
+    {
+      levels.clear();
+      return false;
+    }
+  }
+
+  format = file_format;
+  width = header.pixel_width;
+  height = header.pixel_height;
+  return true;
+}
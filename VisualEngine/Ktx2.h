@@ -0,0 +1,58 @@
+#ifndef __VISUALENGINE_KTX2_H
+#define __VISUALENGINE_KTX2_H
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+
+// Minimal KTX2 container for 2D block-compressed textures, no supercompression and no key/value data.
+// levels[0] is the base level, in the file the levels are stored smallest first.
+class Ktx2Texture
+{
+private:
+  struct Header
+  {
+    uint8_t identifier[12];
+    uint32_t vk_format;
+    uint32_t type_size;
+    uint32_t pixel_width;
+    uint32_t pixel_height;
+    uint32_t pixel_depth;
+    uint32_t layer_count;
+    uint32_t face_count;
+    uint32_t level_count;
+    uint32_t supercompression_scheme;
+    uint32_t dfd_byte_offset;
+    uint32_t dfd_byte_length;
+    uint32_t kvd_byte_offset;
+    uint32_t kvd_byte_length;
+    uint64_t sgd_byte_offset;
+    uint64_t sgd_byte_length;
+  };
+
+  struct LevelIndex
+  {
+    uint64_t byte_offset;
+    uint64_t byte_length;
+    uint64_t uncompressed_byte_length;
+  };
+
+  static constexpr uint8_t file_identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+  static std::vector<uint32_t> DataFormatDescriptor(const VkFormat format);
+public:
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<std::vector<uint8_t>> levels;
+
+  bool Load(const std::filesystem::path ktx2_file);
+  bool Save(const std::filesystem::path ktx2_file) const;
+
+  // Bytes per 4x4 block, 0 for formats the container does not handle.
+  static size_t BlockSize(const VkFormat format);
+  static size_t LevelSize(const VkFormat format, const uint32_t width, const uint32_t height);
+};
+
+#endif
@@ -0,0 +1,117 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+MaterialTable::MaterialTable(const std::shared_ptr<Vulkan::Device> dev, const uint32_t max_textures, const uint32_t max_materials)
+{
+  device = dev;
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+  textures_capacity = std::min({max_textures, properties.limits.maxPerStageDescriptorSamplers, properties.limits.maxPerStageDescriptorSampledImages});
+  materials_capacity = std::max<uint32_t>(max_materials, 1);
+
+  materials = std::make_unique<GpuBuffer>(device, materials_capacity * sizeof(Material), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  bindings[0].descriptorCount = textures_capacity;
+  bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding = 1;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 2;
+  layout_info.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device->GetDevice(), &layout_info, nullptr, &set_layout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  VkDescriptorPoolSize pool_sizes[2] = {};
+  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_sizes[0].descriptorCount = textures_capacity;
+  pool_sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  pool_sizes[1].descriptorCount = 1;
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 2;
+  pool_info.pPoolSizes = pool_sizes;
+  if (vkCreateDescriptorPool(device->GetDevice(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &set_layout;
+  if (vkAllocateDescriptorSets(device->GetDevice(), &alloc_info, &descriptor_set) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor set!");
+
+  WriteMaterials();
+  materials->SetMovable([this]() { WriteMaterials(); });
+}
+
+void MaterialTable::WriteMaterials()
+{
+  VkDescriptorBufferInfo materials_info = {materials->GetBuffer(), 0, VK_WHOLE_SIZE};
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptor_set;
+  write.dstBinding = 1;
+  write.descriptorCount = 1;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  write.pBufferInfo = &materials_info;
+  vkUpdateDescriptorSets(device->GetDevice(), 1, &write, 0, nullptr);
+}
+
+MaterialTable::~MaterialTable()
+{
+  if (descriptor_pool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device->GetDevice(), descriptor_pool, nullptr);
+  if (set_layout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device->GetDevice(), set_layout, nullptr);
+}
+
+uint32_t MaterialTable::AddTexture(const VkImageView view, const VkSampler sampler)
+{
+  if (textures_count >= textures_capacity)
+    throw std::runtime_error("texture table is full!");
+
+  // The first texture also fills every free slot, later ones only write their own.
+  const uint32_t index = textures_count++;
+  WriteTextures(index, index == 0 ? textures_capacity : 1, view, sampler);
+  return index;
+}
+
+uint32_t MaterialTable::AddMaterial(const Material &material)
+{
+  if (materials_count >= materials_capacity)
+    throw std::runtime_error("material table is full!");
+
+  const uint32_t id = materials_count++;
+  SetMaterial(id, material);
+  return id;
+}
+
+void MaterialTable::WriteTextures(const uint32_t first, const uint32_t count, const VkImageView view, const VkSampler sampler)
+{
+  std::vector<VkDescriptorImageInfo> image_infos(count, {sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+
+  VkWriteDescriptorSet write = {};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = descriptor_set;
+  write.dstBinding = 0;
+  write.dstArrayElement = first;
+  write.descriptorCount = count;
+  write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  write.pImageInfo = image_infos.data();
+  vkUpdateDescriptorSets(device->GetDevice(), 1, &write, 0, nullptr);
+}
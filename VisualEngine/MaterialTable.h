@@ -0,0 +1,62 @@
+#ifndef __VISUALENGINE_MATERIALTABLE_H
+#define __VISUALENGINE_MATERIALTABLE_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "GpuBuffer.h"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <memory>
+
+// One element of the material buffer (std430), shaders index it by material ID.
+struct Material
+{
+  uint32_t texture_index = 0;
+  uint32_t padding[3] = {0, 0, 0};
+  glm::vec4 color = {1.0f, 1.0f, 1.0f, 1.0f};
+};
+
+// Every texture and material in one descriptor set, bound once per command buffer range:
+// binding 0 is an array of combined image samplers, binding 1 the material buffer.
+// Textures are added one array element at a time. Slots that were never written point at
+// the first texture, so the array is always fully bound and needs no partially bound support.
+// Writes must happen while no submitted command buffer uses the set, and recorded command
+// buffers that bound it have to be recorded again.
+class MaterialTable
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  std::unique_ptr<GpuBuffer> materials;
+  uint32_t textures_capacity = 0;
+  uint32_t materials_capacity = 0;
+  uint32_t textures_count = 0;
+  uint32_t materials_count = 0;
+
+  VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+  void WriteMaterials();
+  void WriteTextures(const uint32_t first, const uint32_t count, const VkImageView view, const VkSampler sampler);
+public:
+  MaterialTable() = delete;
+  MaterialTable(const MaterialTable &obj) = delete;
+  MaterialTable &operator=(const MaterialTable &obj) = delete;
+  // The texture array is clamped to the per-stage sampler limits of the device.
+  MaterialTable(const std::shared_ptr<Vulkan::Device> dev, const uint32_t max_textures = 256, const uint32_t max_materials = 1024);
+  ~MaterialTable();
+
+  // Returns the array index shaders sample the texture with.
+  uint32_t AddTexture(const VkImageView view, const VkSampler sampler);
+  // Returns the material ID, stored per instance.
+  uint32_t AddMaterial(const Material &material);
+  void SetMaterial(const uint32_t id, const Material &material) { materials->Data<Material>()[id] = material; }
+
+  VkDescriptorSetLayout GetLayout() const { return set_layout; }
+  VkDescriptorSet GetSet() const { return descriptor_set; }
+  uint32_t TexturesCapacity() const { return textures_capacity; }
+  uint32_t TexturesCount() const { return textures_count; }
+  uint32_t MaterialsCount() const { return materials_count; }
+};
+
+#endif
@@ -0,0 +1,330 @@
+#include "Mesh.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../VK-nn/libs/tiny_obj_loader.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <omp.h>
+
+namespace
+{
+  Vertex MakeVertex(const tinyobj::attrib_t &attrib, const tinyobj::index_t &index)
+  {
+    Vertex vertex = {};
+    vertex.pos =
+    {
+      attrib.vertices[3 * index.vertex_index + 0],
+      attrib.vertices[3 * index.vertex_index + 1],
+      attrib.vertices[3 * index.vertex_index + 2]
+    };
+
+    if (index.normal_index >= 0)
+    {
+      vertex.normal =
+      {
+        attrib.normals[3 * index.normal_index + 0],
+        attrib.normals[3 * index.normal_index + 1],
+        attrib.normals[3 * index.normal_index + 2],
+      };
+    }
+
+    if (index.texcoord_index >= 0)
+    {
+      vertex.texCoord =
+      {
+        attrib.texcoords[2 * index.texcoord_index + 0],
+        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+      };
+    }
+
+    vertex.color = { 1.0f, 0.0f, 1.0f };
+
+    return vertex;
+  }
+
+  inline uint32_t FloatBits(const float value)
+  {
+    // Adding +0.0 folds -0.0 into +0.0 so that the hash agrees with Vertex::operator==.
+    const float v = value + 0.0f;
+    uint32_t bits = 0;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+  }
+
+  inline uint64_t VertexHash(const Vertex &vertex)
+  {
+    const uint32_t words[] =
+    {
+      FloatBits(vertex.pos.x), FloatBits(vertex.pos.y), FloatBits(vertex.pos.z),
+      FloatBits(vertex.color.x), FloatBits(vertex.color.y), FloatBits(vertex.color.z),
+      FloatBits(vertex.texCoord.x), FloatBits(vertex.texCoord.y),
+      FloatBits(vertex.normal.x), FloatBits(vertex.normal.y), FloatBits(vertex.normal.z)
+    };
+
+    uint64_t h = 0;
+    for (const auto w : words)
+    {
+      h = ((h << 5) | (h >> 59)) ^ w;
+      h *= 0x9E3779B97F4A7C15ull;
+    }
+
+    return h ^ (h >> 29);
+  }
+
+  size_t TableCapacity(const size_t count)
+  {
+    size_t capacity = 16;
+    while (capacity < count * 2)
+      capacity <<= 1;
+    return capacity;
+  }
+
+  void ImportSequential(const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes, MeshData &out_mesh)
+  {
+    std::unordered_map<Vertex, uint32_t> vertices;
+
+    for (const auto& shape : shapes)
+    {
+      for (const auto& index : shape.mesh.indices)
+      {
+        Vertex vertex = MakeVertex(attrib, index);
+        auto it = vertices.find(vertex);
+        if (it == vertices.end())
+        {
+          it = vertices.emplace(vertex, uint32_t(out_mesh.vertices.size())).first;
+          out_mesh.vertices.push_back(vertex);
+        }
+
+        out_mesh.indices.push_back(it->second);
+      }
+    }
+  }
+
+  // Produces exactly the same output as ImportSequential: every corner is welded to the
+  // first corner with an equal vertex, and vertices are numbered in first-seen order.
+  void ImportParallel(const tinyobj::attrib_t &attrib, const std::vector<tinyobj::shape_t> &shapes, MeshData &out_mesh)
+  {
+    std::vector<size_t> shape_offsets(shapes.size() + 1, 0);
+    for (size_t i = 0; i < shapes.size(); ++i)
+      shape_offsets[i + 1] = shape_offsets[i] + shapes[i].mesh.indices.size();
+
+    const size_t corners_count = shape_offsets.back();
+    std::vector<Vertex> corners(corners_count);
+    std::vector<uint64_t> hashes(corners_count);
+    std::vector<uint32_t> first(corners_count);
+
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+      const auto &indices = shapes[s].mesh.indices;
+      const size_t base = shape_offsets[s];
+      #pragma omp parallel for schedule(static)
+      for (size_t i = 0; i < indices.size(); ++i)
+      {
+        corners[base + i] = MakeVertex(attrib, indices[i]);
+        hashes[base + i] = VertexHash(corners[base + i]);
+      }
+    }
+
+    // Corners are split into disjoint partitions by the high hash bits; each thread welds
+    // one partition with a flat linear-probing table of corner indices.
+    #pragma omp parallel
+    {
+      const size_t partitions = (size_t) omp_get_num_threads();
+      const size_t partition = (size_t) omp_get_thread_num();
+
+      std::vector<uint32_t> own;
+      for (size_t c = 0; c < corners_count; ++c)
+      {
+        if ((hashes[c] >> 40) % partitions == partition)
+          own.push_back((uint32_t) c);
+      }
+
+      const size_t capacity = TableCapacity(own.size());
+      const size_t mask = capacity - 1;
+      std::vector<uint32_t> table(capacity, UINT32_MAX);
+
+      for (const auto c : own)
+      {
+        size_t slot = hashes[c] & mask;
+        while (true)
+        {
+          const uint32_t other = table[slot];
+          if (other == UINT32_MAX)
+          {
+            table[slot] = c;
+            first[c] = c;
+            break;
+          }
+
+          if (hashes[other] == hashes[c] && corners[other] == corners[c])
+          {
+            first[c] = other;
+            break;
+          }
+
+          slot = (slot + 1) & mask;
+        }
+      }
+    }
+
+    // Number the unique vertices in first-seen order with a chunked exclusive scan.
+    std::vector<uint32_t> remap(corners_count);
+    std::vector<uint32_t> chunk_offsets;
+
+    #pragma omp parallel
+    {
+      const size_t threads = (size_t) omp_get_num_threads();
+      const size_t thread = (size_t) omp_get_thread_num();
+      const size_t chunk = (corners_count + threads - 1) / threads;
+      const size_t begin = std::min(corners_count, chunk * thread);
+      const size_t end = std::min(corners_count, begin + chunk);
+
+      #pragma omp single
+      chunk_offsets.assign(threads + 1, 0);
+
+      uint32_t unique = 0;
+      for (size_t c = begin; c < end; ++c)
+      {
+        if (first[c] == c)
+          unique++;
+      }
+      chunk_offsets[thread + 1] = unique;
+
+      #pragma omp barrier
+      #pragma omp single
+      {
+        for (size_t t = 0; t < threads; ++t)
+          chunk_offsets[t + 1] += chunk_offsets[t];
+        out_mesh.vertices.resize(chunk_offsets[threads]);
+        out_mesh.indices.resize(corners_count);
+      }
+
+      uint32_t next = chunk_offsets[thread];
+      for (size_t c = begin; c < end; ++c)
+      {
+        if (first[c] == c)
+        {
+          remap[c] = next;
+          out_mesh.vertices[next++] = corners[c];
+        }
+      }
+
+      #pragma omp barrier
+      for (size_t c = begin; c < end; ++c)
+        out_mesh.indices[c] = remap[first[c]];
+    }
+  }
+}
+
+bool ImportObj(const std::filesystem::path obj_file, const std::filesystem::path materials_directory, MeshData &out_mesh, const bool parallel)
+{
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+
+  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, obj_file.c_str(), materials_directory.c_str()))
+  {
+    return false;
+  }
+
+  out_mesh.vertices.clear();
+  out_mesh.indices.clear();
+
+  if (parallel)
+    ImportParallel(attrib, shapes, out_mesh);
+  else
+    ImportSequential(attrib, shapes, out_mesh);
+
+  ComputeBounds(out_mesh);
+
+  return true;
+}
+
+void ComputeBounds(MeshData &mesh)
+{
+  if (mesh.vertices.empty())
+  {
+    mesh.bounds_min = mesh.bounds_max = mesh.sphere_center = { 0.0f, 0.0f, 0.0f };
+    mesh.sphere_radius = 0.0f;
+    return;
+  }
+
+  mesh.bounds_min = mesh.bounds_max = mesh.vertices[0].pos;
+  for (const auto &v : mesh.vertices)
+  {
+    mesh.bounds_min = glm::min(mesh.bounds_min, v.pos);
+    mesh.bounds_max = glm::max(mesh.bounds_max, v.pos);
+  }
+
+  // Tighter than half the box diagonal for anything that does not fill its box corners.
+  mesh.sphere_center = (mesh.bounds_min + mesh.bounds_max) * 0.5f;
+  float radius_squared = 0.0f;
+  for (const auto &v : mesh.vertices)
+  {
+    glm::vec3 d = v.pos - mesh.sphere_center;
+    radius_squared = std::max(radius_squared, glm::dot(d, d));
+  }
+  mesh.sphere_radius = std::sqrt(radius_squared);
+}
+
+void PackMesh(const MeshData &mesh, PackedMeshData &out_mesh)
+{
+  out_mesh.bounds_min = mesh.bounds_min;
+  out_mesh.bounds_extent = mesh.bounds_max - mesh.bounds_min;
+  for (int i = 0; i < 3; ++i)
+  {
+    if (out_mesh.bounds_extent[i] <= 0.0f)
+      out_mesh.bounds_extent[i] = 1.0f;
+  }
+
+  out_mesh.constant_color = true;
+  for (const auto &v : mesh.vertices)
+  {
+    if (v.color != mesh.vertices[0].color)
+    {
+      out_mesh.constant_color = false;
+      break;
+    }
+  }
+
+  out_mesh.vertices.resize(mesh.vertices.size());
+  out_mesh.colors.resize(out_mesh.constant_color ? 1 : mesh.vertices.size());
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < mesh.vertices.size(); ++i)
+  {
+    const auto &v = mesh.vertices[i];
+    auto &p = out_mesh.vertices[i];
+
+    glm::vec3 q = glm::clamp((v.pos - out_mesh.bounds_min) / out_mesh.bounds_extent, 0.0f, 1.0f);
+    p.pos[0] = (uint16_t) std::lround(q.x * 65535.0f);
+    p.pos[1] = (uint16_t) std::lround(q.y * 65535.0f);
+    p.pos[2] = (uint16_t) std::lround(q.z * 65535.0f);
+    p.pos[3] = 0;
+
+    // Octahedral projection: fold the lower hemisphere over the diagonals.
+    glm::vec2 n = { 0.0f, 0.0f };
+    float l1 = std::fabs(v.normal.x) + std::fabs(v.normal.y) + std::fabs(v.normal.z);
+    if (l1 > 0.0f)
+    {
+      n = { v.normal.x / l1, v.normal.y / l1 };
+      if (v.normal.z < 0.0f)
+      {
+        n = { (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+              (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f) };
+      }
+    }
+    p.normal = glm::packSnorm2x16(n);
+    p.texCoord = glm::packHalf2x16(v.texCoord);
+
+    if (!out_mesh.constant_color)
+      out_mesh.colors[i] = glm::packUnorm4x8(glm::vec4(v.color, 1.0f));
+  }
+
+  if (out_mesh.constant_color)
+    out_mesh.colors[0] = glm::packUnorm4x8(glm::vec4(mesh.vertices.empty() ? glm::vec3(1.0f) : mesh.vertices[0].color, 1.0f));
+}
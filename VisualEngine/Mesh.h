@@ -0,0 +1,40 @@
+#ifndef __VISUALENGINE_MESH_H
+#define __VISUALENGINE_MESH_H
+
+#include "Vertex.h"
+
+#include <filesystem>
+#include <vector>
+
+struct MeshLod
+{
+  uint32_t index_offset = 0;
+  uint32_t index_count = 0;
+  float error = 0.0f; // object space distance
+};
+
+struct MeshData
+{
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<MeshLod> lods; // ranges of indices, finest first; empty means one level
+  glm::vec3 bounds_min = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 bounds_max = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 sphere_center = { 0.0f, 0.0f, 0.0f }; // the box center, radius reaches the farthest vertex
+  float sphere_radius = 0.0f;
+};
+
+struct PackedMeshData
+{
+  std::vector<PackedVertex> vertices;
+  std::vector<uint32_t> colors; // one element when constant_color is set
+  bool constant_color = true;
+  glm::vec3 bounds_min = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 bounds_extent = { 1.0f, 1.0f, 1.0f };
+};
+
+bool ImportObj(const std::filesystem::path obj_file, const std::filesystem::path materials_directory, MeshData &out_mesh, const bool parallel = true);
+void ComputeBounds(MeshData &mesh);
+void PackMesh(const MeshData &mesh, PackedMeshData &out_mesh);
+
+#endif
@@ -0,0 +1,235 @@
+#include "MeshCache.h"
+
+#include <fstream>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+  bool SourceStamp(const std::filesystem::path source_file, uint64_t &size, int64_t &time)
+  {
+    std::error_code err;
+    size = std::filesystem::file_size(source_file, err);
+    if (err) return false;
+    time = std::filesystem::last_write_time(source_file, err).time_since_epoch().count();
+    return !err;
+  }
+
+  // [offset, offset + count * size) lies inside the file, without overflowing on corrupt headers.
+  bool FitsIn(const uint64_t file_size, const uint64_t offset, const uint64_t count, const uint64_t size)
+  {
+    return size > 0 && offset <= file_size && count <= (file_size - offset) / size;
+  }
+}
+
+MeshCache::~MeshCache()
+{
+  Close();
+}
+
+bool MeshCache::Open(const std::filesystem::path cache_file, const std::filesystem::path source_file)
+{
+  Close();
+
+  fd = open(cache_file.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return false;
+  }
+
+  struct stat st = {};
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header))
+  {
+    Close();
+    return false;
+  }
+
+  mapping_size = (size_t) st.st_size;
+  mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED)
+  {
+    mapping = nullptr;
+    Close();
+    return false;
+  }
+
+  const Header *h = reinterpret_cast<const Header*>(mapping);
+  bool valid = std::memcmp(h->magic, file_magic, sizeof(file_magic)) == 0 &&
+               h->version == file_version &&
+               h->vertex_size == sizeof(Vertex) &&
+               h->index_size == sizeof(uint32_t) &&
+               h->lod_size == sizeof(MeshLod) &&
+               h->vertex_offset % alignof(Vertex) == 0 &&
+               h->index_offset % alignof(uint32_t) == 0 &&
+               h->lod_offset % alignof(MeshLod) == 0 &&
+               FitsIn(mapping_size, h->vertex_offset, h->vertex_count, h->vertex_size) &&
+               FitsIn(mapping_size, h->index_offset, h->index_count, h->index_size) &&
+               FitsIn(mapping_size, h->lod_offset, h->lod_count, h->lod_size);
+
+  // LOD ranges are drawn straight from the index buffer.
+  if (valid)
+  {
+    const MeshLod *lods = reinterpret_cast<const MeshLod*>(reinterpret_cast<const uint8_t*>(mapping) + h->lod_offset);
+    for (uint64_t i = 0; valid && i < h->lod_count; ++i)
+      valid = lods[i].index_offset <= h->index_count && lods[i].index_count <= h->index_count - lods[i].index_offset;
+  }
+
+  if (valid && !source_file.empty())
+  {
+    uint64_t size = 0;
+    int64_t time = 0;
+    valid = SourceStamp(source_file, size, time) && size == h->source_size && time == h->source_time;
+  }
+
+  if (!valid)
+  {
+    Close();
+    return false;
+  }
+
+  madvise(mapping, mapping_size, MADV_WILLNEED);
+  header = h;
+  return true;
+}
+
+void MeshCache::Close()
+{
+  header = nullptr;
+  if (mapping != nullptr)
+  {
+    munmap(mapping, mapping_size);
+    mapping = nullptr;
+  }
+  mapping_size = 0;
+  if (fd >= 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+}
+
+const Vertex *MeshCache::Vertices() const
+{
+  if (!IsOpen()) return nullptr;
+  return reinterpret_cast<const Vertex*>(reinterpret_cast<const uint8_t*>(mapping) + header->vertex_offset);
+}
+
+const uint32_t *MeshCache::Indices() const
+{
+  if (!IsOpen()) return nullptr;
+  return reinterpret_cast<const uint32_t*>(reinterpret_cast<const uint8_t*>(mapping) + header->index_offset);
+}
+
+const MeshLod *MeshCache::Lods() const
+{
+  if (!IsOpen()) return nullptr;
+  return reinterpret_cast<const MeshLod*>(reinterpret_cast<const uint8_t*>(mapping) + header->lod_offset);
+}
+
+glm::vec3 MeshCache::BoundsMin() const
+{
+  if (!IsOpen()) return { 0.0f, 0.0f, 0.0f };
+  return { header->bounds_min[0], header->bounds_min[1], header->bounds_min[2] };
+}
+
+glm::vec3 MeshCache::BoundsMax() const
+{
+  if (!IsOpen()) return { 0.0f, 0.0f, 0.0f };
+  return { header->bounds_max[0], header->bounds_max[1], header->bounds_max[2] };
+}
+
+void MeshCache::CopyTo(MeshData &out_mesh) const
+{
+  out_mesh.vertices.assign(Vertices(), Vertices() + VerticesCount());
+  out_mesh.indices.assign(Indices(), Indices() + IndicesCount());
+  out_mesh.lods.assign(Lods(), Lods() + LodsCount());
+  out_mesh.bounds_min = BoundsMin();
+  out_mesh.bounds_max = BoundsMax();
+  out_mesh.sphere_center = { header->bounds_sphere[0], header->bounds_sphere[1], header->bounds_sphere[2] };
+  out_mesh.sphere_radius = header->bounds_sphere[3];
+}
+
+std::filesystem::path MeshCache::CachePath(const std::filesystem::path source_file)
+{
+  auto result = source_file;
+  return result.replace_extension(".mesh");
+}
+
+bool MeshCache::Write(const std::filesystem::path cache_file, const std::filesystem::path source_file, const MeshData &mesh, const uint64_t processing)
+{
+  Header h = {};
+  std::memcpy(h.magic, file_magic, sizeof(file_magic));
+  h.version = file_version;
+  h.vertex_size = sizeof(Vertex);
+  h.index_size = sizeof(uint32_t);
+  h.vertex_count = mesh.vertices.size();
+  h.index_count = mesh.indices.size();
+  h.vertex_offset = Align(sizeof(Header));
+  h.index_offset = Align(h.vertex_offset + h.vertex_count * h.vertex_size);
+  h.processing = processing;
+  h.lod_size = sizeof(MeshLod);
+  h.lod_count = mesh.lods.size();
+  h.lod_offset = Align(h.index_offset + h.index_count * h.index_size);
+  for (int i = 0; i < 3; ++i)
+  {
+    h.bounds_min[i] = mesh.bounds_min[i];
+    h.bounds_max[i] = mesh.bounds_max[i];
+    h.bounds_sphere[i] = mesh.sphere_center[i];
+  }
+  h.bounds_sphere[3] = mesh.sphere_radius;
+
+  if (!source_file.empty() && !SourceStamp(source_file, h.source_size, h.source_time))
+  {
+    return false;
+  }
+
+  // Write to a temporary file first so a crash never leaves a truncated cache behind.
+  auto tmp_file = cache_file;
+  tmp_file += ".tmp";
+  {
+    std::ofstream out(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+    {
+      return false;
+    }
+
+    const char zeros[16] = {};
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(zeros, h.vertex_offset - sizeof(h));
+    out.write(reinterpret_cast<const char*>(mesh.vertices.data()), h.vertex_count * h.vertex_size);
+    out.write(zeros, h.index_offset - (h.vertex_offset + h.vertex_count * h.vertex_size));
+    out.write(reinterpret_cast<const char*>(mesh.indices.data()), h.index_count * h.index_size);
+    out.write(zeros, h.lod_offset - (h.index_offset + h.index_count * h.index_size));
+    out.write(reinterpret_cast<const char*>(mesh.lods.data()), h.lod_count * h.lod_size);
+    if (!out.good())
+    {
+      out.close();
+      std::filesystem::remove(tmp_file);
+      return false;
+    }
+  }
+
+  std::error_code err;
+  std::filesystem::rename(tmp_file, cache_file, err);
+  if (err)
+  {
+    std::filesystem::remove(tmp_file, err);
+    return false;
+  }
+
+  return true;
+}
+
+bool MeshCache::Build(const std::filesystem::path obj_file, const std::filesystem::path materials_directory)
+{
+  MeshData mesh;
+  if (!ImportObj(obj_file, materials_directory, mesh))
+  {
+    return false;
+  }
+
+  return Write(CachePath(obj_file), obj_file, mesh);
+}
@@ -0,0 +1,73 @@
+#ifndef __VISUALENGINE_MESHCACHE_H
+#define __VISUALENGINE_MESHCACHE_H
+
+#include "Mesh.h"
+
+#include <filesystem>
+#include <cstdint>
+
+// Versioned binary mesh file (.mesh) written next to the source model.
+// Layout: Header | Vertex[vertex_count] | uint32_t[index_count] | MeshLod[lod_count], every block 16 bytes aligned.
+// The mesh is stored after post-load processing such as vertex cache optimization and LOD generation,
+// processing identifies what was done to it, 0 for the mesh as imported.
+class MeshCache
+{
+private:
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t vertex_size;
+    uint32_t index_size;
+    uint64_t vertex_count;
+    uint64_t index_count;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    float bounds_min[4];
+    float bounds_max[4];
+    float bounds_sphere[4]; // center, radius
+    uint64_t source_size;
+    int64_t source_time;
+    uint64_t processing;
+    uint64_t lod_count;
+    uint64_t lod_offset;
+    uint32_t lod_size;
+    uint32_t reserved;
+  };
+
+  static constexpr char file_magic[4] = { 'M', 'G', 'M', 'C' };
+  static constexpr uint32_t file_version = 3;
+
+  int fd = -1;
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+  const Header *header = nullptr;
+
+  static uint64_t Align(const uint64_t offset) { return (offset + 15) & ~uint64_t(15); }
+public:
+  MeshCache() = default;
+  MeshCache(const MeshCache &obj) = delete;
+  MeshCache &operator=(const MeshCache &obj) = delete;
+  ~MeshCache();
+
+  bool Open(const std::filesystem::path cache_file, const std::filesystem::path source_file = "");
+  void Close();
+  bool IsOpen() const { return header != nullptr; }
+
+  const Vertex *Vertices() const;
+  size_t VerticesCount() const { return IsOpen() ? (size_t) header->vertex_count : 0; }
+  const uint32_t *Indices() const;
+  size_t IndicesCount() const { return IsOpen() ? (size_t) header->index_count : 0; }
+  const MeshLod *Lods() const;
+  size_t LodsCount() const { return IsOpen() ? (size_t) header->lod_count : 0; }
+  uint64_t Processing() const { return IsOpen() ? header->processing : 0; }
+  glm::vec3 BoundsMin() const;
+  glm::vec3 BoundsMax() const;
+  void CopyTo(MeshData &out_mesh) const;
+
+  static std::filesystem::path CachePath(const std::filesystem::path source_file);
+  static bool Write(const std::filesystem::path cache_file, const std::filesystem::path source_file, const MeshData &mesh, const uint64_t processing = 0);
+  static bool Build(const std::filesystem::path obj_file, const std::filesystem::path materials_directory = "");
+};
+
+#endif
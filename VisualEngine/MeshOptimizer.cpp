@@ -0,0 +1,275 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+  struct Adjacency
+  {
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> triangles;
+  };
+
+  Adjacency BuildAdjacency(const std::vector<uint32_t> &indices, const size_t vertex_count)
+  {
+    Adjacency result;
+    result.offsets.assign(vertex_count + 1, 0);
+    result.triangles.resize(indices.size());
+
+    for (auto i : indices)
+      result.offsets[i + 1]++;
+    for (size_t v = 0; v < vertex_count; ++v)
+      result.offsets[v + 1] += result.offsets[v];
+
+    std::vector<uint32_t> fill(result.offsets.begin(), result.offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+      result.triangles[fill[indices[i]]++] = uint32_t(i / 3);
+
+    return result;
+  }
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32_t> &indices, const size_t vertex_count, const size_t cache_size)
+{
+  VertexCacheStats result;
+  if (indices.size() < 3 || vertex_count == 0)
+  {
+    return result;
+  }
+
+  // FIFO cache: a vertex is resident while fewer than cache_size misses happened since it was loaded.
+  std::vector<size_t> loaded_at(vertex_count, 0);
+  std::vector<bool> referenced(vertex_count, false);
+  size_t misses = 0;
+  size_t unique = 0;
+
+  for (auto v : indices)
+  {
+    if (!referenced[v])
+    {
+      referenced[v] = true;
+      unique++;
+    }
+
+    if (loaded_at[v] == 0 || misses - loaded_at[v] + 1 > cache_size)
+    {
+      misses++;
+      loaded_at[v] = misses;
+    }
+  }
+
+  result.acmr = float(misses) / float(indices.size() / 3);
+  result.atvr = float(misses) / float(unique);
+
+  return result;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t> &indices, const size_t vertex_count, const size_t cache_size, std::vector<uint32_t> *out_clusters)
+{
+  const size_t triangles_count = indices.size() / 3;
+  if (triangles_count == 0 || vertex_count == 0)
+  {
+    return;
+  }
+
+  Adjacency adjacency = BuildAdjacency(indices, vertex_count);
+  std::vector<uint32_t> live(vertex_count);
+  for (size_t v = 0; v < vertex_count; ++v)
+    live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+  std::vector<size_t> cache_time(vertex_count, 0);
+  std::vector<bool> emitted(triangles_count, false);
+  std::vector<uint32_t> dead_end;
+  std::vector<uint32_t> candidates;
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  if (out_clusters != nullptr)
+  {
+    out_clusters->clear();
+    out_clusters->push_back(0);
+  }
+
+  size_t time = cache_size + 1;
+  size_t cursor = 0;
+  int64_t fan = 0;
+
+  while (fan >= 0)
+  {
+    candidates.clear();
+    for (uint32_t a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1]; ++a)
+    {
+      const uint32_t t = adjacency.triangles[a];
+      if (emitted[t]) continue;
+
+      for (size_t k = 0; k < 3; ++k)
+      {
+        const uint32_t v = indices[t * 3 + k];
+        result.push_back(v);
+        dead_end.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - cache_time[v] > cache_size)
+          cache_time[v] = time++;
+      }
+      emitted[t] = true;
+    }
+
+    // Prefer the candidate that stays in cache after its remaining triangles are emitted,
+    // the oldest such entry first.
+    int64_t next = -1;
+    int64_t best_priority = -1;
+    for (auto v : candidates)
+    {
+      if (live[v] == 0) continue;
+
+      int64_t priority = 0;
+      if (time - cache_time[v] + 2 * live[v] <= cache_size)
+        priority = int64_t(time - cache_time[v]);
+      if (priority > best_priority)
+      {
+        best_priority = priority;
+        next = v;
+      }
+    }
+
+    if (next == -1)
+    {
+      while (!dead_end.empty() && next == -1)
+      {
+        const uint32_t v = dead_end.back();
+        dead_end.pop_back();
+        if (live[v] > 0)
+          next = v;
+      }
+
+      while (next == -1 && cursor < vertex_count)
+      {
+        if (live[cursor] > 0)
+          next = int64_t(cursor);
+        cursor++;
+      }
+
+      if (next != -1 && out_clusters != nullptr && result.size() < indices.size())
+        out_clusters->push_back(uint32_t(result.size() / 3));
+    }
+
+    fan = next;
+  }
+
+  indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &clusters)
+{
+  const size_t triangles_count = indices.size() / 3;
+  if (clusters.size() < 2 || triangles_count == 0)
+  {
+    return;
+  }
+
+  glm::vec3 mesh_centroid = { 0.0f, 0.0f, 0.0f };
+  float mesh_area = 0.0f;
+  std::vector<float> sort_key(clusters.size(), 0.0f);
+
+  struct ClusterInfo
+  {
+    glm::vec3 centroid = { 0.0f, 0.0f, 0.0f };
+    glm::vec3 normal = { 0.0f, 0.0f, 0.0f };
+    float area = 0.0f;
+  };
+  std::vector<ClusterInfo> info(clusters.size());
+
+  for (size_t c = 0; c < clusters.size(); ++c)
+  {
+    const size_t begin = clusters[c];
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles_count;
+    for (size_t t = begin; t < end; ++t)
+    {
+      const glm::vec3 &p0 = vertices[indices[t * 3 + 0]].pos;
+      const glm::vec3 &p1 = vertices[indices[t * 3 + 1]].pos;
+      const glm::vec3 &p2 = vertices[indices[t * 3 + 2]].pos;
+      glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+      float area = glm::length(n) * 0.5f;
+
+      info[c].centroid += (p0 + p1 + p2) * (area / 3.0f);
+      info[c].normal += n;
+      info[c].area += area;
+    }
+
+    mesh_centroid += info[c].centroid;
+    mesh_area += info[c].area;
+  }
+
+  if (mesh_area > 0.0f)
+    mesh_centroid /= mesh_area;
+
+  for (size_t c = 0; c < clusters.size(); ++c)
+  {
+    if (info[c].area <= 0.0f) continue;
+
+    glm::vec3 centroid = info[c].centroid / info[c].area;
+    float normal_length = glm::length(info[c].normal);
+    if (normal_length > 0.0f)
+      sort_key[c] = glm::dot(centroid - mesh_centroid, info[c].normal / normal_length);
+  }
+
+  std::vector<uint32_t> order(clusters.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&sort_key](uint32_t a, uint32_t b) { return sort_key[a] > sort_key[b]; });
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (auto c : order)
+  {
+    const size_t begin = clusters[c];
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangles_count;
+    result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+  }
+
+  indices.swap(result);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(MeshData &mesh)
+{
+  std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+  std::vector<Vertex> vertices;
+  vertices.reserve(mesh.vertices.size());
+
+  for (auto &i : mesh.indices)
+  {
+    if (remap[i] == UINT32_MAX)
+    {
+      remap[i] = uint32_t(vertices.size());
+      vertices.push_back(mesh.vertices[i]);
+    }
+    i = remap[i];
+  }
+
+  mesh.vertices.swap(vertices);
+}
+
+MeshOptimizer::Report MeshOptimizer::Optimize(MeshData &mesh, const bool reduce_overdraw, const size_t cache_size)
+{
+  Report report;
+  report.before = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), cache_size);
+
+  std::vector<uint32_t> clusters;
+  OptimizeVertexCache(mesh.indices, mesh.vertices.size(), cache_size, &clusters);
+  report.clusters = clusters.size();
+  if (reduce_overdraw)
+    OptimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+  OptimizeVertexFetch(mesh);
+
+  report.after = AnalyzeVertexCache(mesh.indices, mesh.vertices.size(), cache_size);
+
+  return report;
+}
+
+std::ostream &MeshOptimizer::operator<<(std::ostream &out, const Report &report)
+{
+  out << "ACMR " << report.before.acmr << " -> " << report.after.acmr
+      << ", ATVR " << report.before.atvr << " -> " << report.after.atvr
+      << ", " << report.clusters << " clusters";
+  return out;
+}
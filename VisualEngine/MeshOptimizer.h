@@ -0,0 +1,42 @@
+#ifndef __VISUALENGINE_MESHOPTIMIZER_H
+#define __VISUALENGINE_MESHOPTIMIZER_H
+
+#include "Mesh.h"
+
+#include <vector>
+#include <iostream>
+
+namespace MeshOptimizer
+{
+  struct VertexCacheStats
+  {
+    float acmr = 0.0f; // cache misses per triangle
+    float atvr = 0.0f; // cache misses per referenced vertex, 1.0 is optimal
+  };
+
+  struct Report
+  {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t clusters = 0;
+  };
+
+  // Simulates a FIFO post-transform cache of cache_size entries.
+  VertexCacheStats AnalyzeVertexCache(const std::vector<uint32_t> &indices, const size_t vertex_count, const size_t cache_size = 16);
+
+  // Tipsify (Sander et al. 2007). Fills out_clusters with the first triangle of every
+  // cluster, a cluster ends wherever the fan walk had to jump to a non-local vertex.
+  void OptimizeVertexCache(std::vector<uint32_t> &indices, const size_t vertex_count, const size_t cache_size = 16, std::vector<uint32_t> *out_clusters = nullptr);
+
+  // Sorts Tipsify clusters front to back by how much they face away from the mesh centroid,
+  // so outer surfaces are drawn first and occlude the rest.
+  void OptimizeOverdraw(std::vector<uint32_t> &indices, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &clusters);
+
+  // Renumbers vertices in first-use order of the index buffer.
+  void OptimizeVertexFetch(MeshData &mesh);
+
+  Report Optimize(MeshData &mesh, const bool reduce_overdraw = true, const size_t cache_size = 16);
+  std::ostream &operator<<(std::ostream &out, const Report &report);
+}
+
+#endif
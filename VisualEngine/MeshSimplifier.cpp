@@ -0,0 +1,276 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+
+namespace
+{
+  struct Quadric
+  {
+    double a2 = 0, ab = 0, ac = 0, ad = 0;
+    double b2 = 0, bc = 0, bd = 0;
+    double c2 = 0, cd = 0;
+    double d2 = 0;
+
+    Quadric &operator+=(const Quadric &q)
+    {
+      a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+      b2 += q.b2; bc += q.bc; bd += q.bd;
+      c2 += q.c2; cd += q.cd;
+      d2 += q.d2;
+      return *this;
+    }
+
+    static Quadric Plane(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+    {
+      Quadric q;
+      glm::dvec3 n = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+      double length = glm::length(n);
+      if (length <= 0.0)
+        return q;
+
+      n /= length;
+      double d = -glm::dot(n, glm::dvec3(p0));
+      q.a2 = n.x * n.x; q.ab = n.x * n.y; q.ac = n.x * n.z; q.ad = n.x * d;
+      q.b2 = n.y * n.y; q.bc = n.y * n.z; q.bd = n.y * d;
+      q.c2 = n.z * n.z; q.cd = n.z * d;
+      q.d2 = d * d;
+      return q;
+    }
+
+    double Error(const glm::vec3 &p) const
+    {
+      const double x = p.x, y = p.y, z = p.z;
+      double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+               + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+               + c2 * z * z + 2 * cd * z
+               + d2;
+      return std::max(e, 0.0);
+    }
+  };
+
+  struct Collapse
+  {
+    uint32_t from;
+    uint32_t to;
+    double cost;
+  };
+
+  inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+  {
+    if (a > b) std::swap(a, b);
+    return (uint64_t(a) << 32) | b;
+  }
+
+  bool Flips(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices,
+             const std::vector<uint32_t> &offsets, const std::vector<uint32_t> &triangles,
+             const uint32_t from, const uint32_t to)
+  {
+    const glm::vec3 &target = vertices[to].pos;
+    for (uint32_t a = offsets[from]; a < offsets[from + 1]; ++a)
+    {
+      const uint32_t t = triangles[a];
+      const uint32_t i0 = indices[t * 3 + 0], i1 = indices[t * 3 + 1], i2 = indices[t * 3 + 2];
+      if (i0 == to || i1 == to || i2 == to) continue;
+
+      glm::vec3 p0 = vertices[i0].pos, p1 = vertices[i1].pos, p2 = vertices[i2].pos;
+      glm::vec3 before = glm::cross(p1 - p0, p2 - p0);
+      if (i0 == from) p0 = target;
+      if (i1 == from) p1 = target;
+      if (i2 == from) p2 = target;
+      glm::vec3 after = glm::cross(p1 - p0, p2 - p0);
+
+      if (glm::dot(before, after) <= 0.0f)
+        return true;
+    }
+    return false;
+  }
+}
+
+std::vector<uint32_t> MeshSimplifier::Simplify(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const size_t target_index_count, float &out_error)
+{
+  std::vector<uint32_t> result(indices);
+  out_error = 0.0f;
+  const size_t vertex_count = vertices.size();
+  if (result.size() <= target_index_count || vertex_count == 0)
+  {
+    return result;
+  }
+
+  // Wedges sharing a position are welded for the quadrics and the border search;
+  // positions with several wedges are attribute seams and stay locked.
+  std::vector<uint32_t> position_id(vertex_count);
+  std::vector<uint32_t> wedges(vertex_count, 0);
+  {
+    std::unordered_map<glm::vec3, uint32_t> positions;
+    positions.reserve(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+      auto it = positions.emplace(vertices[v].pos, v).first;
+      position_id[v] = it->second;
+    }
+    std::vector<bool> used(vertex_count, false);
+    for (auto i : result)
+      used[i] = true;
+    for (uint32_t v = 0; v < vertex_count; ++v)
+    {
+      if (used[v])
+        wedges[position_id[v]]++;
+    }
+  }
+
+  std::vector<bool> locked(vertex_count, false);
+  for (uint32_t v = 0; v < vertex_count; ++v)
+    locked[v] = wedges[position_id[v]] > 1;
+
+  {
+    std::unordered_map<uint64_t, uint32_t> edges;
+    edges.reserve(result.size());
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      for (size_t k = 0; k < 3; ++k)
+        edges[EdgeKey(position_id[result[t + k]], position_id[result[t + (k + 1) % 3]])]++;
+    }
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        const uint32_t a = result[t + k], b = result[t + (k + 1) % 3];
+        if (edges[EdgeKey(position_id[a], position_id[b])] == 1)
+          locked[a] = locked[b] = true;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertex_count);
+  for (size_t t = 0; t < result.size(); t += 3)
+  {
+    Quadric q = Quadric::Plane(vertices[result[t]].pos, vertices[result[t + 1]].pos, vertices[result[t + 2]].pos);
+    for (size_t k = 0; k < 3; ++k)
+      quadrics[position_id[result[t + k]]] += q;
+  }
+
+  double max_cost = 0.0;
+  std::vector<uint32_t> offsets, triangles, fill;
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(vertex_count);
+  std::vector<uint32_t> collapse_to(vertex_count);
+
+  while (result.size() > target_index_count)
+  {
+    offsets.assign(vertex_count + 1, 0);
+    for (auto i : result)
+      offsets[i + 1]++;
+    for (size_t v = 0; v < vertex_count; ++v)
+      offsets[v + 1] += offsets[v];
+    triangles.resize(result.size());
+    fill.assign(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < result.size(); ++i)
+      triangles[fill[result[i]]++] = uint32_t(i / 3);
+
+    collapses.clear();
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      for (size_t k = 0; k < 3; ++k)
+      {
+        const uint32_t a = result[t + k], b = result[t + (k + 1) % 3];
+        if (locked[a] && locked[b]) continue;
+
+        Quadric q = quadrics[position_id[a]];
+        q += quadrics[position_id[b]];
+        if (!locked[a])
+          collapses.push_back({a, b, q.Error(vertices[b].pos)});
+        if (!locked[b])
+          collapses.push_back({b, a, q.Error(vertices[a].pos)});
+      }
+    }
+
+    if (collapses.empty())
+      break;
+
+    std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+    // Collapse the cheapest independent edges of this pass; every vertex around a
+    // collapsed one is frozen until the next pass so the flip test stays valid.
+    const size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+    size_t removed = 0;
+    size_t applied = 0;
+    std::fill(touched.begin(), touched.end(), false);
+    for (uint32_t v = 0; v < vertex_count; ++v)
+      collapse_to[v] = v;
+
+    for (const auto &c : collapses)
+    {
+      if (removed >= std::max<size_t>(triangles_to_remove, 1)) break;
+      if (touched[c.from] || touched[c.to]) continue;
+      if (Flips(vertices, result, offsets, triangles, c.from, c.to)) continue;
+
+      for (uint32_t a = offsets[c.from]; a < offsets[c.from + 1]; ++a)
+      {
+        const uint32_t t = triangles[a];
+        bool shared = false;
+        for (size_t k = 0; k < 3; ++k)
+        {
+          touched[result[t * 3 + k]] = true;
+          shared = shared || result[t * 3 + k] == c.to;
+        }
+        if (shared) removed++;
+      }
+
+      collapse_to[c.from] = c.to;
+      quadrics[position_id[c.to]] += quadrics[position_id[c.from]];
+      max_cost = std::max(max_cost, c.cost);
+      applied++;
+    }
+
+    if (applied == 0)
+      break;
+
+    size_t write = 0;
+    for (size_t t = 0; t < result.size(); t += 3)
+    {
+      const uint32_t i0 = collapse_to[result[t]], i1 = collapse_to[result[t + 1]], i2 = collapse_to[result[t + 2]];
+      if (i0 == i1 || i1 == i2 || i0 == i2) continue;
+      result[write++] = i0;
+      result[write++] = i1;
+      result[write++] = i2;
+    }
+    result.resize(write);
+  }
+
+  out_error = (float) std::sqrt(max_cost);
+  return result;
+}
+
+void MeshSimplifier::GenerateLods(MeshData &mesh, const size_t levels, const float reduction, const bool optimize)
+{
+  const uint32_t base_count = mesh.lods.empty() ? (uint32_t) mesh.indices.size() : mesh.lods[0].index_count;
+  mesh.indices.resize(base_count);
+  mesh.lods = { {0, base_count, 0.0f} };
+
+  std::vector<uint32_t> base(mesh.indices.begin(), mesh.indices.end());
+  size_t previous_count = base.size();
+  float previous_error = 0.0f;
+
+  for (size_t level = 1; level < levels; ++level)
+  {
+    size_t target = size_t(previous_count * reduction) / 3 * 3;
+    if (target < 3)
+      break;
+
+    float error = 0.0f;
+    auto lod = Simplify(mesh.vertices, base, target, error);
+    if (lod.empty() || lod.size() > previous_count * 9 / 10)
+      break;
+
+    if (optimize)
+      MeshOptimizer::OptimizeVertexCache(lod, mesh.vertices.size());
+
+    previous_error = std::max(previous_error, error);
+    previous_count = lod.size();
+    mesh.lods.push_back({(uint32_t) mesh.indices.size(), (uint32_t) lod.size(), previous_error});
+    mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+  }
+}
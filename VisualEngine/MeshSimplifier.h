@@ -0,0 +1,20 @@
+#ifndef __VISUALENGINE_MESHSIMPLIFIER_H
+#define __VISUALENGINE_MESHSIMPLIFIER_H
+
+#include "Mesh.h"
+
+#include <vector>
+
+namespace MeshSimplifier
+{
+  // Quadric error edge collapse. Vertices are only ever collapsed onto existing vertices,
+  // so the result indexes the same vertex buffer. Border and attribute seam vertices stay locked.
+  // out_error receives the largest collapse error as an object space distance.
+  std::vector<uint32_t> Simplify(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const size_t target_index_count, float &out_error);
+
+  // Appends up to levels - 1 simplified copies of the index buffer, each reduction times
+  // smaller than the previous one, and fills mesh.lods. Stops when a level stops shrinking.
+  void GenerateLods(MeshData &mesh, const size_t levels, const float reduction = 0.5f, const bool optimize = true);
+}
+
+#endif
@@ -0,0 +1,259 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  constexpr float kaiser_width = 3.0f;
+  constexpr float kaiser_alpha = 4.0f;
+  constexpr uint32_t tile_source_rows = 64;
+  constexpr size_t linear_steps = 4096;
+
+  // One RGBA texel in float, four lanes wide with SSE2.
+  struct Texel
+  {
+#if defined(__SSE2__)
+    __m128 v;
+    static Texel Zero() { return { _mm_setzero_ps() }; }
+    static Texel Load(const float *p) { return { _mm_loadu_ps(p) }; }
+    void Store(float *p) const { _mm_storeu_ps(p, v); }
+    void Madd(const float w, const float *p) { v = _mm_add_ps(v, _mm_mul_ps(_mm_set1_ps(w), _mm_loadu_ps(p))); }
+#else
+    float v[4];
+    static Texel Zero() { return { { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+    static Texel Load(const float *p) { return { { p[0], p[1], p[2], p[3] } }; }
+    void Store(float *p) const { std::memcpy(p, v, sizeof(v)); }
+    void Madd(const float w, const float *p) { for (size_t c = 0; c < 4; ++c) v[c] += w * p[c]; }
+#endif
+  };
+
+  // Source texels [first, first + count) and their normalized weights for one destination texel.
+  struct Taps
+  {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> count;
+    std::vector<uint32_t> offset;
+    std::vector<float> weights;
+  };
+
+  double BesselI0(const double x)
+  {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 32 && term > sum * 1e-12; ++k)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+    }
+    return sum;
+  }
+
+  float Kaiser(const float x)
+  {
+    if (std::fabs(x) >= kaiser_width)
+      return 0.0f;
+    const double t = x / kaiser_width;
+    const double window = BesselI0(kaiser_alpha * std::sqrt(1.0 - t * t)) / BesselI0(kaiser_alpha);
+    const double sinc = x == 0.0f ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+    return (float) (sinc * window);
+  }
+
+  Taps BuildTaps(const uint32_t source, const uint32_t destination, const MipGenerator::Filter filter)
+  {
+    Taps taps;
+    const double scale = (double) source / destination;
+    std::vector<float> accumulated;
+    for (uint32_t d = 0; d < destination; ++d)
+    {
+      const double begin = d * scale;
+      const double end = (d + 1) * scale;
+      const double radius = filter == MipGenerator::Filter::Box ? 0.0 : kaiser_width * scale;
+      const int64_t lo = (int64_t) std::floor(begin - radius);
+      const int64_t hi = (int64_t) std::ceil(end + radius) - 1;
+      const uint32_t first = (uint32_t) std::clamp<int64_t>(lo, 0, source - 1);
+      const uint32_t last = (uint32_t) std::clamp<int64_t>(hi, 0, source - 1);
+
+      // Out of range texels clamp to the edge, their weight goes to the border texel.
+      accumulated.assign(last - first + 1, 0.0f);
+      double total = 0.0;
+      for (int64_t s = lo; s <= hi; ++s)
+      {
+        double w = 0.0;
+        if (filter == MipGenerator::Filter::Box)
+          w = std::max(0.0, std::min<double>(s + 1, end) - std::max<double>(s, begin));
+        else
+          w = Kaiser((float) (((s + 0.5) - (begin + end) * 0.5) / scale));
+        accumulated[(uint32_t) std::clamp<int64_t>(s, first, last) - first] += (float) w;
+        total += w;
+      }
+
+      taps.first.push_back(first);
+      taps.count.push_back(last - first + 1);
+      taps.offset.push_back((uint32_t) taps.weights.size());
+      for (float w : accumulated)
+        taps.weights.push_back(total != 0.0 ? (float) (w / total) : 0.0f);
+    }
+    return taps;
+  }
+
+  struct Tables
+  {
+    float to_linear[256];
+    uint8_t to_srgb[linear_steps + 1];
+
+    Tables()
+    {
+      for (size_t i = 0; i < 256; ++i)
+      {
+        const double c = i / 255.0;
+        to_linear[i] = (float) (c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+      }
+      for (size_t i = 0; i <= linear_steps; ++i)
+      {
+        const double l = (double) i / linear_steps;
+        const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+        to_srgb[i] = (uint8_t) std::lround(std::clamp(c, 0.0, 1.0) * 255.0);
+      }
+    }
+  };
+
+  const Tables &GetTables()
+  {
+    static const Tables tables;
+    return tables;
+  }
+}
+
+uint32_t MipGenerator::LevelsCount(const uint32_t width, const uint32_t height)
+{
+  uint32_t levels = 1;
+  for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    ++levels;
+  return levels;
+}
+
+MipGenerator::MipChain MipGenerator::Generate(const uint8_t *pixels, const uint32_t width, const uint32_t height, const uint32_t channels,
+                                              const Filter filter, const bool srgb)
+{
+  MipChain chain;
+  if (pixels == nullptr || width == 0 || height == 0 || channels == 0 || channels > 4)
+    return chain;
+
+  chain.width = width;
+  chain.height = height;
+  chain.channels = channels;
+  size_t total = 0;
+  for (uint32_t level = 0; level < LevelsCount(width, height); ++level)
+  {
+    chain.offsets.push_back(total);
+    total += (size_t) std::max(width >> level, 1u) * std::max(height >> level, 1u) * channels;
+  }
+  chain.data.resize(total);
+  std::memcpy(chain.data.data(), pixels, chain.LevelSize(0));
+
+  const Tables &tables = GetTables();
+  const uint32_t color_channels = channels == 4 ? 3 : channels;
+  auto is_srgb = [&](const uint32_t c) { return srgb && c < color_channels; };
+
+  // Linear RGBA floats of the levels others are resampled from.
+  std::vector<std::vector<float>> linear(chain.LevelsCount());
+  linear[0].resize((size_t) width * height * 4);
+  #pragma omp parallel for schedule(static)
+  for (int64_t y = 0; y < (int64_t) height; ++y)
+  {
+    for (size_t x = 0; x < width; ++x)
+    {
+      const uint8_t *src = pixels + ((size_t) y * width + x) * channels;
+      float *dst = linear[0].data() + ((size_t) y * width + x) * 4;
+      for (uint32_t c = 0; c < 4; ++c)
+      {
+        const uint8_t value = c < channels ? src[c] : (c == 3 ? 255 : 0);
+        dst[c] = is_srgb(c) ? tables.to_linear[value] : value / 255.0f;
+      }
+    }
+  }
+
+  // Levels 2k + 1 and 2k + 2 both read level 2k, so each pair is one parallel wave of row tiles.
+  // Resampling from the base for every level would be just as parallel, but the filter
+  // footprint would grow with the level and deep levels would reread the whole image.
+  struct Work { uint32_t level; uint32_t source; uint32_t y0; uint32_t y1; };
+  std::vector<Taps> taps_x(chain.LevelsCount()), taps_y(chain.LevelsCount());
+  for (uint32_t wave = 0; wave + 1 < chain.LevelsCount(); wave += 2)
+  {
+    std::vector<Work> work;
+    for (uint32_t level = wave + 1; level <= std::min(wave + 2, chain.LevelsCount() - 1); ++level)
+    {
+      taps_x[level] = BuildTaps(chain.Width(wave), chain.Width(level), filter);
+      taps_y[level] = BuildTaps(chain.Height(wave), chain.Height(level), filter);
+      if (level % 2 == 0 && level + 1 < chain.LevelsCount())
+        linear[level].resize((size_t) chain.Width(level) * chain.Height(level) * 4);
+
+      const uint32_t rows = std::max<uint32_t>(1, tile_source_rows * chain.Height(level) / chain.Height(wave));
+      for (uint32_t y = 0; y < chain.Height(level); y += rows)
+        work.push_back({ level, wave, y, std::min(y + rows, chain.Height(level)) });
+    }
+
+    #pragma omp parallel for schedule(dynamic)
+    for (size_t w = 0; w < work.size(); ++w)
+    {
+      const uint32_t level = work[w].level;
+      const uint32_t level_w = chain.Width(level);
+      const uint32_t source_w = chain.Width(work[w].source);
+      const Taps &tx = taps_x[level];
+      const Taps &ty = taps_y[level];
+
+      // Horizontal pass over just the source rows this tile of destination rows reads.
+      const uint32_t row_first = ty.first[work[w].y0];
+      const uint32_t row_last = ty.first[work[w].y1 - 1] + ty.count[work[w].y1 - 1];
+      std::vector<float> horizontal((size_t) (row_last - row_first) * level_w * 4);
+      for (uint32_t row = row_first; row < row_last; ++row)
+      {
+        const float *src = linear[work[w].source].data() + (size_t) row * source_w * 4;
+        float *dst = horizontal.data() + (size_t) (row - row_first) * level_w * 4;
+        for (uint32_t x = 0; x < level_w; ++x)
+        {
+          Texel sum = Texel::Zero();
+          const float *weights = tx.weights.data() + tx.offset[x];
+          const float *texel = src + (size_t) tx.first[x] * 4;
+          for (uint32_t k = 0; k < tx.count[x]; ++k, texel += 4)
+            sum.Madd(weights[k], texel);
+          sum.Store(dst + (size_t) x * 4);
+        }
+      }
+
+      uint8_t *out = chain.data.data() + chain.offsets[level];
+      float *out_linear = linear[level].empty() ? nullptr : linear[level].data();
+      for (uint32_t y = work[w].y0; y < work[w].y1; ++y)
+      {
+        const float *weights = ty.weights.data() + ty.offset[y];
+        for (uint32_t x = 0; x < level_w; ++x)
+        {
+          Texel sum = Texel::Zero();
+          const float *texel = horizontal.data() + ((size_t) (ty.first[y] - row_first) * level_w + x) * 4;
+          for (uint32_t k = 0; k < ty.count[y]; ++k, texel += (size_t) level_w * 4)
+            sum.Madd(weights[k], texel);
+
+          float value[4];
+          sum.Store(value);
+          for (uint32_t c = 0; c < 4; ++c)
+            value[c] = std::clamp(value[c], 0.0f, 1.0f);
+          if (out_linear != nullptr)
+            std::memcpy(out_linear + ((size_t) y * level_w + x) * 4, value, sizeof(value));
+
+          uint8_t *dst = out + ((size_t) y * level_w + x) * channels;
+          for (uint32_t c = 0; c < channels; ++c)
+            dst[c] = is_srgb(c) ? tables.to_srgb[(size_t) std::lround(value[c] * linear_steps)] : (uint8_t) std::lround(value[c] * 255.0f);
+        }
+      }
+    }
+
+    linear[wave].clear();
+    linear[wave].shrink_to_fit();
+  }
+
+  return chain;
+}
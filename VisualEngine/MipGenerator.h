@@ -0,0 +1,39 @@
+#ifndef __VISUALENGINE_MIPGENERATOR_H
+#define __VISUALENGINE_MIPGENERATOR_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Builds a full mip chain from one 8 bit image on the CPU with a separable filter,
+// color channels in linear light when srgb is set. Level pairs are filtered in parallel
+// row tiles from the level above them, alpha is always filtered as stored.
+namespace MipGenerator
+{
+  enum class Filter
+  {
+    Box,   // exact area average
+    Kaiser // Kaiser windowed sinc, sharper, may ring slightly on hard edges
+  };
+
+  struct MipChain
+  {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t channels = 0;
+    std::vector<size_t> offsets; // of every level inside data, level 0 first
+    std::vector<uint8_t> data;   // tightly packed levels
+
+    uint32_t LevelsCount() const { return (uint32_t) offsets.size(); }
+    uint32_t Width(const uint32_t level) const { return width >> level > 0 ? width >> level : 1; }
+    uint32_t Height(const uint32_t level) const { return height >> level > 0 ? height >> level : 1; }
+    size_t LevelSize(const uint32_t level) const { return (size_t) Width(level) * Height(level) * channels; }
+    const uint8_t *Level(const uint32_t level) const { return data.data() + offsets[level]; }
+  };
+
+  uint32_t LevelsCount(const uint32_t width, const uint32_t height);
+  MipChain Generate(const uint8_t *pixels, const uint32_t width, const uint32_t height, const uint32_t channels,
+                    const Filter filter = Filter::Kaiser, const bool srgb = true);
+}
+
+#endif
@@ -0,0 +1,103 @@
+#include "OffscreenTarget.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+OffscreenTarget::OffscreenTarget(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const VkExtent2D size, const size_t images_count,
+                                 const VkSampleCountFlagBits samples_count)
+{
+  device = dev;
+  extent = size;
+  targets = std::make_unique<RenderTargets>(device, color_format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, samples_count);
+
+  images.resize(std::max<size_t>(images_count, 1));
+  std::vector<VkImageView> views(images.size());
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    images[i] = RenderTargets::CreateAttachment(device, extent, color_format, VK_SAMPLE_COUNT_1_BIT,
+                                                VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+    views[i] = images[i].view;
+  }
+  targets->Resize(extent, views);
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = queue_family;
+  if (vkCreateCommandPool(device->GetDevice(), &pool_info, nullptr, &readback_pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create readback command pool!");
+
+  VkCommandBufferAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.commandPool = readback_pool;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandBufferCount = 1;
+  if (vkAllocateCommandBuffers(device->GetDevice(), &alloc_info, &readback_commands) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate readback command buffer!");
+
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device->GetDevice(), &fence_info, nullptr, &readback_fence) != VK_SUCCESS)
+    throw std::runtime_error("failed to create readback fence!");
+
+  readback = std::make_unique<GpuBuffer>(device, (VkDeviceSize) extent.width * extent.height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+  if (readback_fence != VK_NULL_HANDLE)
+    vkDestroyFence(device->GetDevice(), readback_fence, nullptr);
+  if (readback_pool != VK_NULL_HANDLE)
+    vkDestroyCommandPool(device->GetDevice(), readback_pool, nullptr);
+
+  // Framebuffers go first, they still reference the images.
+  targets.reset();
+  for (auto &image : images)
+    RenderTargets::DestroyAttachment(device, image);
+}
+
+void OffscreenTarget::ReadBack(const VkQueue queue, const size_t image_index, std::vector<uint8_t> &pixels)
+{
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkResetCommandBuffer(readback_commands, 0);
+  if (vkBeginCommandBuffer(readback_commands, &begin_info) != VK_SUCCESS)
+    throw std::runtime_error("failed to begin readback command buffer!");
+
+  // Rendering left the image in TRANSFER_SRC_OPTIMAL, only its writes need to become visible.
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = images[image_index].image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(readback_commands, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region = {};
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {extent.width, extent.height, 1};
+  vkCmdCopyImageToBuffer(readback_commands, images[image_index].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback->GetBuffer(), 1, &region);
+
+  if (vkEndCommandBuffer(readback_commands) != VK_SUCCESS)
+    throw std::runtime_error("failed to record readback commands!");
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &readback_commands;
+  vkResetFences(device->GetDevice(), 1, &readback_fence);
+  if (vkQueueSubmit(queue, 1, &submit_info, readback_fence) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit readback commands!");
+  vkWaitForFences(device->GetDevice(), 1, &readback_fence, VK_TRUE, UINT64_MAX);
+
+  pixels.resize((size_t) readback->Size());
+  std::memcpy(pixels.data(), readback->Data(), pixels.size());
+}
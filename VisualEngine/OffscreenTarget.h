@@ -0,0 +1,48 @@
+#ifndef __VISUALENGINE_OFFSCREENTARGET_H
+#define __VISUALENGINE_OFFSCREENTARGET_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "GpuBuffer.h"
+#include "RenderTargets.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+// Stand-in for the swapchain when there is no window: a set of single sampled color
+// images rendered through RenderTargets. Rendered images end up in TRANSFER_SRC_OPTIMAL
+// so they can be read back at any time.
+class OffscreenTarget
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkExtent2D extent = {};
+  VkFormat color_format = VK_FORMAT_R8G8B8A8_SRGB;
+  std::vector<RenderTargets::Attachment> images;
+  std::unique_ptr<RenderTargets> targets;
+
+  VkCommandPool readback_pool = VK_NULL_HANDLE;
+  VkCommandBuffer readback_commands = VK_NULL_HANDLE;
+  VkFence readback_fence = VK_NULL_HANDLE;
+  std::unique_ptr<GpuBuffer> readback;
+public:
+  OffscreenTarget() = delete;
+  OffscreenTarget(const OffscreenTarget &obj) = delete;
+  OffscreenTarget &operator=(const OffscreenTarget &obj) = delete;
+  // samples_count is lowered to what the device supports for both color and depth.
+  OffscreenTarget(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const VkExtent2D size, const size_t images_count,
+                  const VkSampleCountFlagBits samples_count);
+  ~OffscreenTarget();
+
+  VkRenderPass GetRenderPass() const { return targets->GetRenderPass(); }
+  VkFramebuffer GetFrameBuffer(const size_t image_index) const { return targets->GetFrameBuffer(image_index); }
+  VkExtent2D GetExtent() const { return extent; }
+  size_t GetImagesCount() const { return images.size(); }
+  VkSampleCountFlagBits GetSamplesCount() const { return targets->GetSamplesCount(); }
+
+  // Copies the image into pixels as tightly packed RGBA8 rows, waiting for the copy.
+  // Work rendering the image must already be submitted to queue, whose access the caller synchronizes.
+  void ReadBack(const VkQueue queue, const size_t image_index, std::vector<uint8_t> &pixels);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "ParallelRecorder.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <omp.h>
+
+ParallelRecorder::ParallelRecorder(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const size_t images, const size_t threads)
+{
+  device = dev;
+  images_count = std::max<size_t>(images, 1);
+  threads_count = threads > 0 ? threads : (size_t) std::clamp(omp_get_max_threads(), 1, 8);
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = queue_family;
+
+  pools.resize(threads_count * images_count);
+  for (auto &thread_pool : pools)
+  {
+    if (vkCreateCommandPool(device->GetDevice(), &pool_info, nullptr, &thread_pool.pool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create recording command pool!");
+
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = thread_pool.pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device->GetDevice(), &alloc_info, &thread_pool.buffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate secondary command buffer!");
+  }
+}
+
+ParallelRecorder::~ParallelRecorder()
+{
+  for (auto &thread_pool : pools)
+  {
+    if (thread_pool.pool != VK_NULL_HANDLE)
+      vkDestroyCommandPool(device->GetDevice(), thread_pool.pool, nullptr);
+  }
+}
+
+std::vector<VkCommandBuffer> ParallelRecorder::Record(const size_t image_index, const VkRenderPass render_pass, const VkFramebuffer framebuffer,
+                                                      const size_t items_count, const RecordRange &record_range)
+{
+  const size_t ranges = std::min(threads_count, std::max<size_t>(items_count, 1));
+  const size_t range_size = (items_count + ranges - 1) / ranges;
+  std::vector<VkCommandBuffer> buffers(ranges);
+  bool failed = false;
+
+  #pragma omp parallel for num_threads((int) ranges) schedule(static, 1)
+  for (int64_t r = 0; r < (int64_t) ranges; ++r)
+  {
+    // Each range only touches the pool of the thread slot it was given.
+    ThreadPool &thread_pool = pools[(size_t) r * images_count + image_index % images_count];
+    vkResetCommandPool(device->GetDevice(), thread_pool.pool, 0);
+
+    VkCommandBufferInheritanceInfo inheritance_info = {};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = render_pass;
+    inheritance_info.subpass = 0;
+    inheritance_info.framebuffer = framebuffer;
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    begin_info.pInheritanceInfo = &inheritance_info;
+
+    if (vkBeginCommandBuffer(thread_pool.buffer, &begin_info) != VK_SUCCESS)
+    {
+      #pragma omp atomic write
+      failed = true;
+      continue;
+    }
+
+    const size_t begin = std::min(items_count, (size_t) r * range_size);
+    const size_t end = std::min(items_count, begin + range_size);
+    record_range(thread_pool.buffer, begin, end);
+
+    if (vkEndCommandBuffer(thread_pool.buffer) != VK_SUCCESS)
+    {
+      #pragma omp atomic write
+      failed = true;
+    }
+    buffers[r] = thread_pool.buffer;
+  }
+
+  if (failed)
+    throw std::runtime_error("failed to record secondary command buffers!");
+
+  return buffers;
+}
@@ -0,0 +1,45 @@
+#ifndef __VISUALENGINE_PARALLELRECORDER_H
+#define __VISUALENGINE_PARALLELRECORDER_H
+
+#include "../VK-nn/Vulkan/Device.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Records a draw list into secondary command buffers on OpenMP threads, for
+// vkCmdExecuteCommands inside a primary's render pass. Every thread owns one
+// command pool per swapchain image, so recording an image only resets pools
+// whose previous work the caller has already waited for.
+class ParallelRecorder
+{
+private:
+  struct ThreadPool
+  {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer buffer = VK_NULL_HANDLE;
+  };
+
+  std::shared_ptr<Vulkan::Device> device;
+  size_t images_count = 0;
+  size_t threads_count = 0;
+  std::vector<ThreadPool> pools; // [thread * images_count + image]
+public:
+  // items_begin and items_end index the caller's draw list, the buffer is already begun.
+  using RecordRange = std::function<void(const VkCommandBuffer, const size_t, const size_t)>;
+
+  ParallelRecorder() = delete;
+  ParallelRecorder(const ParallelRecorder &obj) = delete;
+  ParallelRecorder &operator=(const ParallelRecorder &obj) = delete;
+  ParallelRecorder(const std::shared_ptr<Vulkan::Device> dev, const uint32_t queue_family, const size_t images, const size_t threads = 0);
+  ~ParallelRecorder();
+
+  // Splits [0, items_count) into contiguous ranges, one per thread, and returns the
+  // secondary buffers in draw list order. They continue subpass 0 of render_pass.
+  std::vector<VkCommandBuffer> Record(const size_t image_index, const VkRenderPass render_pass, const VkFramebuffer framebuffer,
+                                      const size_t items_count, const RecordRange &record_range);
+  size_t ThreadsCount() const { return threads_count; }
+};
+
+#endif
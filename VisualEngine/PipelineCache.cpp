@@ -0,0 +1,188 @@
+#include "PipelineCache.h"
+
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+
+namespace
+{
+  std::vector<uint8_t> ReadFile(const std::filesystem::path file_path)
+  {
+    std::ifstream file(file_path, std::ios::binary | std::ios::ate);
+    if (!file.is_open())
+      return {};
+
+    std::vector<uint8_t> data((size_t) file.tellg());
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), (std::streamsize) data.size()))
+      return {};
+    return data;
+  }
+}
+
+PipelineCache::PipelineCache(const std::shared_ptr<Vulkan::Device> dev, const std::filesystem::path file)
+{
+  device = dev;
+  cache_file = file;
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+
+  std::vector<uint8_t> initial_data = ReadCacheFile();
+  warm = !initial_data.empty();
+
+  VkPipelineCacheCreateInfo cache_info = {};
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.initialDataSize = initial_data.size();
+  cache_info.pInitialData = initial_data.empty() ? nullptr : initial_data.data();
+
+  if (vkCreatePipelineCache(device->GetDevice(), &cache_info, nullptr, &cache) != VK_SUCCESS)
+  {
+    // The driver may still refuse data it wrote itself, fall back to an empty cache.
+    warm = false;
+    cache_info.initialDataSize = 0;
+    cache_info.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device->GetDevice(), &cache_info, nullptr, &cache) != VK_SUCCESS)
+      throw std::runtime_error("failed to create pipeline cache!");
+  }
+
+#ifdef DEBUG
+  std::cout << __func__ << ": " << (warm ? "warm" : "cold") << " cache " << cache_file << std::endl;
+#endif
+}
+
+PipelineCache::~PipelineCache()
+{
+  for (auto &shader_module : shader_modules)
+    vkDestroyShaderModule(device->GetDevice(), shader_module.second, nullptr);
+  if (cache != VK_NULL_HANDLE)
+    vkDestroyPipelineCache(device->GetDevice(), cache, nullptr);
+}
+
+uint64_t PipelineCache::Hash(const void *data, const size_t size)
+{
+  // FNV-1a, 64 bit.
+  uint64_t hash = 14695981039346656037ull;
+  const uint8_t *bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::vector<uint8_t> PipelineCache::ReadCacheFile() const
+{
+  std::vector<uint8_t> file_data = ReadFile(cache_file);
+  if (file_data.size() < sizeof(Header) + sizeof(BlobHeader))
+    return {};
+
+  Header header = {};
+  std::memcpy(&header, file_data.data(), sizeof(header));
+  const uint8_t *blob = file_data.data() + sizeof(Header);
+  const size_t blob_size = file_data.size() - sizeof(Header);
+
+  BlobHeader blob_header = {};
+  std::memcpy(&blob_header, blob, sizeof(blob_header));
+
+  // Both our header and the driver's own must match this device, a blob from another
+  // driver build is at best ignored and at worst crashes vkCreatePipelineCache.
+  bool valid = std::memcmp(header.magic, file_magic, sizeof(file_magic)) == 0 &&
+               header.version == file_version &&
+               header.vendor_id == properties.vendorID &&
+               header.device_id == properties.deviceID &&
+               header.driver_version == properties.driverVersion &&
+               std::memcmp(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0 &&
+               header.data_size == blob_size &&
+               header.data_hash == Hash(blob, blob_size) &&
+               blob_header.header_size >= sizeof(BlobHeader) &&
+               blob_header.header_version == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               blob_header.vendor_id == properties.vendorID &&
+               blob_header.device_id == properties.deviceID &&
+               std::memcmp(blob_header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+  if (!valid)
+  {
+#ifdef DEBUG
+    std::cout << __func__ << ": ignoring stale pipeline cache " << cache_file << std::endl;
+#endif
+    return {};
+  }
+
+  return std::vector<uint8_t>(blob, blob + blob_size);
+}
+
+bool PipelineCache::Save() const
+{
+  size_t blob_size = 0;
+  if (vkGetPipelineCacheData(device->GetDevice(), cache, &blob_size, nullptr) != VK_SUCCESS || blob_size == 0)
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> blob(blob_size);
+  if (vkGetPipelineCacheData(device->GetDevice(), cache, &blob_size, blob.data()) != VK_SUCCESS)
+  {
+    return false;
+  }
+  blob.resize(blob_size);
+
+  Header header = {};
+  std::memcpy(header.magic, file_magic, sizeof(file_magic));
+  header.version = file_version;
+  header.vendor_id = properties.vendorID;
+  header.device_id = properties.deviceID;
+  header.driver_version = properties.driverVersion;
+  std::memcpy(header.cache_uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+  header.data_size = blob.size();
+  header.data_hash = Hash(blob.data(), blob.size());
+
+  // Written next to the final name first, so a crash never leaves a torn cache behind.
+  std::filesystem::path tmp_file = cache_file;
+  tmp_file += ".tmp";
+  {
+    std::ofstream file(tmp_file, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(blob.data()), (std::streamsize) blob.size());
+    if (!file.good())
+    {
+      return false;
+    }
+  }
+
+  std::error_code err;
+  std::filesystem::rename(tmp_file, cache_file, err);
+  return !err;
+}
+
+VkShaderModule PipelineCache::GetShaderModule(const std::filesystem::path spirv_file)
+{
+  std::vector<uint8_t> code = ReadFile(spirv_file);
+  if (code.empty() || code.size() % sizeof(uint32_t) != 0)
+    throw std::runtime_error("failed to read shader " + spirv_file.string() + "!");
+
+  // 64 bits of hash and the size are taken as the identity of the code.
+  const uint64_t key = Hash(code.data(), code.size()) ^ ((uint64_t) code.size() << 32);
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = shader_modules.find(key);
+  if (it != shader_modules.end())
+  {
+    ++shader_module_hits;
+    return it->second;
+  }
+
+  VkShaderModuleCreateInfo module_info = {};
+  module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  module_info.codeSize = code.size();
+  module_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+  VkShaderModule module = VK_NULL_HANDLE;
+  if (vkCreateShaderModule(device->GetDevice(), &module_info, nullptr, &module) != VK_SUCCESS)
+    throw std::runtime_error("failed to create shader module!");
+
+  shader_modules[key] = module;
+  return module;
+}
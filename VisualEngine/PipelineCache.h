@@ -0,0 +1,75 @@
+#ifndef __VISUALENGINE_PIPELINECACHE_H
+#define __VISUALENGINE_PIPELINECACHE_H
+
+#include "../VK-nn/Vulkan/Device.h"
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// VkPipelineCache persisted between runs plus shader modules shared by SPIR-V hash.
+// The file is only accepted for the same vendor, device, driver version and
+// pipeline cache UUID it was written with, anything else starts a cold cache.
+// Layout: Header | vkGetPipelineCacheData blob.
+class PipelineCache
+{
+private:
+  struct Header
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+    uint64_t data_size;
+    uint64_t data_hash;
+  };
+
+  // Leading part of the blob every driver writes (VK_PIPELINE_CACHE_HEADER_VERSION_ONE).
+  struct BlobHeader
+  {
+    uint32_t header_size;
+    uint32_t header_version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint8_t cache_uuid[VK_UUID_SIZE];
+  };
+
+  static constexpr char file_magic[4] = { 'M', 'G', 'P', 'C' };
+  static constexpr uint32_t file_version = 1;
+
+  std::shared_ptr<Vulkan::Device> device;
+  std::filesystem::path cache_file;
+  VkPhysicalDeviceProperties properties = {};
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  bool warm = false;
+
+  std::mutex mutex;
+  std::unordered_map<uint64_t, VkShaderModule> shader_modules;
+  size_t shader_module_hits = 0;
+
+  std::vector<uint8_t> ReadCacheFile() const;
+public:
+  PipelineCache() = delete;
+  PipelineCache(const PipelineCache &obj) = delete;
+  PipelineCache &operator=(const PipelineCache &obj) = delete;
+  PipelineCache(const std::shared_ptr<Vulkan::Device> dev, const std::filesystem::path file);
+  ~PipelineCache();
+
+  VkPipelineCache GetCache() const { return cache; }
+  // True when the cache started from a valid file of an earlier run.
+  bool IsWarm() const { return warm; }
+  // Same SPIR-V, same module: files are hashed, modules live as long as the cache.
+  VkShaderModule GetShaderModule(const std::filesystem::path spirv_file);
+  size_t ShaderModulesCount() const { return shader_modules.size(); }
+  size_t ShaderModuleHits() const { return shader_module_hits; }
+  bool Save() const;
+
+  static uint64_t Hash(const void *data, const size_t size);
+};
+
+#endif
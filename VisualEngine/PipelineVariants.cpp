@@ -0,0 +1,37 @@
+#include "PipelineVariants.h"
+
+PipelineVariants::PipelineVariants(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &pipeline_cache, const VkRenderPass pass,
+                                   const PipelineConfig &config, const float sample_shading_fraction) : cache(pipeline_cache)
+{
+  device = dev;
+  render_pass = pass;
+  base = config;
+  min_sample_shading = sample_shading_fraction;
+}
+
+GraphicsPipeline &PipelineVariants::Get(const uint32_t features)
+{
+  std::lock_guard<std::mutex> lock(variants_mutex);
+  auto found = variants.find(features);
+  if (found != variants.end())
+    return *found->second;
+
+  // Both shader stages declare the constants they use, a stage ignores entries it does not declare.
+  PipelineConfig config = base;
+  for (auto stage : {VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT})
+  {
+    config.AddSpecializationConstant(stage, lit_constant, (features & Lit) ? VK_TRUE : VK_FALSE)
+          .AddSpecializationConstant(stage, instanced_constant, (features & Instanced) ? VK_TRUE : VK_FALSE)
+          .AddSpecializationConstant(stage, textured_constant, (features & Textured) ? VK_TRUE : VK_FALSE);
+  }
+  config.UseSampleShading((features & SampleShading) != 0, min_sample_shading);
+
+  auto variant = std::make_unique<GraphicsPipeline>(device, cache, render_pass, config);
+  return *variants.emplace(features, std::move(variant)).first->second;
+}
+
+size_t PipelineVariants::Count()
+{
+  std::lock_guard<std::mutex> lock(variants_mutex);
+  return variants.size();
+}
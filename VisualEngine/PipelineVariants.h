@@ -0,0 +1,58 @@
+#ifndef __VISUALENGINE_PIPELINEVARIANTS_H
+#define __VISUALENGINE_PIPELINEVARIANTS_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "GraphicsPipeline.h"
+#include "PipelineCache.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Pipelines specialized from one base config by feature bits. Shader features are boolean
+// specialization constants, so the driver drops the disabled code when compiling the variant
+// instead of branching on it per vertex or pixel. Variants are built on first use and cached
+// by their bits; the constant IDs are shared by tri.vert, tri_packed.vert and tri.frag.
+class PipelineVariants
+{
+public:
+  enum Feature : uint32_t
+  {
+    Textured = 1,      // sample the material texture, otherwise vertex color times material color
+    Lit = 2,           // diffuse lighting from world.light, otherwise full bright
+    SampleShading = 4, // per sample shading at the fraction given to the constructor
+    Instanced = 8      // per instance data from gl_InstanceIndex, otherwise every draw reads instance 0
+  };
+
+  // constant_id values in the shaders.
+  static constexpr uint32_t lit_constant = 1;
+  static constexpr uint32_t instanced_constant = 2;
+  static constexpr uint32_t textured_constant = 3;
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  PipelineCache &cache;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  PipelineConfig base;
+  float min_sample_shading = 1.0f;
+
+  std::mutex variants_mutex;
+  std::unordered_map<uint32_t, std::unique_ptr<GraphicsPipeline>> variants;
+public:
+  PipelineVariants() = delete;
+  PipelineVariants(const PipelineVariants &obj) = delete;
+  PipelineVariants &operator=(const PipelineVariants &obj) = delete;
+  // base has every shader stage and all state but sample shading. All variants share its
+  // descriptor set layouts, so sets bound with one variant's layout stay bound for the others.
+  PipelineVariants(const std::shared_ptr<Vulkan::Device> dev, PipelineCache &pipeline_cache, const VkRenderPass pass,
+                   const PipelineConfig &config, const float sample_shading_fraction);
+  ~PipelineVariants() = default;
+
+  // Safe from recording threads, but the first use of a key compiles a pipeline: keys known
+  // ahead should be requested before recording.
+  GraphicsPipeline &Get(const uint32_t features);
+  size_t Count();
+  float GetMinSampleShading() const { return min_sample_shading; }
+};
+
+#endif
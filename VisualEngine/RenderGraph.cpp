@@ -0,0 +1,402 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+  struct AccessInfo
+  {
+    VkPipelineStageFlags stages;
+    VkAccessFlags access;
+    VkAccessFlags writes;
+    VkImageLayout layout; // images only
+  };
+
+  AccessInfo Describe(const RenderGraph::Access access)
+  {
+    switch (access)
+    {
+      case RenderGraph::Access::IndirectRead:
+        return {VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED};
+      case RenderGraph::Access::VertexShaderRead:
+        return {VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      case RenderGraph::Access::FragmentShaderRead:
+        return {VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+      case RenderGraph::Access::ComputeRead:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL};
+      case RenderGraph::Access::ComputeWrite:
+        return {VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                VK_IMAGE_LAYOUT_GENERAL};
+      case RenderGraph::Access::TransferRead:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+      case RenderGraph::Access::TransferWrite:
+        return {VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+      case RenderGraph::Access::ColorAttachment:
+        return {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+      case RenderGraph::Access::DepthAttachment:
+        return {VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    }
+    throw std::runtime_error("unknown render graph access!");
+  }
+}
+
+RenderGraph::RenderGraph(const std::shared_ptr<Vulkan::Device> dev)
+{
+  device = dev;
+  allocator = DeviceAllocator::For(device);
+}
+
+RenderGraph::~RenderGraph()
+{
+  for (auto &resource : resources)
+  {
+    if (resource.created)
+      RenderTargets::DestroyAttachment(device, resource.attachment);
+  }
+  for (auto &group : alias_groups)
+    allocator->Free(group.memory);
+}
+
+RenderGraph::Resource RenderGraph::ImportBuffer(const std::string &name)
+{
+  ResourceInfo resource;
+  resource.name = name;
+  resources.push_back(resource);
+  return (Resource) resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::ImportImage(const std::string &name, const VkImageAspectFlags aspect, ImageSource source,
+                                               const VkImageLayout initial_layout, const VkPipelineStageFlags initial_stages,
+                                               const VkImageLayout final_layout)
+{
+  ResourceInfo resource;
+  resource.name = name;
+  resource.image = true;
+  resource.aspect = aspect;
+  resource.source = std::move(source);
+  resource.initial_layout = initial_layout;
+  resource.initial_stages = initial_stages;
+  resource.final_layout = final_layout;
+  resources.push_back(resource);
+  return (Resource) resources.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::CreateImage(const std::string &name, const ImageInfo &info)
+{
+  ResourceInfo resource;
+  resource.name = name;
+  resource.image = true;
+  resource.aspect = info.aspect;
+  resource.created = true;
+  resource.info = info;
+  resources.push_back(resource);
+  return (Resource) resources.size() - 1;
+}
+
+void RenderGraph::AddPass(const std::string &name, const std::vector<Use> &uses, Record record)
+{
+  if (compiled)
+    throw std::runtime_error("render graph is already compiled!");
+
+  Pass pass;
+  pass.name = name;
+  pass.uses = uses;
+  pass.record = std::move(record);
+  passes.push_back(pass);
+}
+
+void RenderGraph::Compile()
+{
+  for (size_t p = 0; p < passes.size(); ++p)
+  {
+    for (auto &use : passes[p].uses)
+    {
+      ResourceInfo &resource = resources[use.resource];
+      resource.first_pass = std::min(resource.first_pass, p);
+      resource.last_pass = std::max(resource.last_pass, p);
+    }
+  }
+
+  CreateImages();
+  DeriveBarriers();
+  compiled = true;
+}
+
+void RenderGraph::CreateImages()
+{
+  // Lazily allocated images have no memory worth sharing, the others are packed first fit in
+  // order of first use. Images no pass uses are never created.
+  std::vector<Resource> aliased;
+  for (Resource r = 0; r < (Resource) resources.size(); ++r)
+  {
+    ResourceInfo &resource = resources[r];
+    if (!resource.created || resource.first_pass == SIZE_MAX)
+      continue;
+
+    const ImageInfo &info = resource.info;
+    if ((info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0)
+    {
+      resource.attachment = RenderTargets::CreateAttachment(device, info.extent, info.format, info.samples, info.usage, info.aspect);
+      continue;
+    }
+
+    VkImageCreateInfo image_info = {};
+    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = info.format;
+    image_info.extent = {info.extent.width, info.extent.height, 1};
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = 1;
+    image_info.samples = info.samples;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.usage = info.usage;
+    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device->GetDevice(), &image_info, nullptr, &resource.attachment.image) != VK_SUCCESS)
+      throw std::runtime_error("failed to create render graph image!");
+    aliased.push_back(r);
+  }
+  std::stable_sort(aliased.begin(), aliased.end(), [this](const Resource a, const Resource b) { return resources[a].first_pass < resources[b].first_pass; });
+
+  // Members of a group are ordered by first use and never overlap, so only the last one can clash.
+  for (const Resource r : aliased)
+  {
+    ResourceInfo &resource = resources[r];
+    VkMemoryRequirements requirements = {};
+    vkGetImageMemoryRequirements(device->GetDevice(), resource.attachment.image, &requirements);
+
+    // Of the groups free by then, the one that grows the least.
+    auto growth = [&requirements](const AliasGroup &group)
+    {
+      return requirements.size > group.requirements.size ? requirements.size - group.requirements.size : 0;
+    };
+    size_t best = SIZE_MAX;
+    for (size_t g = 0; g < alias_groups.size(); ++g)
+    {
+      const AliasGroup &group = alias_groups[g];
+      if (resources[group.images.back()].last_pass >= resource.first_pass || (group.requirements.memoryTypeBits & requirements.memoryTypeBits) == 0)
+        continue;
+      if (best == SIZE_MAX || growth(group) < growth(alias_groups[best]))
+        best = g;
+    }
+    if (best == SIZE_MAX)
+    {
+      alias_groups.emplace_back();
+      alias_groups.back().requirements = requirements;
+      best = alias_groups.size() - 1;
+    }
+
+    AliasGroup &group = alias_groups[best];
+    group.requirements.size = std::max(group.requirements.size, requirements.size);
+    group.requirements.alignment = std::max(group.requirements.alignment, requirements.alignment);
+    group.requirements.memoryTypeBits &= requirements.memoryTypeBits;
+    group.images.push_back(r);
+    resource.alias_group = best;
+  }
+
+  for (auto &group : alias_groups)
+  {
+    group.memory = allocator->Allocate(group.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DeviceAllocator::Resource::Image);
+    for (const Resource r : group.images)
+    {
+      ResourceInfo &resource = resources[r];
+      vkBindImageMemory(device->GetDevice(), resource.attachment.image, group.memory.memory, group.memory.offset);
+
+      VkImageViewCreateInfo view_info = {};
+      view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      view_info.image = resource.attachment.image;
+      view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      view_info.format = resource.info.format;
+      view_info.subresourceRange = {resource.info.aspect, 0, 1, 0, 1};
+      if (vkCreateImageView(device->GetDevice(), &view_info, nullptr, &resource.attachment.view) != VK_SUCCESS)
+        throw std::runtime_error("failed to create render graph image view!");
+    }
+  }
+}
+
+void RenderGraph::DeriveBarriers()
+{
+  struct State
+  {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags write_stages = 0;
+    VkAccessFlags write_access = 0;
+    VkPipelineStageFlags read_stages = 0;    // since the last write
+    VkPipelineStageFlags visible_stages = 0; // the last write was made visible to
+    VkAccessFlags visible_access = 0;
+  };
+
+  // Stages and writes of every use of a created image, what the next user of its memory waits for.
+  std::vector<AccessInfo> footprints(resources.size(), AccessInfo{0, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED});
+  for (auto &pass : passes)
+  {
+    for (auto &use : pass.uses)
+    {
+      const AccessInfo info = Describe(use.access);
+      footprints[use.resource].stages |= info.stages;
+      footprints[use.resource].writes |= info.writes;
+    }
+  }
+
+  std::vector<State> states(resources.size());
+  for (Resource r = 0; r < (Resource) resources.size(); ++r)
+  {
+    const ResourceInfo &resource = resources[r];
+    states[r].layout = resource.initial_layout;
+    states[r].write_stages = resource.initial_stages;
+    if (!resource.created || resource.first_pass == SIZE_MAX)
+      continue;
+
+    // Contents are discarded, but the memory was last used by the previous image of the group,
+    // or in the previous frame by the last one. Lazily allocated images only follow themselves.
+    Resource previous = r;
+    if (resource.alias_group != SIZE_MAX)
+    {
+      const std::vector<Resource> &members = alias_groups[resource.alias_group].images;
+      const size_t index = std::find(members.begin(), members.end(), r) - members.begin();
+      previous = members[(index + members.size() - 1) % members.size()];
+    }
+    states[r].write_stages = footprints[previous].stages;
+    states[r].write_access = footprints[previous].writes;
+  }
+
+  for (auto &pass : passes)
+  {
+    pass.before = Barriers();
+    for (auto &use : pass.uses)
+    {
+      const AccessInfo info = Describe(use.access);
+      const ResourceInfo &resource = resources[use.resource];
+      State &state = states[use.resource];
+      const bool managed = use.render_pass_layout != VK_IMAGE_LAYOUT_UNDEFINED;
+      const bool transition = resource.image && !managed && state.layout != info.layout;
+
+      // Writes and transitions wait for every earlier access, reads only for the last write.
+      VkPipelineStageFlags src_stages = 0;
+      VkAccessFlags src_access = 0;
+      if (info.writes != 0 || transition)
+      {
+        src_stages = state.write_stages | state.read_stages;
+        src_access = state.write_access;
+      }
+      else if (state.write_stages != 0 && ((info.stages & ~state.visible_stages) != 0 || (info.access & ~state.visible_access) != 0))
+      {
+        src_stages = state.write_stages;
+        src_access = state.write_access;
+      }
+
+      if (src_stages != 0 || transition)
+      {
+        pass.before.src_stages |= src_stages != 0 ? src_stages : (VkPipelineStageFlags) VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        pass.before.dst_stages |= info.stages;
+        if (transition)
+          pass.before.images.push_back({use.resource, src_access, info.access, state.layout, info.layout});
+        else
+        {
+          pass.before.src_access |= src_access;
+          pass.before.dst_access |= info.access;
+        }
+      }
+
+      if (info.writes != 0)
+      {
+        state.write_stages = info.stages;
+        state.write_access = info.writes;
+        state.read_stages = 0;
+        state.visible_stages = 0;
+        state.visible_access = 0;
+      }
+      else if (transition)
+      {
+        // The transition is a write the later readers have to wait for.
+        state.write_stages = info.stages;
+        state.write_access = 0;
+        state.read_stages = info.stages;
+        state.visible_stages = info.stages;
+        state.visible_access = info.access;
+      }
+      else
+      {
+        state.read_stages |= info.stages;
+        state.visible_stages |= info.stages;
+        state.visible_access |= info.access;
+      }
+      if (resource.image)
+        state.layout = managed ? use.render_pass_layout : info.layout;
+    }
+  }
+
+  after = Barriers();
+  for (Resource r = 0; r < (Resource) resources.size(); ++r)
+  {
+    const ResourceInfo &resource = resources[r];
+    const State &state = states[r];
+    if (!resource.image || resource.created || resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || resource.final_layout == state.layout)
+      continue;
+
+    const VkPipelineStageFlags src_stages = state.write_stages | state.read_stages;
+    after.src_stages |= src_stages != 0 ? src_stages : (VkPipelineStageFlags) VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    after.dst_stages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    after.images.push_back({r, state.write_access, 0, state.layout, resource.final_layout});
+  }
+}
+
+VkImage RenderGraph::Image(const Resource resource, const size_t image_index) const
+{
+  return resources[resource].created ? resources[resource].attachment.image : resources[resource].source(image_index);
+}
+
+void RenderGraph::RecordBarriers(const VkCommandBuffer command_buffer, const size_t image_index, const Barriers &barriers) const
+{
+  if (barriers.src_stages == 0)
+    return;
+
+  VkMemoryBarrier memory = {};
+  memory.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memory.srcAccessMask = barriers.src_access;
+  memory.dstAccessMask = barriers.dst_access;
+  const bool global = barriers.src_access != 0 || barriers.dst_access != 0;
+
+  std::vector<VkImageMemoryBarrier> images(barriers.images.size());
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    const ImageBarrier &barrier = barriers.images[i];
+    images[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    images[i].srcAccessMask = barrier.src_access;
+    images[i].dstAccessMask = barrier.dst_access;
+    images[i].oldLayout = barrier.old_layout;
+    images[i].newLayout = barrier.new_layout;
+    images[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    images[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    images[i].image = Image(barrier.resource, image_index);
+    images[i].subresourceRange = {resources[barrier.resource].aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+  }
+
+  vkCmdPipelineBarrier(command_buffer, barriers.src_stages, barriers.dst_stages, 0, global ? 1 : 0, &memory, 0, nullptr,
+                       (uint32_t) images.size(), images.data());
+}
+
+void RenderGraph::Execute(const VkCommandBuffer command_buffer, const size_t image_index) const
+{
+  if (!compiled)
+    throw std::runtime_error("render graph is not compiled!");
+
+  for (auto &pass : passes)
+  {
+    RecordBarriers(command_buffer, image_index, pass.before);
+    pass.record(command_buffer, image_index);
+  }
+  RecordBarriers(command_buffer, image_index, after);
+}
+
+size_t RenderGraph::AliasedImagesCount() const
+{
+  size_t count = 0;
+  for (auto &group : alias_groups)
+    count += group.images.size() > 1 ? group.images.size() : 0;
+  return count;
+}
@@ -0,0 +1,156 @@
+#ifndef __VISUALENGINE_RENDERGRAPH_H
+#define __VISUALENGINE_RENDERGRAPH_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "DeviceAllocator.h"
+#include "RenderTargets.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// The passes of a frame with the resources each reads and writes, recorded in declaration order.
+// Barriers and layout transitions are derived from the declared uses, so a pass records only its
+// own work. Buffer hazards become one global memory barrier per pass, images get their own.
+// Imported resources belong to someone else, images are looked up per image index on Execute.
+// Images created by the graph live as long as it does: those with TRANSIENT_ATTACHMENT usage get
+// lazily allocated memory of their own, the others share memory with every created image whose
+// passes do not overlap theirs. Rebuild the graph when its passes change, not every frame.
+class RenderGraph
+{
+public:
+  using Resource = uint32_t;
+
+  enum class Access
+  {
+    IndirectRead,       // indirect draw arguments and counts
+    VertexShaderRead,   // storage or uniform data, sampled images
+    FragmentShaderRead,
+    ComputeRead,
+    ComputeWrite,
+    TransferRead,
+    TransferWrite,
+    ColorAttachment,
+    DepthAttachment
+  };
+
+  struct Use
+  {
+    Resource resource;
+    Access access;
+    // Attachments of a VkRenderPass: the final layout the render pass leaves the image in.
+    // The graph then only orders the accesses and leaves the transitions to the render pass.
+    VkImageLayout render_pass_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  struct ImageInfo
+  {
+    VkExtent2D extent = {};
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    VkImageUsageFlags usage = 0;
+    VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+  };
+
+  using ImageSource = std::function<VkImage(const size_t image_index)>;
+  using Record = std::function<void(const VkCommandBuffer command_buffer, const size_t image_index)>;
+private:
+  struct ResourceInfo
+  {
+    std::string name;
+    bool image = false;
+    VkImageAspectFlags aspect = 0;
+    ImageSource source;
+    VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags initial_stages = 0;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    bool created = false;
+    ImageInfo info;
+    RenderTargets::Attachment attachment; // created images, memory is unset when aliased
+    size_t alias_group = SIZE_MAX;
+
+    size_t first_pass = SIZE_MAX;
+    size_t last_pass = 0;
+  };
+
+  struct ImageBarrier
+  {
+    Resource resource;
+    VkAccessFlags src_access;
+    VkAccessFlags dst_access;
+    VkImageLayout old_layout;
+    VkImageLayout new_layout;
+  };
+
+  struct Barriers
+  {
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkAccessFlags src_access = 0; // buffers, as one global memory barrier
+    VkAccessFlags dst_access = 0;
+    std::vector<ImageBarrier> images;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    std::vector<Use> uses;
+    Record record;
+    Barriers before;
+  };
+
+  struct AliasGroup
+  {
+    std::vector<Resource> images;
+    VkMemoryRequirements requirements = {};
+    DeviceAllocation memory;
+  };
+
+  std::shared_ptr<Vulkan::Device> device;
+  std::shared_ptr<DeviceAllocator> allocator;
+  std::vector<ResourceInfo> resources;
+  std::vector<Pass> passes;
+  std::vector<AliasGroup> alias_groups;
+  Barriers after; // final layouts of imported images
+  bool compiled = false;
+
+  void CreateImages();
+  void DeriveBarriers();
+  void RecordBarriers(const VkCommandBuffer command_buffer, const size_t image_index, const Barriers &barriers) const;
+  VkImage Image(const Resource resource, const size_t image_index) const;
+public:
+  RenderGraph() = delete;
+  RenderGraph(const RenderGraph &obj) = delete;
+  RenderGraph &operator=(const RenderGraph &obj) = delete;
+  RenderGraph(const std::shared_ptr<Vulkan::Device> dev);
+  ~RenderGraph();
+
+  // Buffers synchronized with earlier submissions by the caller, e.g. through fences.
+  Resource ImportBuffer(const std::string &name);
+  // initial_layout and initial_stages describe the image when the command buffer starts, e.g.
+  // UNDEFINED and the stage the acquire semaphore is waited at for a swapchain image. After the
+  // last pass the image is moved to final_layout, unless that is UNDEFINED.
+  Resource ImportImage(const std::string &name, const VkImageAspectFlags aspect, ImageSource source,
+                       const VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED, const VkPipelineStageFlags initial_stages = 0,
+                       const VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED);
+  // Contents do not survive from one frame to the next.
+  Resource CreateImage(const std::string &name, const ImageInfo &info);
+
+  void AddPass(const std::string &name, const std::vector<Use> &uses, Record record);
+
+  // Creates and aliases the images and derives every barrier, passes cannot be added afterwards.
+  void Compile();
+  void Execute(const VkCommandBuffer command_buffer, const size_t image_index) const;
+
+  // Created images, valid after Compile.
+  VkImage GetImage(const Resource resource) const { return resources[resource].attachment.image; }
+  VkImageView GetView(const Resource resource) const { return resources[resource].attachment.view; }
+  size_t PassesCount() const { return passes.size(); }
+  size_t AliasedImagesCount() const;
+  size_t MemoryBlocksCount() const { return alias_groups.size(); }
+};
+
+#endif
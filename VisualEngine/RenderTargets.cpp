@@ -0,0 +1,248 @@
+#include "RenderTargets.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+  VkFormat FindDepthFormat(const VkPhysicalDevice physical_device)
+  {
+    for (VkFormat format : {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT})
+    {
+      VkFormatProperties properties = {};
+      vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+      if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0)
+        return format;
+    }
+    throw std::runtime_error("failed to find a depth format!");
+  }
+
+  VkSampleCountFlagBits SupportedSamples(const VkPhysicalDevice physical_device, const VkSampleCountFlagBits requested)
+  {
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    const VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+    uint32_t samples = (uint32_t) requested;
+    while (samples > 1 && (supported & samples) == 0)
+      samples >>= 1;
+    return (VkSampleCountFlagBits) std::max<uint32_t>(samples, 1);
+  }
+}
+
+RenderTargets::RenderTargets(const std::shared_ptr<Vulkan::Device> dev, const VkFormat format, const VkImageLayout layout,
+                             const VkSampleCountFlagBits samples_count)
+{
+  device = dev;
+  color_format = format;
+  final_layout = layout;
+  samples = SupportedSamples(device->GetPhysicalDevice(), samples_count);
+  depth_format = FindDepthFormat(device->GetPhysicalDevice());
+  CreateRenderPass();
+}
+
+RenderTargets::~RenderTargets()
+{
+  // Resizing to no images hands everything back for destruction.
+  Resize({0, 0}, {})();
+  if (render_pass != VK_NULL_HANDLE)
+    vkDestroyRenderPass(device->GetDevice(), render_pass, nullptr);
+}
+
+std::function<void()> RenderTargets::Resize(const VkExtent2D size, const std::vector<VkImageView> &color_views)
+{
+  Attachment new_multisampled;
+  Attachment new_depth;
+  std::vector<VkFramebuffer> new_framebuffers(color_views.size(), VK_NULL_HANDLE);
+  if (!color_views.empty())
+  {
+    if (samples != VK_SAMPLE_COUNT_1_BIT)
+      new_multisampled = CreateAttachment(device, size, color_format, samples, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                          VK_IMAGE_ASPECT_COLOR_BIT);
+    new_depth = CreateAttachment(device, size, depth_format, samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+                                 VK_IMAGE_ASPECT_DEPTH_BIT);
+  }
+
+  for (size_t i = 0; i < color_views.size(); ++i)
+  {
+    std::vector<VkImageView> attachments;
+    if (samples != VK_SAMPLE_COUNT_1_BIT)
+      attachments = {new_multisampled.view, new_depth.view, color_views[i]};
+    else
+      attachments = {color_views[i], new_depth.view};
+
+    VkFramebufferCreateInfo framebuffer_info = {};
+    framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebuffer_info.renderPass = render_pass;
+    framebuffer_info.attachmentCount = (uint32_t) attachments.size();
+    framebuffer_info.pAttachments = attachments.data();
+    framebuffer_info.width = size.width;
+    framebuffer_info.height = size.height;
+    framebuffer_info.layers = 1;
+    if (vkCreateFramebuffer(device->GetDevice(), &framebuffer_info, nullptr, &new_framebuffers[i]) != VK_SUCCESS)
+      throw std::runtime_error("failed to create framebuffer!");
+  }
+
+  Attachment old_multisampled = multisampled;
+  Attachment old_depth = depth;
+  std::vector<VkFramebuffer> old_framebuffers = std::move(framebuffers);
+  multisampled = new_multisampled;
+  depth = new_depth;
+  framebuffers = std::move(new_framebuffers);
+  extent = size;
+
+  auto dev = device;
+  return [dev, old_multisampled, old_depth, old_framebuffers]() mutable
+  {
+    for (auto framebuffer : old_framebuffers)
+    {
+      if (framebuffer != VK_NULL_HANDLE)
+        vkDestroyFramebuffer(dev->GetDevice(), framebuffer, nullptr);
+    }
+    DestroyAttachment(dev, old_depth);
+    DestroyAttachment(dev, old_multisampled);
+  };
+}
+
+RenderTargets::Attachment RenderTargets::CreateAttachment(const std::shared_ptr<Vulkan::Device> &dev, const VkExtent2D size, const VkFormat format,
+                                                          const VkSampleCountFlagBits samples_count, const VkImageUsageFlags usage, const VkImageAspectFlags aspect)
+{
+  Attachment attachment;
+
+  VkImageCreateInfo image_info = {};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.format = format;
+  image_info.extent = {size.width, size.height, 1};
+  image_info.mipLevels = 1;
+  image_info.arrayLayers = 1;
+  image_info.samples = samples_count;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = usage;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  if (vkCreateImage(dev->GetDevice(), &image_info, nullptr, &attachment.image) != VK_SUCCESS)
+    throw std::runtime_error("failed to create attachment image!");
+
+  VkMemoryRequirements requirements = {};
+  vkGetImageMemoryRequirements(dev->GetDevice(), attachment.image, &requirements);
+
+  // Transient attachments never leave the tile memory on GPUs that can back them lazily,
+  // such memory cannot be sub-allocated.
+  attachment.allocator = DeviceAllocator::For(dev);
+  const bool transient = (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+  try
+  {
+    try
+    {
+      attachment.memory = transient ?
+                          attachment.allocator->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                                                         DeviceAllocator::Resource::Image, true) :
+                          attachment.allocator->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DeviceAllocator::Resource::Image);
+    }
+    catch (const std::runtime_error &)
+    {
+      if (!transient)
+        throw;
+      attachment.memory = attachment.allocator->Allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DeviceAllocator::Resource::Image);
+    }
+  }
+  catch (const std::runtime_error &)
+  {
+    DestroyAttachment(dev, attachment);
+    throw std::runtime_error("failed to allocate attachment image memory!");
+  }
+  vkBindImageMemory(dev->GetDevice(), attachment.image, attachment.memory.memory, attachment.memory.offset);
+
+  VkImageViewCreateInfo view_info = {};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = attachment.image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.subresourceRange = {aspect, 0, 1, 0, 1};
+  if (vkCreateImageView(dev->GetDevice(), &view_info, nullptr, &attachment.view) != VK_SUCCESS)
+  {
+    DestroyAttachment(dev, attachment);
+    throw std::runtime_error("failed to create attachment image view!");
+  }
+
+  return attachment;
+}
+
+void RenderTargets::DestroyAttachment(const std::shared_ptr<Vulkan::Device> &dev, Attachment &attachment)
+{
+  if (attachment.view != VK_NULL_HANDLE)
+    vkDestroyImageView(dev->GetDevice(), attachment.view, nullptr);
+  if (attachment.image != VK_NULL_HANDLE)
+    vkDestroyImage(dev->GetDevice(), attachment.image, nullptr);
+  if (attachment.memory.id != 0)
+    attachment.allocator->Free(attachment.memory);
+  attachment = Attachment();
+}
+
+void RenderTargets::CreateRenderPass()
+{
+  const bool resolve = samples != VK_SAMPLE_COUNT_1_BIT;
+
+  VkAttachmentDescription color = {};
+  color.format = color_format;
+  color.samples = samples;
+  color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color.storeOp = resolve ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+  color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  color.finalLayout = resolve ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : final_layout;
+
+  VkAttachmentDescription depth_attachment = {};
+  depth_attachment.format = depth_format;
+  depth_attachment.samples = samples;
+  depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkAttachmentDescription resolved = color;
+  resolved.samples = VK_SAMPLE_COUNT_1_BIT;
+  resolved.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  resolved.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  resolved.finalLayout = final_layout;
+
+  std::vector<VkAttachmentDescription> attachments = {color, depth_attachment};
+  if (resolve)
+    attachments.push_back(resolved);
+
+  VkAttachmentReference color_ref = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference depth_ref = {1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  VkAttachmentReference resolve_ref = {2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+
+  VkSubpassDescription subpass = {};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &color_ref;
+  subpass.pResolveAttachments = resolve ? &resolve_ref : nullptr;
+  subpass.pDepthStencilAttachment = &depth_ref;
+
+  // The shared multisampled and depth buffers are reused by the next frame, and the previous
+  // use of a color image (presentation or readback) has to finish before it is rendered again.
+  VkSubpassDependency dependency = {};
+  dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependency.dstSubpass = 0;
+  dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+  dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+  dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  VkRenderPassCreateInfo render_pass_info = {};
+  render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_info.attachmentCount = (uint32_t) attachments.size();
+  render_pass_info.pAttachments = attachments.data();
+  render_pass_info.subpassCount = 1;
+  render_pass_info.pSubpasses = &subpass;
+  render_pass_info.dependencyCount = 1;
+  render_pass_info.pDependencies = &dependency;
+  if (vkCreateRenderPass(device->GetDevice(), &render_pass_info, nullptr, &render_pass) != VK_SUCCESS)
+    throw std::runtime_error("failed to create render pass!");
+}
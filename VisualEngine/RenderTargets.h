@@ -0,0 +1,68 @@
+#ifndef __VISUALENGINE_RENDERTARGETS_H
+#define __VISUALENGINE_RENDERTARGETS_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "DeviceAllocator.h"
+
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// The single subpass render pass with the attachment order of
+// CreateOneSubpassRenderPassMultisamplingDepth: multisampled color, depth, resolved color,
+// or only color and depth without multisampling. The color images are owned elsewhere
+// (swapchain or offscreen images), one shared multisampled color and depth buffer and a
+// framebuffer per color image are owned here.
+// The render pass only depends on the formats and the sample count, so it outlives resizes:
+// Resize rebuilds just the attachments and framebuffers.
+class RenderTargets
+{
+public:
+  struct Attachment
+  {
+    VkImage image = VK_NULL_HANDLE;
+    std::shared_ptr<DeviceAllocator> allocator;
+    DeviceAllocation memory;
+    VkImageView view = VK_NULL_HANDLE;
+  };
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkFormat color_format = VK_FORMAT_UNDEFINED;
+  VkFormat depth_format = VK_FORMAT_D32_SFLOAT;
+  VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  VkRenderPass render_pass = VK_NULL_HANDLE;
+  VkExtent2D extent = {};
+  Attachment multisampled;
+  Attachment depth;
+  std::vector<VkFramebuffer> framebuffers;
+
+  void CreateRenderPass();
+public:
+  RenderTargets() = delete;
+  RenderTargets(const RenderTargets &obj) = delete;
+  RenderTargets &operator=(const RenderTargets &obj) = delete;
+  // samples_count is lowered to what the device supports for both color and depth.
+  // Color images end up in layout, e.g. PRESENT_SRC_KHR or TRANSFER_SRC_OPTIMAL.
+  RenderTargets(const std::shared_ptr<Vulkan::Device> dev, const VkFormat format, const VkImageLayout layout, const VkSampleCountFlagBits samples_count);
+  ~RenderTargets();
+
+  // Replaces the attachments and framebuffers for color images of a new size. The returned
+  // function destroys the replaced ones, once no submitted frame uses them any more.
+  std::function<void()> Resize(const VkExtent2D size, const std::vector<VkImageView> &color_views);
+
+  VkRenderPass GetRenderPass() const { return render_pass; }
+  VkFramebuffer GetFrameBuffer(const size_t image_index) const { return framebuffers[image_index]; }
+  VkExtent2D GetExtent() const { return extent; }
+  VkFormat GetColorFormat() const { return color_format; }
+  VkSampleCountFlagBits GetSamplesCount() const { return samples; }
+
+  // Device local image with a view over its first level, lazily allocated when usage has
+  // TRANSIENT_ATTACHMENT and the device offers such memory.
+  static Attachment CreateAttachment(const std::shared_ptr<Vulkan::Device> &dev, const VkExtent2D size, const VkFormat format,
+                                     const VkSampleCountFlagBits samples_count, const VkImageUsageFlags usage, const VkImageAspectFlags aspect);
+  static void DestroyAttachment(const std::shared_ptr<Vulkan::Device> &dev, Attachment &attachment);
+};
+
+#endif
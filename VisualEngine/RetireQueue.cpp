@@ -0,0 +1,25 @@
+#include "RetireQueue.h"
+
+void RetireQueue::Retire(const uint64_t serial, std::function<void()> destroy)
+{
+  if (destroy)
+    pending.push_back({serial, std::move(destroy)});
+}
+
+void RetireQueue::Collect(const uint64_t completed_serial)
+{
+  while (!pending.empty() && pending.front().first <= completed_serial)
+  {
+    pending.front().second();
+    pending.pop_front();
+  }
+}
+
+void RetireQueue::Flush()
+{
+  while (!pending.empty())
+  {
+    pending.front().second();
+    pending.pop_front();
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef __VISUALENGINE_RETIREQUEUE_H
+#define __VISUALENGINE_RETIREQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+// Deferred destruction of objects that submitted frames may still use. Objects are retired
+// with the serial of the last frame submitted before they were replaced and destroyed once
+// that frame has completed, so replacing them never waits for the GPU.
+class RetireQueue
+{
+private:
+  std::deque<std::pair<uint64_t, std::function<void()>>> pending;
+public:
+  RetireQueue() = default;
+  RetireQueue(const RetireQueue &obj) = delete;
+  RetireQueue &operator=(const RetireQueue &obj) = delete;
+  ~RetireQueue() { Flush(); }
+
+  // Serials only grow, so the queue stays ordered by them.
+  void Retire(const uint64_t serial, std::function<void()> destroy);
+  // Destroys everything retired at or before completed_serial.
+  void Collect(const uint64_t completed_serial);
+  // Destroys everything, the caller knows the device is idle.
+  void Flush();
+  size_t Size() const { return pending.size(); }
+};
+
+#endif
@@ -0,0 +1,81 @@
+#include "ScaledTarget.h"
+
+#include <algorithm>
+#include <cmath>
+
+ScaledTarget::ScaledTarget(const std::shared_ptr<Vulkan::Device> dev, const VkFormat format, const VkSampleCountFlagBits samples_count)
+{
+  device = dev;
+  color_format = format;
+  targets = std::make_shared<RenderTargets>(device, color_format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, samples_count);
+}
+
+ScaledTarget::~ScaledTarget()
+{
+  // Framebuffers go first, they still reference the images.
+  targets.reset();
+  for (auto &image : images)
+    RenderTargets::DestroyAttachment(device, image);
+}
+
+std::vector<VkImageView> ScaledTarget::Views() const
+{
+  std::vector<VkImageView> views(images.size());
+  for (size_t i = 0; i < images.size(); ++i)
+    views[i] = images[i].view;
+  return views;
+}
+
+void ScaledTarget::Resize(const VkExtent2D size, const size_t images_count, RetireQueue &retired, const uint64_t serial)
+{
+  std::vector<RenderTargets::Attachment> new_images(std::max<size_t>(images_count, 1));
+  for (auto &image : new_images)
+  {
+    image = RenderTargets::CreateAttachment(device, size, color_format, VK_SAMPLE_COUNT_1_BIT,
+                                            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+  }
+
+  // The old framebuffers are destroyed by the first retired function, the images they reference after it.
+  std::swap(images, new_images);
+  retired.Retire(serial, targets->Resize(size, Views()));
+  auto dev = device;
+  retired.Retire(serial, [dev, old_images = std::move(new_images)]() mutable
+  {
+    for (auto &image : old_images)
+      RenderTargets::DestroyAttachment(dev, image);
+  });
+  extent = size;
+}
+
+void ScaledTarget::SetSamplesCount(const VkSampleCountFlagBits samples_count, RetireQueue &retired, const uint64_t serial)
+{
+  std::shared_ptr<RenderTargets> old_targets = targets;
+  retired.Retire(serial, [old_targets]() mutable { old_targets.reset(); });
+  targets = std::make_shared<RenderTargets>(device, color_format, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, samples_count);
+  if (!images.empty())
+    targets->Resize(extent, Views());
+  render_pass_version++;
+}
+
+void ScaledTarget::SetScale(const float render_scale)
+{
+  scale = std::clamp(render_scale, 0.01f, 1.0f);
+}
+
+VkExtent2D ScaledTarget::GetRenderExtent() const
+{
+  return { std::max<uint32_t>((uint32_t) std::lround(extent.width * scale), 1),
+           std::max<uint32_t>((uint32_t) std::lround(extent.height * scale), 1) };
+}
+
+void ScaledTarget::RecordUpscale(const VkCommandBuffer command_buffer, const size_t image_index, const VkImage output, const VkExtent2D output_extent) const
+{
+  const VkExtent2D render_extent = GetRenderExtent();
+  VkImageBlit region = {};
+  region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.srcOffsets[1] = {(int32_t) render_extent.width, (int32_t) render_extent.height, 1};
+  region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.dstOffsets[1] = {(int32_t) output_extent.width, (int32_t) output_extent.height, 1};
+  vkCmdBlitImage(command_buffer, images[image_index].image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                 output, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region, VK_FILTER_LINEAR);
+}
@@ -0,0 +1,57 @@
+#ifndef __VISUALENGINE_SCALEDTARGET_H
+#define __VISUALENGINE_SCALEDTARGET_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "RenderTargets.h"
+#include "RetireQueue.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+// Scene images at the output size, of which only the top left render extent is drawn and
+// then stretched onto the output image. Changing the scale moves no memory: the render pass
+// and framebuffers keep their full size, only the render area and viewport shrink.
+// The color format matches the swapchain, so pipelines built for one work with the other.
+class ScaledTarget
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  VkFormat color_format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent = {};
+  float scale = 1.0f;
+  std::vector<RenderTargets::Attachment> images;
+  std::shared_ptr<RenderTargets> targets;
+  uint64_t render_pass_version = 0;
+
+  std::vector<VkImageView> Views() const;
+public:
+  ScaledTarget() = delete;
+  ScaledTarget(const ScaledTarget &obj) = delete;
+  ScaledTarget &operator=(const ScaledTarget &obj) = delete;
+  // samples_count is lowered to what the device supports for both color and depth.
+  ScaledTarget(const std::shared_ptr<Vulkan::Device> dev, const VkFormat format, const VkSampleCountFlagBits samples_count);
+  ~ScaledTarget();
+
+  // Replaces the images for a new output size, the replaced ones are retired with serial.
+  void Resize(const VkExtent2D size, const size_t images_count, RetireQueue &retired, const uint64_t serial);
+  // Replaces the render pass, pipelines built against the old one are stale.
+  void SetSamplesCount(const VkSampleCountFlagBits samples_count, RetireQueue &retired, const uint64_t serial);
+  // Fraction of the output size per axis, clamped to (0, 1].
+  void SetScale(const float render_scale);
+
+  // Records the stretch of the rendered area onto output. The render pass leaves the scene image
+  // in TRANSFER_SRC_OPTIMAL, output is expected in TRANSFER_DST_OPTIMAL, the caller orders both.
+  void RecordUpscale(const VkCommandBuffer command_buffer, const size_t image_index, const VkImage output, const VkExtent2D output_extent) const;
+
+  VkImage GetImage(const size_t image_index) const { return images[image_index].image; }
+  VkRenderPass GetRenderPass() const { return targets->GetRenderPass(); }
+  VkFramebuffer GetFrameBuffer(const size_t image_index) const { return targets->GetFrameBuffer(image_index); }
+  VkSampleCountFlagBits GetSamplesCount() const { return targets->GetSamplesCount(); }
+  uint64_t GetRenderPassVersion() const { return render_pass_version; }
+  float GetScale() const { return scale; }
+  VkExtent2D GetExtent() const { return extent; }
+  VkExtent2D GetRenderExtent() const;
+};
+
+#endif
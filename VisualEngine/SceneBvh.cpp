@@ -0,0 +1,278 @@
+#include "SceneBvh.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+  // Bit per child slot: visible when the box is not behind any plane, inside when it is
+  // in front of all of them. Plane signs pick the box corner, never a per-lane select.
+  int TestBoxes(const float *min_x, const float *min_y, const float *min_z,
+                const float *max_x, const float *max_y, const float *max_z,
+                const Frustum &frustum, int &inside)
+  {
+#if defined(__SSE2__)
+    const __m128 lo[3] = { _mm_load_ps(min_x), _mm_load_ps(min_y), _mm_load_ps(min_z) };
+    const __m128 hi[3] = { _mm_load_ps(max_x), _mm_load_ps(max_y), _mm_load_ps(max_z) };
+    __m128 outside = _mm_setzero_ps();
+    __m128 partial = _mm_setzero_ps();
+    for (const auto &plane : frustum.planes)
+    {
+      __m128 far_distance = _mm_set1_ps(plane.w);
+      __m128 near_distance = far_distance;
+      for (int a = 0; a < 3; ++a)
+      {
+        const __m128 n = _mm_set1_ps(plane[a]);
+        far_distance = _mm_add_ps(far_distance, _mm_mul_ps(n, plane[a] >= 0.0f ? hi[a] : lo[a]));
+        near_distance = _mm_add_ps(near_distance, _mm_mul_ps(n, plane[a] >= 0.0f ? lo[a] : hi[a]));
+      }
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(far_distance, _mm_setzero_ps()));
+      partial = _mm_or_ps(partial, _mm_cmplt_ps(near_distance, _mm_setzero_ps()));
+    }
+    const int visible = ~_mm_movemask_ps(outside) & 0xF;
+    inside = visible & ~_mm_movemask_ps(partial);
+    return visible;
+#else
+    const float *lo[3] = { min_x, min_y, min_z };
+    const float *hi[3] = { max_x, max_y, max_z };
+    int outside = 0, partial = 0;
+    for (const auto &plane : frustum.planes)
+    {
+      for (int lane = 0; lane < 4; ++lane)
+      {
+        float far_distance = plane.w, near_distance = plane.w;
+        for (int a = 0; a < 3; ++a)
+        {
+          far_distance += plane[a] * (plane[a] >= 0.0f ? hi[a][lane] : lo[a][lane]);
+          near_distance += plane[a] * (plane[a] >= 0.0f ? lo[a][lane] : hi[a][lane]);
+        }
+        outside |= (far_distance < 0.0f) << lane;
+        partial |= (near_distance < 0.0f) << lane;
+      }
+    }
+    const int visible = ~outside & 0xF;
+    inside = visible & ~partial;
+    return visible;
+#endif
+  }
+}
+
+Aabb Aabb::Transformed(const glm::mat4 &transform) const
+{
+  glm::vec3 center = glm::vec3(transform * glm::vec4((min + max) * 0.5f, 1.0f));
+  glm::mat3 absolute = glm::mat3(transform);
+  for (int i = 0; i < 3; ++i)
+    absolute[i] = glm::abs(absolute[i]);
+  glm::vec3 extent = absolute * ((max - min) * 0.5f);
+  return { center - extent, center + extent };
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4 &view_projection)
+{
+  auto row = [&view_projection](const int i)
+  {
+    return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]);
+  };
+
+  Frustum result;
+  result.planes[0] = row(3) + row(0); // left
+  result.planes[1] = row(3) - row(0); // right
+  result.planes[2] = row(3) + row(1); // bottom
+  result.planes[3] = row(3) - row(1); // top
+  result.planes[4] = row(2);          // near
+  result.planes[5] = row(3) - row(2); // far
+  return result;
+}
+
+void SceneBvh::Build(const std::vector<Aabb> &boxes)
+{
+  nodes.clear();
+  object_slots.assign(boxes.size(), 0);
+  dirty_nodes = 0;
+  if (boxes.empty())
+    return;
+
+  std::vector<glm::vec3> centers(boxes.size());
+  order.resize(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    centers[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+    order[i] = (uint32_t) i;
+  }
+  nodes.reserve(boxes.size() / 2 + 1);
+  BuildNode(boxes, centers, 0, boxes.size(), -1);
+}
+
+int32_t SceneBvh::BuildNode(const std::vector<Aabb> &boxes, const std::vector<glm::vec3> &centers, const size_t begin, const size_t end, const int32_t parent)
+{
+  const int32_t index = (int32_t) nodes.size();
+  nodes.push_back({});
+  nodes[index].parent = parent;
+  nodes[index].dirty = false;
+  for (size_t s = 0; s < 4; ++s)
+  {
+    nodes[index].child[s] = empty;
+    SetSlot(nodes[index], s, {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)});
+  }
+
+  // Median split on the longest axis of the centers, twice, gives the four children.
+  auto split = [this, &centers](const size_t first, const size_t last)
+  {
+    glm::vec3 lo = centers[order[first]], hi = lo;
+    for (size_t i = first; i < last; ++i)
+    {
+      lo = glm::min(lo, centers[order[i]]);
+      hi = glm::max(hi, centers[order[i]]);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+    size_t middle = (first + last) / 2;
+    std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+                     [&centers, axis](const uint32_t a, const uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+    return middle;
+  };
+
+  size_t bounds[5] = {begin, begin + 1, begin + 2, begin + 3, end};
+  if (end - begin > 4)
+  {
+    bounds[2] = split(begin, end);
+    bounds[1] = split(begin, bounds[2]);
+    bounds[3] = split(bounds[2], end);
+  }
+
+  for (size_t s = 0; s < 4 && bounds[s] < end; ++s)
+  {
+    if (bounds[s + 1] - bounds[s] == 1)
+    {
+      const uint32_t object = order[bounds[s]];
+      nodes[index].child[s] = ~(int32_t) object;
+      object_slots[object] = (uint32_t) index * 4 + (uint32_t) s;
+      SetSlot(nodes[index], s, boxes[object]);
+    }
+    else
+    {
+      const int32_t child = BuildNode(boxes, centers, bounds[s], bounds[s + 1], index);
+      nodes[index].child[s] = child;
+      SetSlot(nodes[index], s, NodeBounds(nodes[child]));
+    }
+  }
+  return index;
+}
+
+void SceneBvh::SetSlot(Node &node, const size_t slot, const Aabb &box)
+{
+  node.min_x[slot] = box.min.x;
+  node.min_y[slot] = box.min.y;
+  node.min_z[slot] = box.min.z;
+  node.max_x[slot] = box.max.x;
+  node.max_y[slot] = box.max.y;
+  node.max_z[slot] = box.max.z;
+}
+
+Aabb SceneBvh::NodeBounds(const Node &node) const
+{
+  Aabb result = {glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX)};
+  for (size_t s = 0; s < 4; ++s)
+  {
+    if (node.child[s] == empty)
+      continue;
+    result.min = glm::min(result.min, glm::vec3(node.min_x[s], node.min_y[s], node.min_z[s]));
+    result.max = glm::max(result.max, glm::vec3(node.max_x[s], node.max_y[s], node.max_z[s]));
+  }
+  return result;
+}
+
+void SceneBvh::Update(const size_t object, const Aabb &box)
+{
+  Node &node = nodes[object_slots[object] / 4];
+  SetSlot(node, object_slots[object] % 4, box);
+  if (!node.dirty)
+  {
+    node.dirty = true;
+    ++dirty_nodes;
+  }
+}
+
+void SceneBvh::Refit()
+{
+  if (dirty_nodes == 0)
+    return;
+
+  // Children come after their parent, one backwards pass settles every level below it.
+  for (size_t i = nodes.size(); i-- > 0;)
+  {
+    if (!nodes[i].dirty)
+      continue;
+    nodes[i].dirty = false;
+    if (nodes[i].parent < 0)
+      continue;
+
+    Node &parent = nodes[nodes[i].parent];
+    for (size_t s = 0; s < 4; ++s)
+    {
+      if (parent.child[s] == (int32_t) i)
+        SetSlot(parent, s, NodeBounds(nodes[i]));
+    }
+    parent.dirty = true;
+  }
+  dirty_nodes = 0;
+}
+
+CullStats SceneBvh::Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const
+{
+  CullStats stats;
+  stats.objects = object_slots.size();
+  if (nodes.empty())
+    return stats;
+
+  const size_t visible_before = visible.size();
+  std::vector<int32_t> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+  while (!stack.empty())
+  {
+    const Node &node = nodes[stack.back()];
+    stack.pop_back();
+    ++stats.nodes_tested;
+
+    int inside = 0;
+    const int mask = TestBoxes(node.min_x, node.min_y, node.min_z, node.max_x, node.max_y, node.max_z, frustum, inside);
+    for (int s = 0; s < 4; ++s)
+    {
+      const int32_t child = node.child[s];
+      if (child == empty)
+        continue;
+      if (child < 0)
+        ++stats.objects_tested;
+      if (!(mask & (1 << s)))
+        continue;
+
+      if (child < 0)
+        visible.push_back((uint32_t) ~child);
+      else if (inside & (1 << s))
+        AddSubtree(child, visible);
+      else
+        stack.push_back(child);
+    }
+  }
+
+  stats.objects_culled = stats.objects - (visible.size() - visible_before);
+  return stats;
+}
+
+void SceneBvh::AddSubtree(const int32_t node, std::vector<uint32_t> &visible) const
+{
+  for (const int32_t child : nodes[node].child)
+  {
+    if (child == empty)
+      continue;
+    if (child < 0)
+      visible.push_back((uint32_t) ~child);
+    else
+      AddSubtree(child, visible);
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef __VISUALENGINE_SCENEBVH_H
+#define __VISUALENGINE_SCENEBVH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+struct Aabb
+{
+  glm::vec3 min = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 max = { 0.0f, 0.0f, 0.0f };
+
+  // The box around this one after transform, looser than the transformed contents.
+  Aabb Transformed(const glm::mat4 &transform) const;
+};
+
+// Six inward facing planes (xyz normal, w distance), a point p is inside when dot(xyz, p) + w >= 0 for all.
+struct Frustum
+{
+  glm::vec4 planes[6];
+
+  // Planes of proj * view for a [0, 1] depth range.
+  static Frustum FromMatrix(const glm::mat4 &view_projection);
+};
+
+// What the last Cull call did, objects fully inside a visible node are accepted without a test.
+struct CullStats
+{
+  size_t objects = 0;
+  size_t nodes_tested = 0;
+  size_t objects_tested = 0;
+  size_t objects_culled = 0;
+};
+
+// Four-wide bounding volume hierarchy over object boxes. Every node keeps the boxes of its
+// four children in SoA order, so one frustum plane is tested against all of them at once with
+// SSE. Boxes are updated in place and refitted bottom-up, the tree shape is only rebuilt by Build.
+class SceneBvh
+{
+private:
+  // A child is a node index, ~object for an object, or empty. Empty slots have inverted bounds
+  // and fail every plane test.
+  static constexpr int32_t empty = INT32_MIN;
+
+  struct alignas(16) Node
+  {
+    float min_x[4];
+    float min_y[4];
+    float min_z[4];
+    float max_x[4];
+    float max_y[4];
+    float max_z[4];
+    int32_t child[4];
+    int32_t parent; // node index, -1 at the root
+    bool dirty;
+  };
+
+  std::vector<Node> nodes; // parents before their children
+  std::vector<uint32_t> object_slots; // node * 4 + child slot of every object
+  std::vector<uint32_t> order;
+  size_t dirty_nodes = 0;
+
+  int32_t BuildNode(const std::vector<Aabb> &boxes, const std::vector<glm::vec3> &centers, const size_t begin, const size_t end, const int32_t parent);
+  void SetSlot(Node &node, const size_t slot, const Aabb &box);
+  Aabb NodeBounds(const Node &node) const;
+  void AddSubtree(const int32_t node, std::vector<uint32_t> &visible) const;
+public:
+  SceneBvh() = default;
+  SceneBvh(const SceneBvh &obj) = delete;
+  SceneBvh &operator=(const SceneBvh &obj) = delete;
+  ~SceneBvh() = default;
+
+  void Build(const std::vector<Aabb> &boxes);
+  // Takes effect with the next Refit, which only revisits nodes above updated objects.
+  void Update(const size_t object, const Aabb &box);
+  void Refit();
+  // Appends the objects that intersect the frustum to visible, in no particular order.
+  CullStats Cull(const Frustum &frustum, std::vector<uint32_t> &visible) const;
+  size_t ObjectsCount() const { return object_slots.size(); }
+};
+
+#endif
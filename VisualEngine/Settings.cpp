@@ -1,11 +1,195 @@
 #include "Settings.h"
 
-void Settings::Load(const std::string file)
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+
+namespace
 {
+  template <class T>
+  struct Name
+  {
+    T value;
+    const char *name;
+  };
+
+  const Name<WindowMode_t> window_modes[] = {
+    {WindowMode_t::Window, "window"},
+    {WindowMode_t::BorderlessWindow, "borderless"},
+    {WindowMode_t::FullScreenWindow, "fullscreen"}
+  };
+
+  const Name<PresentMode_t> present_modes[] = {
+    {PresentMode_t::DefaultFIFO, "fifo"},
+    {PresentMode_t::RelaxedFIFO, "fifo_relaxed"},
+    {PresentMode_t::Mailbox, "mailbox"},
+    {PresentMode_t::Immediate, "immediate"}
+  };
+
+  std::string Trim(const std::string &text)
+  {
+    const size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+      return "";
+    return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+  }
+
+  template <class T, size_t N>
+  bool ParseName(const std::string &text, const Name<T> (&names)[N], T &out)
+  {
+    for (auto &entry : names)
+    {
+      if (text == entry.name)
+      {
+        out = entry.value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <class T, size_t N>
+  const char *ToName(const T value, const Name<T> (&names)[N])
+  {
+    for (auto &entry : names)
+    {
+      if (entry.value == value)
+        return entry.name;
+    }
+    return names[0].name;
+  }
+
+  bool ParseBool(const std::string &text, bool &out)
+  {
+    if (text == "true" || text == "on" || text == "1")
+      out = true;
+    else if (text == "false" || text == "off" || text == "0")
+      out = false;
+    else
+      return false;
+    return true;
+  }
+
+  // out is only assigned a value that passes valid, a rejected line keeps the previous setting.
+  template <class T, class Valid>
+  bool ParseNumber(const std::string &text, T &out, Valid valid)
+  {
+    // Extraction wraps "-1" around for unsigned types instead of failing.
+    if (std::is_unsigned<T>::value && !text.empty() && text[0] == '-')
+      return false;
+
+    std::istringstream in(text);
+    T value = {};
+    if (!(in >> value) || !in.eof() || value < 0 || !valid(value))
+      return false;
+    out = value;
+    return true;
+  }
 
+  template <class T>
+  bool ParseNumber(const std::string &text, T &out)
+  {
+    return ParseNumber(text, out, [](const T) { return true; });
+  }
 }
 
-void Settings::Save(const std::string file)
+bool Settings::Load(const std::string file)
 {
+  std::ifstream in(file);
+  if (!in.is_open())
+    return false;
 
-}
\ No newline at end of file
+  std::string line;
+  for (size_t number = 1; std::getline(in, line); ++number)
+  {
+    line = Trim(line.substr(0, line.find('#')));
+    if (line.empty())
+      continue;
+
+    const size_t separator = line.find('=');
+    const std::string key = separator == std::string::npos ? line : Trim(line.substr(0, separator));
+    const std::string value = separator == std::string::npos ? "" : Trim(line.substr(separator + 1));
+
+    bool valid = false;
+    uint32_t samples = 0;
+    if (key == "device")
+    {
+      device_name = value;
+      valid = true;
+    }
+    else if (key == "width")
+      valid = ParseNumber(value, width, [](const size_t w) { return w > 0; });
+    else if (key == "height")
+      valid = ParseNumber(value, height, [](const size_t h) { return h > 0; });
+    else if (key == "window_mode")
+      valid = ParseName(value, window_modes, window_mode);
+    else if (key == "present_mode")
+      valid = ParseName(value, present_modes, present_mode);
+    else if (key == "msaa")
+    {
+      // Powers of two from 1 to 64, the same values as VkSampleCountFlagBits.
+      valid = ParseNumber(value, samples, [](const uint32_t n) { return n >= 1 && n <= 64 && (n & (n - 1)) == 0; });
+      if (valid)
+        multisampling = (MSAA_t) samples;
+    }
+    else if (key == "sample_shading")
+      valid = ParseNumber(value, sample_shading, [](const float f) { return f <= 1.0f; });
+    else if (key == "objects")
+      valid = ParseNumber(value, objects_count);
+    else if (key == "dynamic_resolution")
+      valid = ParseBool(value, dynamic_resolution);
+    else if (key == "frame_budget_ms")
+      valid = ParseNumber(value, frame_budget_ms, [](const double ms) { return ms > 0.0; });
+    else if (key == "min_render_scale")
+      valid = ParseNumber(value, min_render_scale, [](const float scale) { return scale > 0.0f && scale <= 1.0f; });
+    else if (key == "adaptive_quality")
+      valid = ParseBool(value, adaptive_quality);
+    else if (key == "lighting")
+      valid = ParseBool(value, lighting);
+    else if (key == "texturing")
+      valid = ParseBool(value, texturing);
+    else if (key == "frames_in_flight")
+      valid = ParseNumber(value, frames_in_flight, [](const size_t n) { return n > 0; });
+    else if (key == "low_latency")
+      valid = ParseBool(value, low_latency);
+
+    if (!valid)
+      std::cerr << file << ":" << number << ": ignoring \"" << line << "\"" << std::endl;
+  }
+  return true;
+}
+
+bool Settings::Save(const std::string file) const
+{
+  std::ofstream out(file, std::ios::trunc);
+  if (!out.is_open())
+    return false;
+
+  out << "# Read at start and again whenever the file changes, window and device settings need a restart.\n";
+  out << "device = " << device_name << "\n";
+  out << "width = " << width << "\n";
+  out << "height = " << height << "\n";
+  out << "window_mode = " << ToName(window_mode, window_modes) << "\n";
+  out << "# fifo, fifo_relaxed, mailbox or immediate, unsupported modes fall back to fifo\n";
+  out << "present_mode = " << ToName(present_mode, present_modes) << "\n";
+  out << "# samples per pixel, lowered to what the device supports\n";
+  out << "msaa = " << (uint32_t) multisampling << "\n";
+  out << "# minimum fraction of samples shaded per pixel, 0 turns sample shading off\n";
+  out << "sample_shading = " << sample_shading << "\n";
+  out << "objects = " << objects_count << "\n";
+  out << "# scales the render resolution to hold the GPU frame time under the budget\n";
+  out << "dynamic_resolution = " << (dynamic_resolution ? "on" : "off") << "\n";
+  out << "frame_budget_ms = " << frame_budget_ms << "\n";
+  out << "min_render_scale = " << min_render_scale << "\n";
+  out << "# below the minimum scale, lower sample shading and then MSAA as well\n";
+  out << "adaptive_quality = " << (adaptive_quality ? "on" : "off") << "\n";
+  out << "# off draws with pipeline variants that leave the lighting or texture sampling out\n";
+  out << "lighting = " << (lighting ? "on" : "off") << "\n";
+  out << "texturing = " << (texturing ? "on" : "off") << "\n";
+  out << "# frames recorded ahead of the GPU, more smooths out spikes, fewer cut input latency\n";
+  out << "frames_in_flight = " << frames_in_flight << "\n";
+  out << "# waits for the GPU first and reads input right before submitting, at some throughput\n";
+  out << "low_latency = " << (low_latency ? "on" : "off") << "\n";
+  return out.good();
+}
@@ -3,6 +3,7 @@
 
 #include <vulkan/vulkan.h>
 #include <iostream>
+#include <string>
 #include <vector>
 
 enum class WindowMode_t
@@ -40,11 +41,24 @@ private:
   WindowMode_t window_mode = WindowMode_t::Window;
   PresentMode_t present_mode = PresentMode_t::DefaultFIFO;
   MSAA_t multisampling = MSAA_t::x2;
+  size_t objects_count = 1;
+  float sample_shading = 0.5f; // minimum fraction of shaded samples, 0 turns sample shading off
+  bool dynamic_resolution = false;
+  double frame_budget_ms = 16.6;
+  float min_render_scale = 0.5f;
+  bool adaptive_quality = false; // lets dynamic resolution lower sample shading and MSAA too
+  bool lighting = true;
+  bool texturing = true;
+  size_t frames_in_flight = 2; // submitted frames the CPU may run ahead of the GPU
+  bool low_latency = false;    // wait for the GPU before sampling input instead of after
 public:
   Settings() = default;
   ~Settings() = default;
-  void Load(const std::string file);
-  void Save(const std::string file);
+  // One "key = value" per line, # starts a comment. Unknown keys and bad values are reported
+  // and skipped, so a partly broken file still applies everything else. Returns false when
+  // the file cannot be read.
+  bool Load(const std::string file);
+  bool Save(const std::string file) const;
 
   std::string DeviceName() const { return device_name; }
   void DeviceName(const std::string name) { device_name = name; }
@@ -63,6 +77,36 @@ public:
 
   MSAA_t Multisampling() const { return multisampling; }
   void Multisampling( const MSAA_t samples) { multisampling = samples; }
+
+  size_t ObjectsCount() const { return objects_count; }
+  void ObjectsCount(const size_t count) { objects_count = count; }
+
+  float SampleShading() const { return sample_shading; }
+  void SampleShading(const float fraction) { sample_shading = fraction; }
+
+  bool DynamicResolution() const { return dynamic_resolution; }
+  void DynamicResolution(const bool enable) { dynamic_resolution = enable; }
+
+  double FrameBudget() const { return frame_budget_ms; }
+  void FrameBudget(const double ms) { frame_budget_ms = ms; }
+
+  float MinRenderScale() const { return min_render_scale; }
+  void MinRenderScale(const float scale) { min_render_scale = scale; }
+
+  bool AdaptiveQuality() const { return adaptive_quality; }
+  void AdaptiveQuality(const bool enable) { adaptive_quality = enable; }
+
+  bool Lighting() const { return lighting; }
+  void Lighting(const bool enable) { lighting = enable; }
+
+  bool Texturing() const { return texturing; }
+  void Texturing(const bool enable) { texturing = enable; }
+
+  size_t FramesInFlight() const { return frames_in_flight; }
+  void FramesInFlight(const size_t count) { frames_in_flight = count; }
+
+  bool LowLatency() const { return low_latency; }
+  void LowLatency(const bool enable) { low_latency = enable; }
 };
 
 #endif
\ No newline at end of file
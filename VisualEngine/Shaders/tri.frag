@@ -1,15 +1,52 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(binding = 0) uniform UniformBuffer 
+{
+  mat4 view;
+  mat4 proj;
+  vec4 light;
+  vec4 texture_lod;
+} world;
+
+// MaterialTable, the array size is the table capacity of the device.
+layout(constant_id = 0) const int textures_capacity = 16;
+// PipelineVariants features, the disabled paths are removed when the pipeline is compiled.
+layout(constant_id = 1) const bool lit = true;
+layout(constant_id = 3) const bool textured = true;
+
+struct Material
+{
+  uint texture_index;
+  uint padding[3];
+  vec4 color;
+};
+
+layout(set = 1, binding = 0) uniform sampler2D textures[textures_capacity];
+layout(std430, set = 1, binding = 1) readonly buffer MaterialBuffer
+{
+  Material materials[];
+};
+
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 layout(location = 2) in vec3 fragLight;
+layout(location = 3) flat in uint fragMaterial;
 
 layout(location = 0) out vec4 outColor;
-layout(binding = 1) uniform sampler2D texSampler;
 
 void main() {
-  outColor = texture(texSampler, fragTexCoord);
-  vec3 l = vec3(outColor) * fragLight;
-  outColor = vec4(l, outColor[3]);
-}
\ No newline at end of file
+  // Draw batches never mix materials (OnAssetsResident), so the index is dynamically uniform
+  // as shaderSampledImageArrayDynamicIndexing requires, without descriptor indexing.
+  Material material = materials[fragMaterial];
+  if (textured)
+  {
+    // Levels finer than texture_lod.x are still streaming in.
+    float lod = max(textureQueryLod(textures[material.texture_index], fragTexCoord).y, world.texture_lod.x);
+    outColor = textureLod(textures[material.texture_index], fragTexCoord, lod) * material.color;
+  }
+  else
+    outColor = vec4(fragColor, 1.0) * material.color;
+  if (lit)
+    outColor = vec4(vec3(outColor) * fragLight, outColor[3]);
+}
@@ -3,34 +3,56 @@
 
 layout(binding = 0) uniform UniformBuffer 
 {
-  mat4 model;
   mat4 view;
   mat4 proj;
   vec4 light;
+  vec4 texture_lod;
 } world;
 
+struct Instance
+{
+  mat4 model;
+  mat3 normal;
+  uvec4 material;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer
+{
+  Instance instances[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 
+// PipelineVariants features, the disabled paths are removed when the pipeline is compiled.
+layout(constant_id = 1) const bool lit = true;
+layout(constant_id = 2) const bool instanced = true;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragLight;
+layout(location = 3) flat out uint fragMaterial;
 
 void main() 
 {  
   vec3 Ld = {1.0f, 1.0f, 1.0f};
   gl_PointSize = 3.0;
-  vec3 pos = inPosition + (gl_InstanceIndex * 2);
-  vec4 eye = world.view * world.model * vec4(pos, 1.0);
-  vec3 s = normalize(vec3(world.light - eye));
-  mat3 normal_matrix = transpose(inverse(mat3(world.model)));
-  vec3 norm = normalize(normal_matrix * inNormal);
-
-  fragLight = Ld * max(dot(s, norm), 0.0);
+  // Single draws keep their instance at the start of the dynamic offset.
+  Instance instance = instances[instanced ? gl_InstanceIndex : 0];
+  vec4 eye = world.view * instance.model * vec4(inPosition, 1.0);
+  if (lit)
+  {
+    vec3 s = normalize(vec3(world.light - eye));
+    vec3 norm = normalize(instance.normal * inNormal);
+    fragLight = Ld * max(dot(s, norm), 0.0);
+  }
+  else
+    fragLight = Ld;
   gl_Position = world.proj * eye;
   //vec3 cl = (inNormal + 1) / 2;
   fragColor = inColor;
   fragTexCoord = inTexCoord;
+  fragMaterial = instance.material.x;
 }
\ No newline at end of file
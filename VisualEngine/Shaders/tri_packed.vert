@@ -0,0 +1,67 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBuffer 
+{
+  mat4 view;
+  mat4 proj;
+  vec4 light;
+  vec4 texture_lod;
+} world;
+
+struct Instance
+{
+  mat4 model;
+  mat3 normal;
+  uvec4 material;
+};
+
+layout(std430, binding = 2) readonly buffer InstanceBuffer
+{
+  Instance instances[];
+};
+
+// Position is unorm16 inside the mesh bounds, the bounds transform is part of the instance model.
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec2 inNormal;
+
+// PipelineVariants features, the disabled paths are removed when the pipeline is compiled.
+layout(constant_id = 1) const bool lit = true;
+layout(constant_id = 2) const bool instanced = true;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragLight;
+layout(location = 3) flat out uint fragMaterial;
+
+vec3 OctDecode(vec2 e)
+{
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0);
+  n.x += n.x >= 0.0 ? -t : t;
+  n.y += n.y >= 0.0 ? -t : t;
+  return normalize(n);
+}
+
+void main() 
+{  
+  vec3 Ld = {1.0f, 1.0f, 1.0f};
+  gl_PointSize = 3.0;
+  // Single draws keep their instance at the start of the dynamic offset.
+  Instance instance = instances[instanced ? gl_InstanceIndex : 0];
+  vec4 eye = world.view * instance.model * vec4(inPosition.xyz, 1.0);
+  if (lit)
+  {
+    vec3 s = normalize(vec3(world.light - eye));
+    vec3 norm = normalize(instance.normal * OctDecode(inNormal));
+    fragLight = Ld * max(dot(s, norm), 0.0);
+  }
+  else
+    fragLight = Ld;
+  gl_Position = world.proj * eye;
+  fragColor = inColor.rgb;
+  fragTexCoord = inTexCoord;
+  fragMaterial = instance.material.x;
+}
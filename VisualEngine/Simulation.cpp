@@ -0,0 +1,98 @@
+#include "Simulation.h"
+
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+glm::mat4 SimulationState::Transform() const
+{
+  return glm::translate(glm::mat4(1.0f), position) * glm::mat4_cast(rotation);
+}
+
+Simulation::Simulation(const double rate_hz)
+{
+  rate = std::max(rate_hz, 1.0);
+  step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+  frames.Reset({state, state, std::chrono::steady_clock::now()});
+}
+
+void Simulation::Start()
+{
+  if (running.exchange(true))
+    return;
+  frames.Reset({state, state, std::chrono::steady_clock::now()});
+  thread = std::thread(&Simulation::Run, this);
+}
+
+void Simulation::Stop()
+{
+  running.store(false);
+  if (thread.joinable())
+    thread.join();
+}
+
+void Simulation::SetInput(const Input key, const bool pressed)
+{
+  if (pressed)
+    input.fetch_or(key, std::memory_order_relaxed);
+  else
+    input.fetch_and(~(uint32_t) key, std::memory_order_relaxed);
+}
+
+void Simulation::Run()
+{
+  auto next = std::chrono::steady_clock::now();
+  while (running.load())
+  {
+    Tick(std::chrono::steady_clock::now());
+    next += step;
+
+    // Late ticks run back to back until the schedule is met again. After a long stall (a
+    // debugger, a dragged window) that would only turn into a burst, the schedule restarts.
+    auto now = std::chrono::steady_clock::now();
+    if (now - next > step * max_catch_up_ticks)
+    {
+      dropped_ticks.fetch_add((uint64_t) ((now - next) / step), std::memory_order_relaxed);
+      next = now;
+    }
+    std::this_thread::sleep_until(next);
+  }
+}
+
+void Simulation::Tick(const std::chrono::steady_clock::time_point now)
+{
+  const float dt = (float) (1.0 / rate);
+  const uint32_t keys = input.load(std::memory_order_relaxed);
+  float x = 0.0f;
+  float y = 0.0f;
+  if (keys & RotateUp)
+    x -= turn_rate * dt;
+  if (keys & RotateDown)
+    x += turn_rate * dt;
+  if (keys & RotateLeft)
+    y += turn_rate * dt;
+  if (keys & RotateRight)
+    y -= turn_rate * dt;
+
+  SimulationFrame &frame = frames.Back();
+  frame.previous = state;
+  state.rotation = glm::normalize(state.rotation * glm::angleAxis(x, glm::vec3(1.0f, 0.0f, 0.0f)) * glm::angleAxis(y, glm::vec3(0.0f, 1.0f, 0.0f)));
+  state.tick++;
+  frame.current = state;
+  frame.published = now;
+  frames.Publish();
+}
+
+SimulationState Simulation::Sample(const std::chrono::steady_clock::time_point now)
+{
+  frames.Update();
+  const SimulationFrame &frame = frames.Front();
+
+  // The previous state is shown when a tick is published and the current one a step later,
+  // by which time the next tick has usually replaced both.
+  const double alpha = std::clamp(std::chrono::duration<double>(now - frame.published).count() * rate, 0.0, 1.0);
+  SimulationState result;
+  result.tick = alpha < 0.5 ? frame.previous.tick : frame.current.tick;
+  result.position = glm::mix(frame.previous.position, frame.current.position, (float) alpha);
+  result.rotation = glm::slerp(frame.previous.rotation, frame.current.rotation, (float) alpha);
+  return result;
+}
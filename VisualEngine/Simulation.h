@@ -0,0 +1,80 @@
+#ifndef __VISUALENGINE_SIMULATION_H
+#define __VISUALENGINE_SIMULATION_H
+
+#include "TripleBuffer.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Pose of the simulated object at the end of a tick.
+struct SimulationState
+{
+  uint64_t tick = 0;
+  glm::vec3 position = {0.0f, 0.0f, 0.0f};
+  glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+  glm::mat4 Transform() const;
+};
+
+// What one tick hands to the renderer: the states on both sides of the tick and when it was
+// published, so the render thread interpolates without keeping a history of its own.
+struct SimulationFrame
+{
+  SimulationState previous;
+  SimulationState current;
+  std::chrono::steady_clock::time_point published;
+};
+
+// Input and object motion on a thread of their own, advanced in fixed steps so motion no
+// longer depends on the frame rate and its cost stays out of frame time. Every tick is
+// published through a triple buffer, the render thread samples it without locking.
+class Simulation
+{
+public:
+  enum Input : uint32_t
+  {
+    RotateUp = 1,
+    RotateDown = 2,
+    RotateLeft = 4,
+    RotateRight = 8
+  };
+private:
+  // Falling further behind than this drops the missed ticks instead of catching up on them.
+  static constexpr uint32_t max_catch_up_ticks = 5;
+  // Radians per second while a rotate key is held.
+  static constexpr float turn_rate = 1.0f;
+
+  double rate = 120.0;
+  std::chrono::steady_clock::duration step;
+  std::atomic<uint32_t> input = {0};
+  std::atomic<bool> running = {false};
+  std::atomic<uint64_t> dropped_ticks = {0};
+  std::thread thread;
+  SimulationState state; // simulation thread only, once started
+  TripleBuffer<SimulationFrame> frames;
+
+  void Run();
+  void Tick(const std::chrono::steady_clock::time_point now);
+public:
+  Simulation(const Simulation &obj) = delete;
+  Simulation &operator=(const Simulation &obj) = delete;
+  Simulation(const double rate_hz = 120.0);
+  ~Simulation() { Stop(); }
+
+  void Start();
+  void Stop();
+
+  // Safe from any thread, usually the window's key callback.
+  void SetInput(const Input key, const bool pressed);
+
+  // Render thread only: the state at now, interpolated between the two latest ticks. The
+  // renderer runs one tick behind the simulation, which keeps now between them.
+  SimulationState Sample(const std::chrono::steady_clock::time_point now);
+  double Rate() const { return rate; }
+  uint64_t DroppedTicks() const { return dropped_ticks.load(std::memory_order_relaxed); }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "SwapchainTarget.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+SwapchainTarget::SwapchainTarget(const std::shared_ptr<Vulkan::Device> dev, const std::shared_ptr<Vulkan::Surface> window_surface, const uint32_t images_count,
+                                 const VkPresentModeKHR mode, const VkSampleCountFlagBits samples_count)
+{
+  device = dev;
+  surface = window_surface;
+  requested_images = std::max<uint32_t>(images_count, 1);
+  present_mode = mode;
+  present_mode = ChoosePresentMode();
+  requested_samples = samples_count;
+
+  // There is no previous swapchain, so nothing gets retired.
+  RetireQueue retired;
+  auto size = surface->GetFramebufferSize();
+  if (!Recreate({(uint32_t) size.first, (uint32_t) size.second}, retired, 0))
+    throw std::runtime_error("failed to create swap chain for a zero sized window!");
+}
+
+SwapchainTarget::~SwapchainTarget()
+{
+  targets.reset();
+  for (auto view : views)
+    vkDestroyImageView(device->GetDevice(), view, nullptr);
+  if (swapchain != VK_NULL_HANDLE)
+    vkDestroySwapchainKHR(device->GetDevice(), swapchain, nullptr);
+}
+
+VkSurfaceFormatKHR SwapchainTarget::ChooseSurfaceFormat() const
+{
+  uint32_t count = 0;
+  vkGetPhysicalDeviceSurfaceFormatsKHR(device->GetPhysicalDevice(), surface->GetSurface(), &count, nullptr);
+  std::vector<VkSurfaceFormatKHR> formats(count);
+  vkGetPhysicalDeviceSurfaceFormatsKHR(device->GetPhysicalDevice(), surface->GetSurface(), &count, formats.data());
+
+  const VkSurfaceFormatKHR preferred = {VK_FORMAT_B8G8R8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR};
+  if (formats.empty() || (formats.size() == 1 && formats[0].format == VK_FORMAT_UNDEFINED))
+    return preferred;
+  for (auto &format : formats)
+  {
+    if (format.format == preferred.format && format.colorSpace == preferred.colorSpace)
+      return format;
+  }
+  return formats[0];
+}
+
+VkPresentModeKHR SwapchainTarget::ChoosePresentMode() const
+{
+  uint32_t count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(device->GetPhysicalDevice(), surface->GetSurface(), &count, nullptr);
+  std::vector<VkPresentModeKHR> modes(count);
+  vkGetPhysicalDeviceSurfacePresentModesKHR(device->GetPhysicalDevice(), surface->GetSurface(), &count, modes.data());
+
+  // FIFO is the only mode every implementation has to support.
+  for (auto mode : modes)
+  {
+    if (mode == present_mode)
+      return mode;
+  }
+  return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+void SwapchainTarget::SetPresentMode(const VkPresentModeKHR mode)
+{
+  present_mode = mode;
+  present_mode = ChoosePresentMode();
+}
+
+void SwapchainTarget::SetSamplesCount(const VkSampleCountFlagBits samples_count)
+{
+  samples_changed = samples_changed || samples_count != requested_samples;
+  requested_samples = samples_count;
+}
+
+bool SwapchainTarget::Recreate(const VkExtent2D framebuffer_size, RetireQueue &retired, const uint64_t serial)
+{
+  VkSurfaceCapabilitiesKHR capabilities = {};
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device->GetPhysicalDevice(), surface->GetSurface(), &capabilities);
+
+  VkExtent2D size = capabilities.currentExtent;
+  if (size.width == UINT32_MAX)
+  {
+    size.width = std::clamp(framebuffer_size.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
+    size.height = std::clamp(framebuffer_size.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
+  }
+  if (size.width == 0 || size.height == 0)
+    return false;
+
+  uint32_t images_count = std::max(requested_images, capabilities.minImageCount);
+  if (capabilities.maxImageCount > 0)
+    images_count = std::min(images_count, capabilities.maxImageCount);
+  const VkSurfaceFormatKHR format = ChooseSurfaceFormat();
+
+  // The graphics family of a device created with a surface presents too, so the images stay exclusive.
+  VkSwapchainCreateInfoKHR create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
+  create_info.surface = surface->GetSurface();
+  create_info.minImageCount = images_count;
+  create_info.imageFormat = format.format;
+  create_info.imageColorSpace = format.colorSpace;
+  create_info.imageExtent = size;
+  create_info.imageArrayLayers = 1;
+  create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | (capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+  create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  create_info.preTransform = capabilities.currentTransform;
+  create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+  create_info.presentMode = present_mode;
+  create_info.clipped = VK_TRUE;
+  create_info.oldSwapchain = swapchain;
+
+  VkSwapchainKHR new_swapchain = VK_NULL_HANDLE;
+  if (vkCreateSwapchainKHR(device->GetDevice(), &create_info, nullptr, &new_swapchain) != VK_SUCCESS)
+    throw std::runtime_error("failed to create swap chain!");
+
+  uint32_t count = 0;
+  vkGetSwapchainImagesKHR(device->GetDevice(), new_swapchain, &count, nullptr);
+  std::vector<VkImage> new_images(count);
+  vkGetSwapchainImagesKHR(device->GetDevice(), new_swapchain, &count, new_images.data());
+
+  std::vector<VkImageView> new_views(count, VK_NULL_HANDLE);
+  for (uint32_t i = 0; i < count; ++i)
+  {
+    VkImageViewCreateInfo view_info = {};
+    view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    view_info.image = new_images[i];
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    view_info.format = format.format;
+    view_info.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if (vkCreateImageView(device->GetDevice(), &view_info, nullptr, &new_views[i]) != VK_SUCCESS)
+      throw std::runtime_error("failed to create swap chain image view!");
+  }
+
+  // Only a new format or sample count needs a new render pass, a new size just new framebuffers and attachments.
+  if (!targets || targets->GetColorFormat() != format.format || samples_changed)
+  {
+    samples_changed = false;
+    std::shared_ptr<RenderTargets> old_targets = targets;
+    retired.Retire(serial, [old_targets]() mutable { old_targets.reset(); });
+    targets = std::make_shared<RenderTargets>(device, format.format, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, requested_samples);
+    render_pass_version++;
+  }
+  retired.Retire(serial, targets->Resize(size, new_views));
+
+  // The old swapchain is retired by the create call already, frames still presenting from it
+  // are covered by serial.
+  auto dev = device;
+  VkSwapchainKHR old_swapchain = swapchain;
+  std::vector<VkImageView> old_views = std::move(views);
+  retired.Retire(serial, [dev, old_swapchain, old_views]()
+  {
+    for (auto view : old_views)
+      vkDestroyImageView(dev->GetDevice(), view, nullptr);
+    if (old_swapchain != VK_NULL_HANDLE)
+      vkDestroySwapchainKHR(dev->GetDevice(), old_swapchain, nullptr);
+  });
+
+  swapchain = new_swapchain;
+  images = std::move(new_images);
+  views = std::move(new_views);
+  extent = size;
+  surface_format = format;
+  transfer_dst = (create_info.imageUsage & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+  return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __VISUALENGINE_SWAPCHAINTARGET_H
+#define __VISUALENGINE_SWAPCHAINTARGET_H
+
+#include "../VK-nn/Vulkan/Device.h"
+#include "../VK-nn/Vulkan/Surface.h"
+#include "RenderTargets.h"
+#include "RetireQueue.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+
+// The window's swapchain with the render pass and framebuffers drawing into it.
+// Recreation hands the current swapchain to the driver as oldSwapchain and retires it,
+// its image views and the size dependent attachments into a RetireQueue instead of
+// waiting for the device. The render pass is kept while the surface format and sample count stay the same.
+// Images are created with TRANSFER_DST too when the surface allows it, so they can be blitted to.
+class SwapchainTarget
+{
+private:
+  std::shared_ptr<Vulkan::Device> device;
+  std::shared_ptr<Vulkan::Surface> surface;
+  uint32_t requested_images = 2;
+  VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
+  VkSampleCountFlagBits requested_samples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+  VkSurfaceFormatKHR surface_format = {};
+  VkExtent2D extent = {};
+  std::vector<VkImage> images;
+  std::vector<VkImageView> views;
+  std::shared_ptr<RenderTargets> targets;
+  uint64_t render_pass_version = 0;
+  bool samples_changed = false;
+  bool transfer_dst = false;
+
+  VkSurfaceFormatKHR ChooseSurfaceFormat() const;
+  VkPresentModeKHR ChoosePresentMode() const;
+public:
+  SwapchainTarget() = delete;
+  SwapchainTarget(const SwapchainTarget &obj) = delete;
+  SwapchainTarget &operator=(const SwapchainTarget &obj) = delete;
+  // Unsupported present modes fall back to FIFO, samples_count is lowered to what the device supports.
+  SwapchainTarget(const std::shared_ptr<Vulkan::Device> dev, const std::shared_ptr<Vulkan::Surface> window_surface, const uint32_t images_count,
+                  const VkPresentModeKHR mode, const VkSampleCountFlagBits samples_count);
+  ~SwapchainTarget();
+
+  // Replaces the swapchain for the current surface size, falling back to framebuffer_size when the
+  // surface leaves the size to the swapchain. Everything replaced is retired with serial, the last
+  // frame submitted that may use it. Returns false for a zero sized (minimized) surface.
+  bool Recreate(const VkExtent2D framebuffer_size, RetireQueue &retired, const uint64_t serial);
+
+  // Both take effect with the next Recreate.
+  void SetPresentMode(const VkPresentModeKHR mode);
+  void SetSamplesCount(const VkSampleCountFlagBits samples_count);
+
+  VkSwapchainKHR GetSwapChain() const { return swapchain; }
+  VkImage GetImage(const size_t image_index) const { return images[image_index]; }
+  VkFormat GetFormat() const { return surface_format.format; }
+  bool IsTransferDst() const { return transfer_dst; }
+  VkPresentModeKHR GetPresentMode() const { return present_mode; }
+  VkExtent2D GetExtent() const { return extent; }
+  size_t GetImagesCount() const { return images.size(); }
+  VkRenderPass GetRenderPass() const { return targets->GetRenderPass(); }
+  VkFramebuffer GetFrameBuffer(const size_t image_index) const { return targets->GetFrameBuffer(image_index); }
+  VkSampleCountFlagBits GetSamplesCount() const { return targets->GetSamplesCount(); }
+  // Changes whenever the render pass was replaced, pipelines built against the old one are stale.
+  uint64_t GetRenderPassVersion() const { return render_pass_version; }
+};
+
+#endif
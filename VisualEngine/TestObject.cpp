@@ -1,20 +1,36 @@
 #include "TestObject.h"
 #include "../VK-nn/libs/ImageBuffer.h"
-#include "../VK-nn/Vulkan/CommandPool.h"
-
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "../VK-nn/libs/tiny_obj_loader.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Ktx2.h"
+#include "MipGenerator.h"
 
 #include <vector>
 #include <optional>
-#include <unordered_map>
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 
-TestObject::TestObject(const std::shared_ptr<Vulkan::Device> dev)
+uint64_t ModelConfig::ProcessingKey() const
 {
+  uint64_t key = (optimize_mesh ? 1 : 0) | (optimize_overdraw && optimize_mesh ? 2 : 0);
+  if (lod_levels > 1)
+  {
+    uint32_t reduction = 0;
+    std::memcpy(&reduction, &lod_reduction, sizeof(reduction));
+    key |= (uint64_t) std::min<size_t>(lod_levels, 0xff) << 8 | (uint64_t) reduction << 32;
+  }
+  return key;
+}
+
+TestObject::TestObject(const std::shared_ptr<Vulkan::Device> dev, const std::shared_ptr<UploadManager> upload_manager)
+{
+  uploader = upload_manager;
   data = std::make_unique<Vulkan::StorageArray>(dev);
   texture = std::make_unique<Vulkan::ImageArray>(dev);
   sampler = std::make_unique<Vulkan::Sampler>(dev, Vulkan::SamplerConfig());
-  rotation = glm::mat4(1.0f);
 }
 
 TestObject::~TestObject()
@@ -22,240 +38,313 @@ TestObject::~TestObject()
 
 }
 
-bool TestObject::LoadModel(const std::filesystem::path obj_file, const std::filesystem::path materials_directory)
+bool TestObject::LoadModel(const std::filesystem::path obj_file, const std::filesystem::path materials_directory, const ModelConfig config)
 {
   if (!std::filesystem::exists(obj_file) || !obj_file.has_filename() || obj_file.extension() != ".obj")
   {
     return false;
   }
 
-  std::vector<uint32_t> indices;
-  std::unordered_map<Vertex, uint32_t> vertices;
-  std::vector<Vertex> vertices_buff;
+  MeshData mesh;
+  MeshCache cache;
+  auto cache_file = MeshCache::CachePath(obj_file);
+  const uint64_t processing = config.ProcessingKey();
 
-  if (obj_file.extension() == ".obj")
+  // A cache written with other processing still saves the import, e.g. one from --build-mesh-cache.
+  bool processed = false;
+  if (cache.Open(cache_file, obj_file) && (cache.Processing() == processing || cache.Processing() == 0))
   {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
-
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, obj_file.c_str(), materials_directory.c_str()))
+    cache.CopyTo(mesh);
+    processed = cache.Processing() == processing;
+    cache.Close();
+  }
+  else
+  {
+    cache.Close();
+    if (!ImportObj(obj_file, materials_directory, mesh))
     {
       return false;
     }
+  }
 
-    for (const auto& shape : shapes)
+  if (!processed)
+  {
+    if (config.optimize_mesh)
     {
-      for (const auto& index : shape.mesh.indices)
-      {
-        Vertex vertex = {};
-        vertex.pos =
-        {
-          attrib.vertices[3 * index.vertex_index + 0],
-          attrib.vertices[3 * index.vertex_index + 1],
-          attrib.vertices[3 * index.vertex_index + 2]
-        };
-
-        vertex.normal =
-        {
-          attrib.normals[3 * index.normal_index + 0],
-          attrib.normals[3 * index.normal_index + 1],
-          attrib.normals[3 * index.normal_index + 2],
-        };
-
-        vertex.texCoord =
-        {
-          attrib.texcoords[2 * index.texcoord_index + 0],
-          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-        };
-
-        vertex.color = { 1.0f, 0.0f, 1.0f };
-
-        if (vertices.count(vertex) == 0)
-        {
-          vertices[vertex] = uint32_t(vertices_buff.size());
-          vertices_buff.push_back(vertex);
-        }
-
-        indices.push_back(vertices[vertex]);
-      }
+#ifdef DEBUG
+      auto report = MeshOptimizer::Optimize(mesh, config.optimize_overdraw);
+      std::cout << obj_file.filename().string() << ": " << report << std::endl;
+#else
+      MeshOptimizer::Optimize(mesh, config.optimize_overdraw);
+#endif
+    }
+
+    if (config.lod_levels > 1)
+    {
+      MeshSimplifier::GenerateLods(mesh, config.lod_levels, config.lod_reduction, config.optimize_mesh);
+#ifdef DEBUG
+      for (size_t i = 0; i < mesh.lods.size(); ++i)
+        std::cout << obj_file.filename().string() << ": LOD " << i << " " << mesh.lods[i].index_count / 3 << " triangles, error " << mesh.lods[i].error << std::endl;
+#endif
+    }
+
+    if (!MeshCache::Write(cache_file, obj_file, mesh, processing))
+    {
+#ifdef DEBUG
+      std::cout << __func__ << ": unable to write mesh cache " << cache_file << std::endl;
+#endif
     }
   }
 
-  data->StartConfig(Vulkan::HostVisibleMemory::HostInvisible);
-  data->AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Vertex).AddSubBuffer(vertices_buff));
-  data->AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Index).AddSubBuffer(indices));
-  if (data->EndConfig() != VK_SUCCESS)
+  return UploadMesh(mesh, config.vertex_format);
+}
+
+bool TestObject::UploadMesh(const MeshData &mesh, const VertexFormat format)
+{
+  bounds_min = mesh.bounds_min;
+  bounds_max = mesh.bounds_max;
+  sphere_center = mesh.sphere_center;
+  sphere_radius = mesh.sphere_radius;
+  vertex_format = format;
+  vertex_transform = glm::mat4(1.0f);
+  lods = mesh.lods;
+  if (lods.empty())
   {
-    return false;
+    lods.push_back({0, (uint32_t) mesh.indices.size(), 0.0f});
   }
+  constant_color = true;
 
-  Vulkan::StorageArray src_buffer(data->GetDevice());
-  src_buffer.StartConfig(Vulkan::HostVisibleMemory::HostVisible);
-  src_buffer.AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Storage)
-                      .AddSubBuffer(vertices_buff).AddSubBuffer(indices));
-  if (src_buffer.EndConfig() != VK_SUCCESS || 
-      src_buffer.SetSubBufferData(0, 0, vertices_buff) != VK_SUCCESS ||
-      src_buffer.SetSubBufferData(0, 1, indices))
+  const bool short_indices = mesh.vertices.size() <= 0x10000;
+  index_type = short_indices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  std::vector<uint16_t> indices_16;
+  if (short_indices)
   {
-    return false;
+    indices_16.assign(mesh.indices.begin(), mesh.indices.end());
   }
 
-  auto q_index = texture->GetDevice()->GetGraphicFamilyQueueIndex();
-  if (!q_index.has_value())
+  if (format == VertexFormat::Packed)
+  {
+    PackedMeshData packed;
+    PackMesh(mesh, packed);
+    constant_color = packed.constant_color;
+    vertex_transform = glm::scale(glm::translate(glm::mat4(1.0f), packed.bounds_min), packed.bounds_extent);
+
+    return short_indices ? UploadBuffers(packed.vertices, indices_16, packed.colors) :
+                           UploadBuffers(packed.vertices, mesh.indices, packed.colors);
+  }
+
+  return short_indices ? UploadBuffers(mesh.vertices, indices_16, {}) :
+                         UploadBuffers(mesh.vertices, mesh.indices, {});
+}
+
+template <class V, class I>
+bool TestObject::UploadBuffers(const std::vector<V> &vertices, const std::vector<I> &indices, const std::vector<uint32_t> &colors)
+{
+  data->StartConfig(Vulkan::HostVisibleMemory::HostInvisible);
+  data->AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Vertex).AddSubBuffer(vertices));
+  data->AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Index).AddSubBuffer(indices));
+  if (!colors.empty())
+  {
+    data->AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Vertex).AddSubBuffer(colors));
+  }
+  if (data->EndConfig() != VK_SUCCESS)
   {
     return false;
   }
 
-  VkBufferCopy copy_region = {};
-  Vulkan::CommandPool pool(data->GetDevice(), q_index.value());
-  
-  copy_region.size = src_buffer.GetInfo(0).sub_buffers[0].size;
-  copy_region.srcOffset = src_buffer.GetInfo(0).sub_buffers[0].offset;
-  copy_region.dstOffset = data->GetInfo(0).sub_buffers[0].offset;
-  pool.GetCommandBuffer(0)
-      .BeginCommandBuffer()
-      .CopyBufferToBuffer(src_buffer.GetInfo(0).buffer, data->GetInfo(0).buffer, {copy_region});
-  copy_region.size = src_buffer.GetInfo(0).sub_buffers[1].size;
-  copy_region.srcOffset = src_buffer.GetInfo(0).sub_buffers[1].offset;
-  copy_region.dstOffset = data->GetInfo(1).sub_buffers[0].offset;
-  pool.GetCommandBuffer(0)
-      .CopyBufferToBuffer(src_buffer.GetInfo(0).buffer, data->GetInfo(1).buffer, {copy_region})
-      .EndCommandBuffer();
-
-  if (Vulkan::Fence f(texture->GetDevice()); f.IsValid() && pool.IsReady(0) && pool.ExecuteBuffer(0, f.GetFence()) == VK_SUCCESS)
+  model_upload_value = std::max(model_upload_value, uploader->UploadBuffer(data->GetInfo(0).buffer, data->GetInfo(0).sub_buffers[0].offset, vertices));
+  model_upload_value = std::max(model_upload_value, uploader->UploadBuffer(data->GetInfo(1).buffer, data->GetInfo(1).sub_buffers[0].offset, indices));
+  if (!colors.empty())
   {
-    f.Wait();
-    return true;
+    model_upload_value = std::max(model_upload_value, uploader->UploadBuffer(data->GetInfo(2).buffer, data->GetInfo(2).sub_buffers[0].offset, colors));
   }
 
-  return false;
+  return true;
+}
+
+std::vector<VkBuffer> TestObject::GetVertexBuffers() const
+{
+  if (vertex_format == VertexFormat::Packed)
+    return { data->GetInfo(0).buffer, data->GetInfo(2).buffer };
+
+  return { data->GetInfo(0).buffer };
+}
+
+std::vector<VkDeviceSize> TestObject::GetVertexBuffersOffsets() const
+{
+  if (vertex_format == VertexFormat::Packed)
+    return { data->GetInfo(0).sub_buffers[0].offset, data->GetInfo(2).sub_buffers[0].offset };
+
+  return { data->GetInfo(0).sub_buffers[0].offset };
 }
 
-bool TestObject::LoadTexture(const std::filesystem::path image_file, const bool enable_mip_levels)
+bool TestObject::LoadTexture(const std::filesystem::path image_file, const bool enable_mip_levels, const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded,
+                             const TextureConfig config)
 {
   if (!std::filesystem::exists(image_file) || !image_file.has_filename())
   {
     return false;
   }
 
+  if (image_file.extension() == ".ktx2")
+  {
+    return LoadCompressedTexture(image_file, enable_mip_levels, on_mip_uploaded);
+  }
+
   ImageBuffer image(image_file.string());
-  size_t tex_w = enable_mip_levels ? ((size_t) image.Width() * 2) / 3 : (size_t) image.Width();
-  size_t tex_h = (size_t) image.Height();
+  const uint32_t tex_w = (uint32_t) image.Width();
+  const uint32_t tex_h = (uint32_t) image.Height();
+  const uint32_t channels = (uint32_t) image.Channels();
+  const VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
 
-  texture->StartConfig();
-  texture->AddImage(Vulkan::ImageConfig()
-                    .PreallocateMipLevels(enable_mip_levels)
-                    .SetSize(tex_h, tex_w, image.Channels())
-                    .SetMemoryAccess(Vulkan::HostVisibleMemory::HostInvisible)
-                    .SetSamplesCount(VK_SAMPLE_COUNT_1_BIT)
-                    .SetTiling(Vulkan::ImageTiling::Optimal)
-                    .SetType(Vulkan::ImageType::Sampled)
-                    .SetFormat(VK_FORMAT_R8G8B8A8_SRGB));
-  if (texture->EndConfig() != VK_SUCCESS)
+  if (!CreateTexture(tex_w, tex_h, channels, format, enable_mip_levels))
   {
     return false;
   }
 
-  sampler = std::make_unique<Vulkan::Sampler>(sampler->GetDevice(), Vulkan::SamplerConfig().SetLODMax(texture->GetInfo(0).image_info.mipLevels));
-  Vulkan::StorageArray src_buffer(data->GetDevice());
-
+  std::vector<uint8_t> raw_data = image.Canvas();
+  const uint32_t mip_levels = texture->GetInfo(0).image_info.mipLevels;
+  if (mip_levels > 1 && config.gpu_mips && uploader->CanBlit(format))
   {
-    std::vector<uint8_t> raw_data = enable_mip_levels ? image.GetMipLevelsBuffer() : image.Canvas();
-    src_buffer.StartConfig();
-    src_buffer.AddBuffer(Vulkan::BufferConfig().SetType(Vulkan::StorageType::Storage)
-      .AddSubBuffer(raw_data.size(), sizeof(decltype(raw_data)::value_type)));
-    if (src_buffer.EndConfig() != VK_SUCCESS)
-    {
-      return false;
-    }
+    // One batch fills the whole chain, so every level becomes resident at once.
+    uploader->UploadImageAndBlitMips(texture->GetInfo(0).image, tex_w, tex_h, mip_levels, raw_data.data(), raw_data.size());
+    uint64_t value = uploader->Flush();
+    if (on_mip_uploaded)
+      on_mip_uploaded(0, value);
+    return true;
+  }
 
-    if (src_buffer.SetBufferData(0, raw_data) != VK_SUCCESS)
+  MipGenerator::MipChain chain;
+  if (mip_levels > 1)
+  {
+    chain = MipGenerator::Generate(raw_data.data(), tex_w, tex_h, channels, config.mip_filter, true);
+    if (chain.LevelsCount() < mip_levels)
     {
       return false;
     }
   }
 
-  std::vector<VkBufferImageCopy> image_regions(texture->GetInfo(0).image_info.mipLevels);
-  uint32_t buffer_offset = 0;
-  for (size_t i = 0; i < image_regions.size(); ++i)
+  std::vector<VkBufferImageCopy> image_regions(mip_levels);
+  std::vector<const uint8_t*> levels_data(mip_levels);
+  std::vector<VkDeviceSize> levels_size(mip_levels);
+  for (uint32_t i = 0; i < mip_levels; ++i)
   {
-    image_regions[i].bufferOffset = buffer_offset;
-    image_regions[i].bufferRowLength = (uint32_t)tex_w;
-    image_regions[i].bufferImageHeight = (uint32_t)tex_h;
+    image_regions[i] = MipRegion(i, std::max(tex_w >> i, 1u), std::max(tex_h >> i, 1u));
+    levels_data[i] = mip_levels > 1 ? chain.Level(i) : raw_data.data();
+    levels_size[i] = mip_levels > 1 ? chain.LevelSize(i) : raw_data.size();
+  }
 
-    image_regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    image_regions[i].imageSubresource.mipLevel = i;
-    image_regions[i].imageSubresource.baseArrayLayer = 0;
-    image_regions[i].imageSubresource.layerCount = 1;
+  UploadTextureLevels(levels_data, levels_size, image_regions, 1, on_mip_uploaded);
+  return true;
+}
 
-    image_regions[i].imageOffset = { 0, 0, 0 };
-    image_regions[i].imageExtent =
-    {
-      (uint32_t)tex_w,
-      (uint32_t)tex_h,
-      1
-    };
-
-    buffer_offset += tex_w * tex_h * image.Channels();
-    if (tex_w > 1) tex_w /= 2;
-    if (tex_h > 1) tex_h /= 2;
+bool TestObject::LoadCompressedTexture(const std::filesystem::path ktx2_file, const bool enable_mip_levels, const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded)
+{
+  Ktx2Texture ktx;
+  if (!ktx.Load(ktx2_file))
+  {
+    return false;
   }
 
-  auto q_index = texture->GetDevice()->GetGraphicFamilyQueueIndex();
-  if (!q_index.has_value())
+  // The blocks are copied as they are, the channels only size the image for the allocator.
+  if (!CreateTexture(ktx.width, ktx.height, 4, ktx.format, enable_mip_levels && ktx.levels.size() > 1))
   {
     return false;
   }
 
-  Vulkan::CommandPool pool(texture->GetDevice(), q_index.value());
-
-  pool.GetCommandBuffer(0)
-      .BeginCommandBuffer()
-      .ImageLayoutTransition(*texture, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, true)
-      .CopyBufferToImage(src_buffer.GetInfo(0).buffer, *texture, 0, image_regions)
-      .ImageLayoutTransition(*texture, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 0, true)
-      .EndCommandBuffer();
+  const uint32_t mip_levels = texture->GetInfo(0).image_info.mipLevels;
+  if (ktx.levels.size() < mip_levels)
+  {
+    return false;
+  }
 
-  if (Vulkan::Fence f(texture->GetDevice()); f.IsValid() && pool.IsReady(0) && pool.ExecuteBuffer(0, f.GetFence()) == VK_SUCCESS)
+  std::vector<VkBufferImageCopy> image_regions(mip_levels);
+  std::vector<const uint8_t*> levels_data(mip_levels);
+  std::vector<VkDeviceSize> levels_size(mip_levels);
+  for (uint32_t i = 0; i < mip_levels; ++i)
   {
-    f.Wait();
-    return true;
+    image_regions[i] = MipRegion(i, std::max<uint32_t>(ktx.width >> i, 1), std::max<uint32_t>(ktx.height >> i, 1));
+    image_regions[i].bufferRowLength = 0;
+    image_regions[i].bufferImageHeight = 0;
+    levels_data[i] = ktx.levels[i].data();
+    levels_size[i] = ktx.levels[i].size();
   }
 
-  return false;
+  // BCn blocks cover 4 rows of texels.
+  UploadTextureLevels(levels_data, levels_size, image_regions, 4, on_mip_uploaded);
+  return true;
 }
 
-glm::mat4 TestObject::ObjectTransforations()
+bool TestObject::CreateTexture(const size_t width, const size_t height, const size_t channels, const VkFormat format, const bool enable_mip_levels)
 {
-  glm::mat4 result = glm::mat4(1.0f);
-  result = glm::translate(glm::mat4(1.0f), position);
-  //result = glm::rotate(result, glm::orientedAngle(glm::normalize(direction), glm::vec3(0.0f, 0.0f, -1.0f), up_axis), up_axis);
-  return result * rotation;
-}
+  texture->StartConfig();
+  texture->AddImage(Vulkan::ImageConfig()
+                    .PreallocateMipLevels(enable_mip_levels)
+                    .SetSize(height, width, channels)
+                    .SetMemoryAccess(Vulkan::HostVisibleMemory::HostInvisible)
+                    .SetSamplesCount(VK_SAMPLE_COUNT_1_BIT)
+                    .SetTiling(Vulkan::ImageTiling::Optimal)
+                    .SetType(Vulkan::ImageType::Sampled)
+                    .SetFormat(format));
+  if (texture->EndConfig() != VK_SUCCESS)
+  {
+    return false;
+  }
 
-void TestObject::SetPosition(const glm::vec3 pos)
-{
-  position = pos;
+  sampler = std::make_unique<Vulkan::Sampler>(sampler->GetDevice(), Vulkan::SamplerConfig().SetLODMax(texture->GetInfo(0).image_info.mipLevels));
+  return true;
 }
 
-void TestObject::SetDirection(const glm::vec3 dir)
+VkBufferImageCopy TestObject::MipRegion(const uint32_t mip, const uint32_t width, const uint32_t height)
 {
-  direction = dir;
+  VkBufferImageCopy region = {};
+  region.bufferOffset = 0;
+  region.bufferRowLength = width;
+  region.bufferImageHeight = height;
+
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = mip;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+
+  region.imageOffset = { 0, 0, 0 };
+  region.imageExtent = { width, height, 1 };
+  return region;
 }
 
-void TestObject::Move(const glm::vec3 pos_offset)
+void TestObject::UploadTextureLevels(const std::vector<const uint8_t*> &levels_data, const std::vector<VkDeviceSize> &levels_size,
+                                     const std::vector<VkBufferImageCopy> &image_regions, const uint32_t block_height,
+                                     const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded)
 {
-  position += pos_offset;
+  // Smallest level first, each level in its own batch so it is usable as soon as it lands.
+  // Levels that have not arrived yet are only kept in a valid layout for the descriptor.
+  const uint32_t mip_levels = (uint32_t) image_regions.size();
+  uploader->TransitionImage(texture->GetInfo(0).image, {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1},
+                            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  for (uint32_t mip = mip_levels; mip-- > 0;)
+  {
+    uploader->UploadImage(texture->GetInfo(0).image, mip, 1, levels_data[mip], levels_size[mip], {image_regions[mip]}, block_height);
+    uint64_t value = uploader->Flush();
+    if (on_mip_uploaded)
+      on_mip_uploaded(mip, value);
+  }
 }
 
-void TestObject::Rotate(const float x_angle, const float y_angle, const float z_angle)
+size_t TestObject::SelectLod(const glm::mat4 &model, const glm::vec3 &eye, const float projection_scale, const float pixel_error) const
 {
-  rotation = glm::rotate(rotation, x_angle, {1.0f, 0.0f, 0.0f});
-  rotation = glm::rotate(rotation, y_angle, {0.0f, 1.0f, 0.0f});
-  rotation = glm::rotate(rotation, z_angle, {0.0f, 0.0f, 1.0f});
-  // direction = glm::rotateX(direction, glm::radians(x_angle));
-  // direction = glm::rotateY(direction, glm::radians(y_angle));
-  // direction = glm::rotateZ(direction, glm::radians(z_angle));
-}
\ No newline at end of file
+  glm::vec3 center = glm::vec3(model * glm::vec4(sphere_center, 1.0f));
+  float distance = std::max(glm::length(center - eye) - sphere_radius, 0.1f);
+
+  // Projected size in pixels of one object space unit at the given distance.
+  float pixels_per_unit = projection_scale / distance;
+
+  size_t result = 0;
+  for (size_t i = 1; i < lods.size(); ++i)
+  {
+    if (lods[i].error * pixels_per_unit > pixel_error)
+      break;
+    result = i;
+  }
+
+  return result;
+}
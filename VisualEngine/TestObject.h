@@ -4,46 +4,117 @@
 #include "../VK-nn/Vulkan/ImageArray.h"
 #include "../VK-nn/Vulkan/StorageArray.h"
 #include "../VK-nn/Vulkan/Sampler.h"
-#include "../VK-nn/Vulkan/Fence.h"
 #include "Vertex.h"
+#include "Mesh.h"
+#include "MipGenerator.h"
+#include "UploadManager.h"
 
 #include <filesystem>
 #include <memory>
+#include <functional>
 #include <glm/glm.hpp>
 #include <glm/gtx/vector_angle.hpp>
 #include <glm/gtx/rotate_vector.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+class ModelConfig
+{
+private:
+  friend class TestObject;
+  VertexFormat vertex_format = VertexFormat::Full;
+  bool optimize_mesh = false;
+  bool optimize_overdraw = false;
+  size_t lod_levels = 1;
+  float lod_reduction = 0.5f;
+public:
+  ModelConfig() = default;
+  ~ModelConfig() = default;
+  ModelConfig &SetVertexFormat(const VertexFormat format) { vertex_format = format; return *this; }
+  ModelConfig &UseMeshOptimization(const bool enable) { optimize_mesh = enable; return *this; }
+  ModelConfig &UseOverdrawOptimization(const bool enable) { optimize_overdraw = enable; return *this; }
+  ModelConfig &SetLodLevels(const size_t levels, const float reduction = 0.5f) { lod_levels = levels; lod_reduction = reduction; return *this; }
+  // Identifies the post-load processing for the mesh cache, 0 when the mesh is used as imported.
+  uint64_t ProcessingKey() const;
+};
+
+class TextureConfig
+{
+private:
+  friend class TestObject;
+  MipGenerator::Filter mip_filter = MipGenerator::Filter::Kaiser;
+  bool gpu_mips = false;
+public:
+  TextureConfig() = default;
+  ~TextureConfig() = default;
+  TextureConfig &SetMipFilter(const MipGenerator::Filter filter) { mip_filter = filter; return *this; }
+  // Blits the chain on the GPU when the format allows it, needs images created with TRANSFER_SRC usage.
+  TextureConfig &UseGpuMipGeneration(const bool enable) { gpu_mips = enable; return *this; }
+};
+
 class TestObject
 {
 private:
   std::unique_ptr<Vulkan::Sampler> sampler;
   std::unique_ptr<Vulkan::ImageArray> texture;
   std::unique_ptr<Vulkan::StorageArray> data;
+  std::shared_ptr<UploadManager> uploader;
+  uint64_t model_upload_value = 0;
+
+  glm::vec3 bounds_min = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 bounds_max = { 0.0f, 0.0f, 0.0f };
+  glm::vec3 sphere_center = { 0.0f, 0.0f, 0.0f };
+  float sphere_radius = 0.0f;
+
+  VertexFormat vertex_format = VertexFormat::Full;
+  VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+  bool constant_color = true;
+  glm::mat4 vertex_transform = glm::mat4(1.0f);
+  std::vector<MeshLod> lods;
 
-  glm::vec3 position = { 0.0f, 0.0f, 0.0f };
-  glm::vec3 up_axis = { 0.0f, 1.0f, 0.0f };
-  glm::vec3 direction = { 0.0f, 0.0f, -1.0f };
-  glm::mat4 rotation;
+  bool UploadMesh(const MeshData &mesh, const VertexFormat format);
+  bool LoadCompressedTexture(const std::filesystem::path ktx2_file, const bool enable_mip_levels,
+                             const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded);
+  bool CreateTexture(const size_t width, const size_t height, const size_t channels, const VkFormat format, const bool enable_mip_levels);
+  void UploadTextureLevels(const std::vector<const uint8_t*> &levels_data, const std::vector<VkDeviceSize> &levels_size,
+                           const std::vector<VkBufferImageCopy> &image_regions, const uint32_t block_height,
+                           const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded);
+  static VkBufferImageCopy MipRegion(const uint32_t mip, const uint32_t width, const uint32_t height);
+  template <class V, class I>
+  bool UploadBuffers(const std::vector<V> &vertices, const std::vector<I> &indices, const std::vector<uint32_t> &colors);
 public:
   TestObject() = delete;
   TestObject(const TestObject &obj) = delete;
   TestObject(TestObject &&obj) = delete;
   TestObject &operator=(const TestObject &obj) = delete;
   TestObject &operator=(TestObject &&obj) = delete;
-  TestObject(const std::shared_ptr<Vulkan::Device> dev);
+  TestObject(const std::shared_ptr<Vulkan::Device> dev, const std::shared_ptr<UploadManager> upload_manager);
   ~TestObject();
-  bool LoadModel(const std::filesystem::path obj_file, const std::filesystem::path materials_directory = "");
-  bool LoadTexture(const std::filesystem::path image_file, const bool enable_mip_levels);
+  bool LoadModel(const std::filesystem::path obj_file, const std::filesystem::path materials_directory = "", const ModelConfig config = ModelConfig());
+  // A .ktx2 file is uploaded as compressed blocks with its own levels, anything else is decoded
+  // through ImageBuffer and gets its mip chain generated as configured.
+  // Mip levels are uploaded smallest first, on_mip_uploaded gets each level with the upload value to wait on.
+  bool LoadTexture(const std::filesystem::path image_file, const bool enable_mip_levels,
+                   const std::function<void(const uint32_t, const uint64_t)> &on_mip_uploaded = {},
+                   const TextureConfig config = TextureConfig());
+  // Uploads are only recorded, wait on this value before the first draw that uses the model.
+  uint64_t GetModelUploadValue() const { return model_upload_value; }
   VkSampler GetSampler() const { return sampler->GetSampler(); }
   Vulkan::image_t GetTextureInfo() const { return texture->GetInfo(0); }
   Vulkan::buffer_t GetModelVerticesInfo() const { return data->GetInfo(0); }
   Vulkan::buffer_t GetModelIndicesInfo() const { return data->GetInfo(1); }
-  glm::mat4 ObjectTransforations();
-  void SetPosition(const glm::vec3 pos);
-  void SetDirection(const glm::vec3 dir);
-  void Move(const glm::vec3 pos_offset);
-  void Rotate(const float x_angle, const float y_angle, const float z_angle);
+  std::vector<VkBuffer> GetVertexBuffers() const;
+  std::vector<VkDeviceSize> GetVertexBuffersOffsets() const;
+  VkIndexType GetIndexType() const { return index_type; }
+  VertexFormat GetVertexFormat() const { return vertex_format; }
+  bool HasConstantColor() const { return constant_color; }
+  glm::mat4 GetVertexTransform() const { return vertex_transform; }
+  const std::vector<MeshLod> &GetLods() const { return lods; }
+  // projection_scale is |proj[1][1]| * viewport_height / 2, the pixels covered by one unit at distance one.
+  size_t SelectLod(const glm::mat4 &model, const glm::vec3 &eye, const float projection_scale, const float pixel_error = 1.0f) const;
+  glm::vec3 GetBoundsMin() const { return bounds_min; }
+  glm::vec3 GetBoundsMax() const { return bounds_max; }
+  glm::vec3 GetSphereCenter() const { return sphere_center; }
+  float GetSphereRadius() const { return sphere_radius; }
 };
 
 #endif
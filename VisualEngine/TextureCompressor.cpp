@@ -0,0 +1,437 @@
+#include "TextureCompressor.h"
+#include "Ktx2.h"
+#include "MipGenerator.h"
+#include "../VK-nn/libs/ImageBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <iostream>
+
+namespace
+{
+  struct Block
+  {
+    uint8_t texels[16][4];
+  };
+
+  void FetchBlock(const uint8_t *rgba, const uint32_t width, const uint32_t height, const uint32_t bx, const uint32_t by, Block &block)
+  {
+    // Edge blocks replicate the last row/column, the decoder ignores texels outside the image.
+    for (uint32_t y = 0; y < 4; ++y)
+    {
+      for (uint32_t x = 0; x < 4; ++x)
+      {
+        const uint32_t sx = std::min(bx * 4 + x, width - 1);
+        const uint32_t sy = std::min(by * 4 + y, height - 1);
+        std::memcpy(block.texels[y * 4 + x], rgba + ((size_t) sy * width + sx) * 4, 4);
+      }
+    }
+  }
+
+  // Endpoints along the principal axis of the given channels, found with a few power iterations.
+  template <size_t N>
+  void PrincipalEndpoints(const Block &block, const size_t first_channel, float out_min[N], float out_max[N])
+  {
+    float mean[N] = {};
+    for (size_t i = 0; i < 16; ++i)
+      for (size_t c = 0; c < N; ++c)
+        mean[c] += block.texels[i][first_channel + c];
+    for (size_t c = 0; c < N; ++c)
+      mean[c] /= 16.0f;
+
+    float cov[N][N] = {};
+    for (size_t i = 0; i < 16; ++i)
+    {
+      float d[N];
+      for (size_t c = 0; c < N; ++c)
+        d[c] = block.texels[i][first_channel + c] - mean[c];
+      for (size_t a = 0; a < N; ++a)
+        for (size_t b = 0; b < N; ++b)
+          cov[a][b] += d[a] * d[b];
+    }
+
+    float axis[N];
+    for (size_t c = 0; c < N; ++c)
+      axis[c] = 1.0f;
+    for (size_t iteration = 0; iteration < 8; ++iteration)
+    {
+      float next[N] = {};
+      for (size_t a = 0; a < N; ++a)
+        for (size_t b = 0; b < N; ++b)
+          next[a] += cov[a][b] * axis[b];
+      float length = 0.0f;
+      for (size_t c = 0; c < N; ++c)
+        length = std::max(length, std::fabs(next[c]));
+      if (length <= 0.0f)
+        break;
+      for (size_t c = 0; c < N; ++c)
+        axis[c] = next[c] / length;
+    }
+
+    float min_t = std::numeric_limits<float>::max();
+    float max_t = -std::numeric_limits<float>::max();
+    float length2 = 0.0f;
+    for (size_t c = 0; c < N; ++c)
+      length2 += axis[c] * axis[c];
+    for (size_t i = 0; i < 16; ++i)
+    {
+      float t = 0.0f;
+      for (size_t c = 0; c < N; ++c)
+        t += (block.texels[i][first_channel + c] - mean[c]) * axis[c];
+      min_t = std::min(min_t, t);
+      max_t = std::max(max_t, t);
+    }
+
+    for (size_t c = 0; c < N; ++c)
+    {
+      const float scale = length2 > 0.0f ? axis[c] / length2 : 0.0f;
+      out_min[c] = std::clamp(mean[c] + min_t * scale, 0.0f, 255.0f);
+      out_max[c] = std::clamp(mean[c] + max_t * scale, 0.0f, 255.0f);
+    }
+  }
+
+  uint16_t To565(const float rgb[3])
+  {
+    const uint32_t r = (uint32_t) std::lround(rgb[0] * 31.0f / 255.0f);
+    const uint32_t g = (uint32_t) std::lround(rgb[1] * 63.0f / 255.0f);
+    const uint32_t b = (uint32_t) std::lround(rgb[2] * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+  }
+
+  void From565(const uint16_t c, int out[3])
+  {
+    const int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+  }
+
+  void EncodeBC1(const Block &block, uint8_t *out)
+  {
+    float lo[3], hi[3];
+    PrincipalEndpoints<3>(block, 0, lo, hi);
+    uint16_t c0 = To565(hi);
+    uint16_t c1 = To565(lo);
+    if (c0 < c1)
+      std::swap(c0, c1);
+
+    uint32_t indices = 0;
+    if (c0 != c1)
+    {
+      // Four color mode (c0 > c1): 0 = c0, 1 = c1, 2 = 2/3 c0 + 1/3 c1, 3 = 1/3 c0 + 2/3 c1.
+      int palette[4][3];
+      From565(c0, palette[0]);
+      From565(c1, palette[1]);
+      for (size_t c = 0; c < 3; ++c)
+      {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+      }
+
+      for (size_t i = 0; i < 16; ++i)
+      {
+        int best = 0;
+        int best_error = std::numeric_limits<int>::max();
+        for (int p = 0; p < 4; ++p)
+        {
+          int error = 0;
+          for (size_t c = 0; c < 3; ++c)
+          {
+            const int d = block.texels[i][c] - palette[p][c];
+            error += d * d;
+          }
+          if (error < best_error)
+          {
+            best_error = error;
+            best = p;
+          }
+        }
+        indices |= (uint32_t) best << (i * 2);
+      }
+    }
+
+    std::memcpy(out, &c0, 2);
+    std::memcpy(out + 2, &c1, 2);
+    std::memcpy(out + 4, &indices, 4);
+  }
+
+  void EncodeBC4(const Block &block, const size_t channel, uint8_t *out)
+  {
+    int a0 = 0, a1 = 255;
+    for (size_t i = 0; i < 16; ++i)
+    {
+      a0 = std::max<int>(a0, block.texels[i][channel]);
+      a1 = std::min<int>(a1, block.texels[i][channel]);
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1)
+    {
+      // Eight value mode (a0 > a1): 0 = a0, 1 = a1, 2..7 interpolate from a0 towards a1.
+      int palette[8] = { a0, a1 };
+      for (int p = 1; p < 7; ++p)
+        palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+      for (size_t i = 0; i < 16; ++i)
+      {
+        int best = 0;
+        int best_error = std::numeric_limits<int>::max();
+        for (int p = 0; p < 8; ++p)
+        {
+          const int error = std::abs(block.texels[i][channel] - palette[p]);
+          if (error < best_error)
+          {
+            best_error = error;
+            best = p;
+          }
+        }
+        indices |= (uint64_t) best << (i * 3);
+      }
+    }
+
+    out[0] = (uint8_t) a0;
+    out[1] = (uint8_t) a1;
+    for (size_t b = 0; b < 6; ++b)
+      out[2 + b] = (uint8_t) (indices >> (b * 8));
+  }
+
+  class BitWriter
+  {
+  private:
+    uint8_t *out;
+    size_t position = 0;
+  public:
+    BitWriter(uint8_t *block) : out(block) { std::memset(out, 0, 16); }
+    void Write(uint32_t value, const size_t bits)
+    {
+      for (size_t i = 0; i < bits; ++i, ++position)
+        out[position / 8] |= (uint8_t) (((value >> i) & 1) << (position % 8));
+    }
+  };
+
+  // Mode 6: one subset, RGBA endpoints of 7 bits plus a shared p-bit each, 4 bit indices.
+  void EncodeBC7(const Block &block, uint8_t *out)
+  {
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    float lo[4], hi[4];
+    PrincipalEndpoints<4>(block, 0, lo, hi);
+
+    int best_endpoints[2][4] = {};
+    int best_pbits[2] = {};
+    uint8_t best_indices[16] = {};
+    int64_t best_error = std::numeric_limits<int64_t>::max();
+
+    for (int pbits = 0; pbits < 4; ++pbits)
+    {
+      const int p[2] = { pbits & 1, pbits >> 1 };
+      int quantized[2][4];
+      int endpoints[2][4];
+      for (size_t c = 0; c < 4; ++c)
+      {
+        quantized[0][c] = std::clamp((int) std::lround((lo[c] - p[0]) / 2.0f), 0, 127);
+        quantized[1][c] = std::clamp((int) std::lround((hi[c] - p[1]) / 2.0f), 0, 127);
+        endpoints[0][c] = (quantized[0][c] << 1) | p[0];
+        endpoints[1][c] = (quantized[1][c] << 1) | p[1];
+      }
+
+      int palette[16][4];
+      for (size_t w = 0; w < 16; ++w)
+        for (size_t c = 0; c < 4; ++c)
+          palette[w][c] = ((64 - weights[w]) * endpoints[0][c] + weights[w] * endpoints[1][c] + 32) >> 6;
+
+      int64_t error = 0;
+      uint8_t indices[16];
+      for (size_t i = 0; i < 16; ++i)
+      {
+        int best = 0;
+        int best_texel_error = std::numeric_limits<int>::max();
+        for (int w = 0; w < 16; ++w)
+        {
+          int texel_error = 0;
+          for (size_t c = 0; c < 4; ++c)
+          {
+            const int d = block.texels[i][c] - palette[w][c];
+            texel_error += d * d;
+          }
+          if (texel_error < best_texel_error)
+          {
+            best_texel_error = texel_error;
+            best = w;
+          }
+        }
+        indices[i] = (uint8_t) best;
+        error += best_texel_error;
+      }
+
+      if (error < best_error)
+      {
+        best_error = error;
+        std::memcpy(best_endpoints, quantized, sizeof(quantized));
+        best_pbits[0] = p[0];
+        best_pbits[1] = p[1];
+        std::memcpy(best_indices, indices, sizeof(indices));
+      }
+    }
+
+    // The anchor index is stored without its top bit, swap the endpoints to make it zero.
+    if (best_indices[0] & 8)
+    {
+      for (size_t c = 0; c < 4; ++c)
+        std::swap(best_endpoints[0][c], best_endpoints[1][c]);
+      std::swap(best_pbits[0], best_pbits[1]);
+      for (size_t i = 0; i < 16; ++i)
+        best_indices[i] = (uint8_t) (15 - best_indices[i]);
+    }
+
+    BitWriter writer(out);
+    writer.Write(1 << 6, 7);
+    for (size_t c = 0; c < 4; ++c)
+    {
+      writer.Write((uint32_t) best_endpoints[0][c], 7);
+      writer.Write((uint32_t) best_endpoints[1][c], 7);
+    }
+    writer.Write((uint32_t) best_pbits[0], 1);
+    writer.Write((uint32_t) best_pbits[1], 1);
+    writer.Write(best_indices[0], 3);
+    for (size_t i = 1; i < 16; ++i)
+      writer.Write(best_indices[i], 4);
+  }
+}
+
+bool TextureCompressor::ParseFormat(const std::string &name, Format &out_format)
+{
+  if (name == "bc1") out_format = Format::BC1;
+  else if (name == "bc3") out_format = Format::BC3;
+  else if (name == "bc5") out_format = Format::BC5;
+  else if (name == "bc7") out_format = Format::BC7;
+  else return false;
+  return true;
+}
+
+VkFormat TextureCompressor::VulkanFormat(const Format format, const bool srgb)
+{
+  switch (format)
+  {
+    case Format::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    case Format::BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case Format::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+    case Format::BC7: return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+size_t TextureCompressor::BlockSize(const Format format)
+{
+  return format == Format::BC1 ? 8 : 16;
+}
+
+std::vector<uint8_t> TextureCompressor::Compress(const uint8_t *rgba, const uint32_t width, const uint32_t height, const Format format)
+{
+  const uint32_t blocks_x = (width + 3) / 4;
+  const uint32_t blocks_y = (height + 3) / 4;
+  const size_t block_size = BlockSize(format);
+  std::vector<uint8_t> result((size_t) blocks_x * blocks_y * block_size);
+
+  #pragma omp parallel for schedule(dynamic, 4)
+  for (int64_t by = 0; by < (int64_t) blocks_y; ++by)
+  {
+    Block block;
+    for (uint32_t bx = 0; bx < blocks_x; ++bx)
+    {
+      FetchBlock(rgba, width, height, bx, (uint32_t) by, block);
+      uint8_t *out = result.data() + ((size_t) by * blocks_x + bx) * block_size;
+      switch (format)
+      {
+        case Format::BC1:
+          EncodeBC1(block, out);
+          break;
+        case Format::BC3:
+          EncodeBC4(block, 3, out);
+          EncodeBC1(block, out + 8);
+          break;
+        case Format::BC5:
+          EncodeBC4(block, 0, out);
+          EncodeBC4(block, 1, out + 8);
+          break;
+        case Format::BC7:
+          EncodeBC7(block, out);
+          break;
+      }
+    }
+  }
+
+  return result;
+}
+
+bool TextureCompressor::CompressFile(const std::filesystem::path image_file, const std::filesystem::path ktx2_file, const Format format,
+                                     const bool generate_mips, const bool srgb)
+{
+  if (!std::filesystem::exists(image_file))
+  {
+    return false;
+  }
+
+  ImageBuffer image(image_file.string());
+  const uint32_t channels = (uint32_t) image.Channels();
+  const uint32_t width = (uint32_t) image.Width();
+  const uint32_t height = (uint32_t) image.Height();
+  std::vector<uint8_t> pixels = image.Canvas();
+  if (width == 0 || height == 0 || channels == 0 || channels > 4)
+  {
+    return false;
+  }
+
+  // BC5 holds normal map components, those are filtered as plain values.
+  MipGenerator::MipChain chain;
+  if (generate_mips)
+  {
+    chain = MipGenerator::Generate(pixels.data(), width, height, channels, MipGenerator::Filter::Kaiser, srgb && format != Format::BC5);
+  }
+  else
+  {
+    chain.width = width;
+    chain.height = height;
+    chain.channels = channels;
+    chain.offsets = { 0 };
+    chain.data = std::move(pixels);
+  }
+
+  Ktx2Texture texture;
+  texture.format = VulkanFormat(format, srgb);
+  texture.width = width;
+  texture.height = height;
+
+  std::vector<uint8_t> rgba;
+  size_t offset = 0;
+  for (uint32_t level = 0; level < chain.LevelsCount(); ++level)
+  {
+    const uint32_t level_w = chain.Width(level);
+    const uint32_t level_h = chain.Height(level);
+    rgba.resize((size_t) level_w * level_h * 4);
+    for (size_t i = 0; i < (size_t) level_w * level_h; ++i)
+    {
+      const uint8_t *src = chain.Level(level) + i * channels;
+      uint8_t *dst = rgba.data() + i * 4;
+      dst[0] = src[0];
+      dst[1] = channels > 1 ? src[1] : src[0];
+      dst[2] = channels > 2 ? src[2] : src[0];
+      dst[3] = channels > 3 ? src[3] : 255;
+    }
+
+    texture.levels.push_back(Compress(rgba.data(), level_w, level_h, format));
+    offset += chain.LevelSize(level);
+  }
+
+#ifdef DEBUG
+  size_t compressed = 0;
+  for (auto &level : texture.levels)
+    compressed += level.size();
+  std::cout << image_file.filename().string() << ": " << texture.levels.size() << " levels, "
+            << offset << " -> " << compressed << " bytes" << std::endl;
+#endif
+
+  return texture.Save(ktx2_file);
+}
@@ -0,0 +1,33 @@
+#ifndef __VISUALENGINE_TEXTURECOMPRESSOR_H
+#define __VISUALENGINE_TEXTURECOMPRESSOR_H
+
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+// Offline BCn encoders. Input is tightly packed RGBA8, output is the block stream
+// of one mip level in the layout Vulkan expects for the matching VK_FORMAT_BC*.
+namespace TextureCompressor
+{
+  enum class Format
+  {
+    BC1, // RGB, 4 bpp
+    BC3, // RGBA, 8 bpp
+    BC5, // two channels (RG of normal maps), 8 bpp
+    BC7  // RGBA, 8 bpp, mode 6 only
+  };
+
+  bool ParseFormat(const std::string &name, Format &out_format);
+  VkFormat VulkanFormat(const Format format, const bool srgb);
+  size_t BlockSize(const Format format);
+
+  std::vector<uint8_t> Compress(const uint8_t *rgba, const uint32_t width, const uint32_t height, const Format format);
+
+  // Encodes an image into a KTX2 file, with generate_mips the full chain is built by MipGenerator first.
+  bool CompressFile(const std::filesystem::path image_file, const std::filesystem::path ktx2_file, const Format format,
+                    const bool generate_mips, const bool srgb = true);
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __VISUALENGINE_TRIPLEBUFFER_H
+#define __VISUALENGINE_TRIPLEBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the latest value from one writer thread to one reader thread.
+// The writer fills its back slot and swaps it with the shared middle slot, the reader swaps
+// the middle slot with its front slot when something new was published. Neither side ever
+// waits for the other, the reader just keeps the last value while nothing new arrives.
+template <class T>
+class TripleBuffer
+{
+private:
+  static constexpr uint8_t index_mask = 0x3;
+  static constexpr uint8_t fresh_bit = 0x4;
+
+  T slots[3] = {};
+  // Index of the middle slot, fresh_bit set while the reader has not taken it.
+  std::atomic<uint8_t> middle = {0};
+  uint8_t back = 1;  // writer only
+  uint8_t front = 2; // reader only
+public:
+  TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer &obj) = delete;
+  TripleBuffer &operator=(const TripleBuffer &obj) = delete;
+
+  // Starts both sides from value, before the threads share the buffer.
+  void Reset(const T &value)
+  {
+    for (auto &slot : slots)
+      slot = value;
+    back = 1;
+    front = 2;
+    middle.store(0, std::memory_order_release);
+  }
+
+  // Writer side: fill Back(), then Publish() it.
+  T &Back() { return slots[back]; }
+  void Publish()
+  {
+    back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+  }
+
+  // Reader side: takes the latest published value, returns false when there was none since the last call.
+  bool Update()
+  {
+    if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0)
+      return false;
+    front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+  const T &Front() const { return slots[front]; }
+};
+
+#endif
@@ -0,0 +1,541 @@
+#include "UploadManager.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+  const VkPipelineStageFlags buffer_consumer_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT |
+                                                      VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  const VkAccessFlags buffer_consumer_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                               VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  const VkPipelineStageFlags image_consumer_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+  VkCommandPool CreateCommandPool(const VkDevice device, const uint32_t family)
+  {
+    VkCommandPoolCreateInfo pool_info = {};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    pool_info.queueFamilyIndex = family;
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    if (vkCreateCommandPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS)
+      throw std::runtime_error("failed to create upload command pool!");
+    return pool;
+  }
+
+  VkCommandBuffer AllocateCommandBuffer(const VkDevice device, const VkCommandPool pool)
+  {
+    VkCommandBufferAllocateInfo alloc_info = {};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(device, &alloc_info, &command_buffer) != VK_SUCCESS)
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    return command_buffer;
+  }
+
+  void BeginOneTimeCommandBuffer(const VkCommandBuffer command_buffer)
+  {
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkResetCommandBuffer(command_buffer, 0);
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS)
+      throw std::runtime_error("failed to begin upload command buffer!");
+  }
+}
+
+UploadManager::UploadManager(const std::shared_ptr<Vulkan::Device> dev, const uint32_t transfer_queue_family, const uint32_t graphics_queue_family,
+                             const VkDeviceSize staging_size, const size_t max_batches)
+{
+  device = dev;
+  transfer_family = transfer_queue_family;
+  graphics_family = graphics_queue_family;
+  vkGetDeviceQueue(device->GetDevice(), transfer_family, 0, &transfer_queue);
+  vkGetDeviceQueue(device->GetDevice(), graphics_family, 0, &graphics_queue);
+
+  uint32_t families_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device->GetPhysicalDevice(), &families_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(families_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(device->GetPhysicalDevice(), &families_count, families.data());
+  transfer_graphics = transfer_family < families_count && (families[transfer_family].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+  staging_alignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+  staging = std::make_unique<GpuBuffer>(device, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+  transfer_pool = CreateCommandPool(device->GetDevice(), transfer_family);
+  if (OwnershipTransfer())
+    acquire_pool = CreateCommandPool(device->GetDevice(), graphics_family);
+
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  batches.resize(std::max<size_t>(max_batches, 1));
+  for (auto &batch : batches)
+  {
+    batch.transfer = AllocateCommandBuffer(device->GetDevice(), transfer_pool);
+    if (vkCreateFence(device->GetDevice(), &fence_info, nullptr, &batch.fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to create upload fence!");
+
+    if (OwnershipTransfer())
+    {
+      batch.acquire = AllocateCommandBuffer(device->GetDevice(), acquire_pool);
+      if (vkCreateSemaphore(device->GetDevice(), &semaphore_info, nullptr, &batch.released) != VK_SUCCESS)
+        throw std::runtime_error("failed to create upload semaphore!");
+    }
+  }
+}
+
+UploadManager::~UploadManager()
+{
+  if (recording || !in_flight.empty())
+    WaitIdle();
+
+  for (auto &batch : batches)
+  {
+    if (batch.fence != VK_NULL_HANDLE)
+      vkDestroyFence(device->GetDevice(), batch.fence, nullptr);
+    if (batch.released != VK_NULL_HANDLE)
+      vkDestroySemaphore(device->GetDevice(), batch.released, nullptr);
+  }
+
+  if (acquire_pool != VK_NULL_HANDLE)
+    vkDestroyCommandPool(device->GetDevice(), acquire_pool, nullptr);
+  if (transfer_pool != VK_NULL_HANDLE)
+    vkDestroyCommandPool(device->GetDevice(), transfer_pool, nullptr);
+}
+
+VkDeviceSize UploadManager::AllocateStaging(const VkDeviceSize size)
+{
+  const VkDeviceSize capacity = staging->Size();
+  if (size > capacity)
+    throw std::runtime_error("upload does not fit into the staging buffer!");
+
+  // [tail, head) is in use, wrapping around the end of the buffer.
+  // head never catches up with tail, so head == tail only when the ring is empty.
+  while (true)
+  {
+    if (in_flight.empty() && !recording)
+    {
+      staging_head = 0;
+      staging_tail = 0;
+    }
+
+    VkDeviceSize offset = (staging_head + staging_alignment - 1) / staging_alignment * staging_alignment;
+    if (staging_head >= staging_tail)
+    {
+      if (offset + size <= capacity)
+      {
+        staging_head = offset + size;
+        return offset;
+      }
+      if (size < staging_tail)
+      {
+        staging_head = size;
+        return 0;
+      }
+    }
+    else if (offset + size < staging_tail)
+    {
+      staging_head = offset + size;
+      return offset;
+    }
+
+    // Out of space: make the GPU give back the oldest range, submitting our own work first if needed.
+    if (!RetireOldest(true))
+    {
+      if (!recording)
+        throw std::runtime_error("upload does not fit into the staging buffer!");
+      SubmitBatch();
+    }
+  }
+}
+
+UploadManager::Batch &UploadManager::OpenBatch()
+{
+  Batch &batch = batches[current];
+  if (recording)
+    return batch;
+
+  while (!in_flight.empty() && (in_flight.size() == batches.size() || in_flight.front() == current))
+    RetireOldest(true);
+
+  vkResetFences(device->GetDevice(), 1, &batch.fence);
+  batch.buffer_barriers.clear();
+  batch.image_barriers.clear();
+  BeginOneTimeCommandBuffer(batch.transfer);
+  recording = true;
+  return batch;
+}
+
+bool UploadManager::RetireOldest(const bool wait)
+{
+  if (in_flight.empty())
+    return false;
+
+  Batch &batch = batches[in_flight.front()];
+  if (wait)
+    vkWaitForFences(device->GetDevice(), 1, &batch.fence, VK_TRUE, UINT64_MAX);
+  else if (vkGetFenceStatus(device->GetDevice(), batch.fence) != VK_SUCCESS)
+    return false;
+
+  completed_value.store(batch.value, std::memory_order_release);
+  staging_tail = batch.staging_end;
+  in_flight.pop_front();
+  return true;
+}
+
+uint64_t UploadManager::UploadBuffer(const VkBuffer buffer, const VkDeviceSize offset, const void *data, const VkDeviceSize size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  // Large buffers go through the ring in chunks, each chunk may land in a different batch.
+  const VkDeviceSize chunk_size = staging->Size() / 2;
+  VkDeviceSize done = 0;
+  while (done < size)
+  {
+    const VkDeviceSize bytes = std::min(chunk_size, size - done);
+    const VkDeviceSize staging_offset = AllocateStaging(bytes);
+    std::memcpy(staging->Data<uint8_t>() + staging_offset, static_cast<const uint8_t*>(data) + done, bytes);
+
+    Batch &batch = OpenBatch();
+    VkBufferCopy region = {};
+    region.srcOffset = staging_offset;
+    region.dstOffset = offset + done;
+    region.size = bytes;
+    vkCmdCopyBuffer(batch.transfer, staging->GetBuffer(), buffer, 1, &region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = buffer_consumer_access;
+    barrier.srcQueueFamilyIndex = OwnershipTransfer() ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = OwnershipTransfer() ? graphics_family : VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = region.dstOffset;
+    barrier.size = bytes;
+    batch.buffer_barriers.push_back(barrier);
+
+    done += bytes;
+  }
+
+  return next_value;
+}
+
+uint64_t UploadManager::UploadImage(const VkImage image, const uint32_t base_mip, const uint32_t mip_count, const void *data, const VkDeviceSize size,
+                                    const std::vector<VkBufferImageCopy> &regions, const uint32_t block_height)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, base_mip, mip_count, 0, 1};
+
+  // Stages data[data_offset, data_offset + bytes) and copies it with regions whose offsets are relative to data.
+  // The transition goes into the first batch, later batches are submitted after it on the same queue.
+  bool transitioned = false;
+  auto stage_copy = [&](const VkDeviceSize data_offset, const VkDeviceSize bytes, std::vector<VkBufferImageCopy> staged_regions)
+  {
+    const VkDeviceSize staging_offset = AllocateStaging(bytes);
+    std::memcpy(staging->Data<uint8_t>() + staging_offset, static_cast<const uint8_t*>(data) + data_offset, bytes);
+
+    Batch &batch = OpenBatch();
+    if (!transitioned)
+    {
+      // The levels are overwritten entirely, so their old contents, layout and owner do not matter.
+      vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                           0, nullptr, 0, nullptr, 1, &barrier);
+      transitioned = true;
+    }
+
+    for (auto &region : staged_regions)
+      region.bufferOffset = region.bufferOffset - data_offset + staging_offset;
+    vkCmdCopyBufferToImage(batch.transfer, staging->GetBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           (uint32_t) staged_regions.size(), staged_regions.data());
+  };
+
+  // Data that does not fit into half of the ring goes through it one region at a time, like UploadBuffer,
+  // regions larger than that in bands of block rows. Each piece may land in a different batch.
+  const VkDeviceSize chunk_size = staging->Size() / 2;
+  if (size <= chunk_size)
+  {
+    stage_copy(0, size, regions);
+  }
+  else
+  {
+    // Regions are tightly packed, each one ends where the next one starts.
+    std::vector<VkBufferImageCopy> sorted(regions);
+    std::sort(sorted.begin(), sorted.end(), [](const VkBufferImageCopy &a, const VkBufferImageCopy &b) { return a.bufferOffset < b.bufferOffset; });
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+      const VkBufferImageCopy &region = sorted[i];
+      const VkDeviceSize region_end = i + 1 < sorted.size() ? sorted[i + 1].bufferOffset : size;
+      const VkDeviceSize bytes = region_end - region.bufferOffset;
+      if (bytes <= chunk_size)
+      {
+        stage_copy(region.bufferOffset, bytes, {region});
+        continue;
+      }
+
+      const uint32_t rows = (region.imageExtent.height + block_height - 1) / block_height;
+      const VkDeviceSize row_bytes = bytes / rows;
+      if (region.imageExtent.depth != 1 || region.imageSubresource.layerCount != 1 || row_bytes > chunk_size)
+        throw std::runtime_error("image region does not fit into the staging buffer!");
+
+      const uint32_t band_rows = (uint32_t) (chunk_size / row_bytes);
+      for (uint32_t row = 0; row < rows; row += band_rows)
+      {
+        const uint32_t count = std::min(band_rows, rows - row);
+        VkBufferImageCopy band = region;
+        band.bufferOffset = region.bufferOffset + row * row_bytes;
+        band.bufferImageHeight = 0;
+        band.imageOffset.y += (int32_t) (row * block_height);
+        band.imageExtent.height = std::min(count * block_height, region.imageExtent.height - row * block_height);
+        stage_copy(band.bufferOffset, count * row_bytes, {band});
+      }
+    }
+  }
+
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = OwnershipTransfer() ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = OwnershipTransfer() ? graphics_family : VK_QUEUE_FAMILY_IGNORED;
+  // The last piece is still recording, the release goes after all copies.
+  OpenBatch().image_barriers.push_back(barrier);
+
+  return next_value;
+}
+
+bool UploadManager::CanBlit(const VkFormat format) const
+{
+  // Blits are graphics commands, a dedicated transfer queue cannot record them.
+  if (!transfer_graphics)
+    return false;
+
+  const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                        VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  VkFormatProperties properties = {};
+  vkGetPhysicalDeviceFormatProperties(device->GetPhysicalDevice(), format, &properties);
+  return (properties.optimalTilingFeatures & required) == required;
+}
+
+uint64_t UploadManager::UploadImageAndBlitMips(const VkImage image, const uint32_t width, const uint32_t height, const uint32_t mip_levels,
+                                               const void *data, const VkDeviceSize size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  const VkDeviceSize staging_offset = AllocateStaging(size);
+  std::memcpy(staging->Data<uint8_t>() + staging_offset, data, size);
+
+  Batch &batch = OpenBatch();
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels, 0, 1};
+  vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barrier);
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = staging_offset;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageExtent = {width, height, 1};
+  vkCmdCopyBufferToImage(batch.transfer, staging->GetBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  // Each level is read once as the source of the next one, then left in TRANSFER_SRC_OPTIMAL.
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+  for (uint32_t mip = 1; mip < mip_levels; ++mip)
+  {
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 1, 0, 1};
+    vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkImageBlit blit = {};
+    blit.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, 1};
+    blit.srcOffsets[1] = {(int32_t) std::max(width >> (mip - 1), 1u), (int32_t) std::max(height >> (mip - 1), 1u), 1};
+    blit.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1};
+    blit.dstOffsets[1] = {(int32_t) std::max(width >> mip, 1u), (int32_t) std::max(height >> mip, 1u), 1};
+    vkCmdBlitImage(batch.transfer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   1, &blit, VK_FILTER_LINEAR);
+  }
+
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  barrier.srcQueueFamilyIndex = OwnershipTransfer() ? transfer_family : VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = OwnershipTransfer() ? graphics_family : VK_QUEUE_FAMILY_IGNORED;
+  if (mip_levels > 1)
+  {
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_levels - 1, 0, 1};
+    batch.image_barriers.push_back(barrier);
+  }
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, mip_levels - 1, 1, 0, 1};
+  batch.image_barriers.push_back(barrier);
+
+  return next_value;
+}
+
+uint64_t UploadManager::TransitionImage(const VkImage image, const VkImageSubresourceRange &range, const VkImageLayout old_layout, const VkImageLayout new_layout)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Batch &batch = OpenBatch();
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = 0;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = range;
+  vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                       0, nullptr, 0, nullptr, 1, &barrier);
+
+  if (OwnershipTransfer())
+  {
+    barrier.oldLayout = new_layout;
+    barrier.srcQueueFamilyIndex = transfer_family;
+    barrier.dstQueueFamilyIndex = graphics_family;
+    batch.image_barriers.push_back(barrier);
+  }
+
+  return next_value;
+}
+
+uint64_t UploadManager::Flush()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return SubmitBatch();
+}
+
+uint64_t UploadManager::SubmitBatch()
+{
+  if (!recording)
+    return next_value - 1;
+
+  Batch &batch = batches[current];
+  if (OwnershipTransfer())
+  {
+    // Release on the transfer queue: destination access is ignored there and
+    // repeated by the matching acquire barrier on the graphics queue.
+    std::vector<VkBufferMemoryBarrier> release_buffers(batch.buffer_barriers);
+    std::vector<VkImageMemoryBarrier> release_images(batch.image_barriers);
+    for (auto &barrier : release_buffers)
+      barrier.dstAccessMask = 0;
+    for (auto &barrier : release_images)
+      barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                         (uint32_t) release_buffers.size(), release_buffers.data(), (uint32_t) release_images.size(), release_images.data());
+
+    for (auto &barrier : batch.buffer_barriers)
+      barrier.srcAccessMask = 0;
+    for (auto &barrier : batch.image_barriers)
+      barrier.srcAccessMask = 0;
+    BeginOneTimeCommandBuffer(batch.acquire);
+    vkCmdPipelineBarrier(batch.acquire, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, buffer_consumer_stages | image_consumer_stages, 0, 0, nullptr,
+                         (uint32_t) batch.buffer_barriers.size(), batch.buffer_barriers.data(), (uint32_t) batch.image_barriers.size(), batch.image_barriers.data());
+    if (vkEndCommandBuffer(batch.acquire) != VK_SUCCESS)
+      throw std::runtime_error("failed to record upload acquire commands!");
+  }
+  else
+  {
+    vkCmdPipelineBarrier(batch.transfer, VK_PIPELINE_STAGE_TRANSFER_BIT, buffer_consumer_stages | image_consumer_stages, 0, 0, nullptr,
+                         (uint32_t) batch.buffer_barriers.size(), batch.buffer_barriers.data(), (uint32_t) batch.image_barriers.size(), batch.image_barriers.data());
+  }
+
+  if (vkEndCommandBuffer(batch.transfer) != VK_SUCCESS)
+    throw std::runtime_error("failed to record upload commands!");
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &batch.transfer;
+  if (OwnershipTransfer())
+  {
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &batch.released;
+  }
+
+  std::lock_guard<std::mutex> queue_lock(queue_mutex);
+  if (vkQueueSubmit(transfer_queue, 1, &submit_info, OwnershipTransfer() ? VK_NULL_HANDLE : batch.fence) != VK_SUCCESS)
+    throw std::runtime_error("failed to submit upload commands!");
+
+  if (OwnershipTransfer())
+  {
+    VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo acquire_info = {};
+    acquire_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    acquire_info.waitSemaphoreCount = 1;
+    acquire_info.pWaitSemaphores = &batch.released;
+    acquire_info.pWaitDstStageMask = &wait_stage;
+    acquire_info.commandBufferCount = 1;
+    acquire_info.pCommandBuffers = &batch.acquire;
+    if (vkQueueSubmit(graphics_queue, 1, &acquire_info, batch.fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to submit upload acquire commands!");
+  }
+
+  batch.value = next_value++;
+  batch.staging_end = staging_head;
+  in_flight.push_back(current);
+  current = (current + 1) % batches.size();
+  recording = false;
+
+  return batch.value;
+}
+
+bool UploadManager::IsComplete(const uint64_t value)
+{
+  if (completed_value.load(std::memory_order_acquire) >= value)
+    return true;
+
+  // Polled by the render thread: a worker holding the lock may be waiting for staging space,
+  // so report "not yet" instead of waiting for it. That worker retires batches itself.
+  std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+  if (!lock.owns_lock())
+    return false;
+  while (completed_value < value && RetireOldest(false));
+  return completed_value >= value;
+}
+
+void UploadManager::Wait(const uint64_t value)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (completed_value >= value)
+    return;
+
+  if (recording && value >= next_value)
+    SubmitBatch();
+
+  while (completed_value < value && RetireOldest(true));
+}
@@ -0,0 +1,104 @@
+#ifndef __VISUALENGINE_UPLOADMANAGER_H
+#define __VISUALENGINE_UPLOADMANAGER_H
+
+#include "GpuBuffer.h"
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+
+// Batches buffer and image uploads through one persistently mapped staging ring.
+// Every upload returns the value of the batch it was recorded into, values grow
+// monotonically and a batch is complete once all smaller values are complete,
+// so users keep only the largest value of their resources and Wait() on first use.
+// When the transfer and graphics families differ, resources are released by the
+// transfer queue and acquired by the graphics queue inside the same batch.
+// All public methods may be called from any thread.
+class UploadManager
+{
+private:
+  struct Batch
+  {
+    VkCommandBuffer transfer = VK_NULL_HANDLE;
+    VkCommandBuffer acquire = VK_NULL_HANDLE;
+    VkSemaphore released = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    uint64_t value = 0;
+    VkDeviceSize staging_end = 0;
+    std::vector<VkBufferMemoryBarrier> buffer_barriers;
+    std::vector<VkImageMemoryBarrier> image_barriers;
+  };
+
+  std::shared_ptr<Vulkan::Device> device;
+  std::unique_ptr<GpuBuffer> staging;
+  VkDeviceSize staging_head = 0;
+  VkDeviceSize staging_tail = 0;
+  VkDeviceSize staging_alignment = 16;
+
+  uint32_t transfer_family = 0;
+  uint32_t graphics_family = 0;
+  bool transfer_graphics = false;
+  VkQueue transfer_queue = VK_NULL_HANDLE;
+  VkQueue graphics_queue = VK_NULL_HANDLE;
+  VkCommandPool transfer_pool = VK_NULL_HANDLE;
+  VkCommandPool acquire_pool = VK_NULL_HANDLE;
+
+  std::mutex mutex;
+  std::mutex queue_mutex;
+  std::vector<Batch> batches;
+  std::deque<size_t> in_flight;
+  size_t current = 0;
+  bool recording = false;
+  uint64_t next_value = 1;
+  // Written under mutex, IsComplete reads it without taking the lock.
+  std::atomic<uint64_t> completed_value = 0;
+
+  bool OwnershipTransfer() const { return transfer_family != graphics_family; }
+  VkDeviceSize AllocateStaging(const VkDeviceSize size);
+  Batch &OpenBatch();
+  bool RetireOldest(const bool wait);
+  uint64_t SubmitBatch();
+public:
+  UploadManager() = delete;
+  UploadManager(const UploadManager &obj) = delete;
+  UploadManager &operator=(const UploadManager &obj) = delete;
+  UploadManager(const std::shared_ptr<Vulkan::Device> dev, const uint32_t transfer_queue_family, const uint32_t graphics_queue_family,
+                const VkDeviceSize staging_size = 64 << 20, const size_t max_batches = 4);
+  ~UploadManager();
+
+  uint64_t UploadBuffer(const VkBuffer buffer, const VkDeviceSize offset, const void *data, const VkDeviceSize size);
+  template <class T>
+  uint64_t UploadBuffer(const VkBuffer buffer, const VkDeviceSize offset, const std::vector<T> &data)
+  {
+    return UploadBuffer(buffer, offset, data.data(), data.size() * sizeof(T));
+  }
+
+  // Replaces the contents of mip levels [base_mip, base_mip + mip_count), region buffer offsets
+  // are relative to data. The levels end up in SHADER_READ_ONLY_OPTIMAL, other levels are untouched.
+  // Data larger than the staging buffer is streamed per region and per band of rows, that needs tightly
+  // packed regions and block_height, the texel rows per block row (4 for BCn).
+  uint64_t UploadImage(const VkImage image, const uint32_t base_mip, const uint32_t mip_count, const void *data, const VkDeviceSize size,
+                       const std::vector<VkBufferImageCopy> &regions, const uint32_t block_height = 1);
+  // Replaces level 0 and fills levels [1, mip_levels) from it with linear blits, all levels end up
+  // in SHADER_READ_ONLY_OPTIMAL. The image needs TRANSFER_SRC usage and CanBlit(format) must hold,
+  // level 0 has to fit into the staging buffer.
+  uint64_t UploadImageAndBlitMips(const VkImage image, const uint32_t width, const uint32_t height, const uint32_t mip_levels,
+                                  const void *data, const VkDeviceSize size);
+  bool CanBlit(const VkFormat format) const;
+  uint64_t TransitionImage(const VkImage image, const VkImageSubresourceRange &range, const VkImageLayout old_layout, const VkImageLayout new_layout);
+
+  // Submits the open batch, returns its value or the last submitted value when nothing is open.
+  uint64_t Flush();
+  bool IsComplete(const uint64_t value);
+  void Wait(const uint64_t value);
+  void WaitIdle() { Wait(Flush()); }
+
+  // VkQueue access must be externally synchronized, other submitters to the
+  // upload queues hold this lock around vkQueueSubmit and vkQueuePresentKHR.
+  std::unique_lock<std::mutex> LockQueues() { return std::unique_lock<std::mutex>(queue_mutex); }
+};
+
+#endif
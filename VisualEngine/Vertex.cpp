@@ -14,3 +14,40 @@ std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDes
 
   return result;
 }
+
+std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> GetPackedVertexDescription(uint32_t binding)
+{
+  std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> result;
+  std::vector<VertexDescription> vertex_descriptions =
+  {
+    {offsetof(PackedVertex, pos), VK_FORMAT_R16G16B16A16_UNORM, 0},
+    {offsetof(PackedVertex, texCoord), VK_FORMAT_R16G16_SFLOAT, 2},
+    {offsetof(PackedVertex, normal), VK_FORMAT_R16G16_SNORM, 3}
+  };
+  GetVertexInputBindingDescription<PackedVertex>(binding, vertex_descriptions, result.first, result.second);
+
+  return result;
+}
+
+std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> GetPackedColorDescription(uint32_t binding, bool constant_color)
+{
+  std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> result;
+  std::vector<VertexDescription> vertex_descriptions =
+  {
+    {0, VK_FORMAT_R8G8B8A8_UNORM, 1}
+  };
+  GetVertexInputBindingDescription<uint32_t>(binding, vertex_descriptions, result.first, result.second);
+  // A zero stride makes every vertex fetch the same color.
+  if (constant_color)
+    result.first.stride = 0;
+
+  return result;
+}
+
+std::vector<VertexBindingDescription> GetVertexDescriptions(VertexFormat format, bool constant_color)
+{
+  if (format == VertexFormat::Packed)
+    return { GetPackedVertexDescription(0), GetPackedColorDescription(1, constant_color) };
+
+  return { GetVertexDescription(0) };
+}
@@ -7,6 +7,8 @@
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <utility>
+#include <cstdint>
 
 struct alignas(16) Vertex
 {
@@ -21,12 +23,30 @@ struct alignas(16) Vertex
   }
 };
 
+enum class VertexFormat
+{
+  Full,   // Vertex, 48 bytes
+  Packed  // PackedVertex + 4 byte color stream, stride 0 when the color is constant
+};
+
+// Positions are quantized into the mesh bounds (see TestObject::GetVertexTransform),
+// normals are octahedral encoded snorm16, texture coordinates are half floats.
+struct PackedVertex
+{
+  uint16_t pos[4];
+  uint32_t normal;
+  uint32_t texCoord;
+};
+
 struct VertexDescription
 {
   uint32_t offset = 0; // offset in bytes of struct member
   VkFormat format = VK_FORMAT_R32G32_SFLOAT; // struct member format
+  int32_t location = -1; // shader location, index in description list if negative
 };
 
+using VertexBindingDescription = std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>>;
+
 template <class T>
 void GetVertexInputBindingDescription(uint32_t binding, std::vector<VertexDescription> vertex_descriptions, VkVertexInputBindingDescription& out_binding_description, std::vector<VkVertexInputAttributeDescription>& out_attribute_descriptions)
 {
@@ -40,13 +60,16 @@ void GetVertexInputBindingDescription(uint32_t binding, std::vector<VertexDescri
   for (size_t i = 0; i < out_attribute_descriptions.size(); ++i)
   {
     out_attribute_descriptions[i].binding = binding;
-    out_attribute_descriptions[i].location = i;
+    out_attribute_descriptions[i].location = vertex_descriptions[i].location < 0 ? i : vertex_descriptions[i].location;
     out_attribute_descriptions[i].format = vertex_descriptions[i].format;
     out_attribute_descriptions[i].offset = vertex_descriptions[i].offset;
   }
 }
 
 std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> GetVertexDescription(uint32_t binding);
+std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> GetPackedVertexDescription(uint32_t binding);
+std::pair<VkVertexInputBindingDescription, std::vector<VkVertexInputAttributeDescription>> GetPackedColorDescription(uint32_t binding, bool constant_color);
+std::vector<VertexBindingDescription> GetVertexDescriptions(VertexFormat format, bool constant_color);
 
 template <class T>
 inline void hash_combine(std::size_t & s, const T & v)
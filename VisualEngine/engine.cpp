@@ -4,6 +4,9 @@
 #include <filesystem>
 #include <optional>
 #include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
 
 VisualEngine::~VisualEngine()
 {
@@ -11,115 +14,241 @@ VisualEngine::~VisualEngine()
       std::cout << __func__ << std::endl;
 #endif
 
-  for (size_t i = 0; i < frames_in_pipeline; ++i)
+  // Loader jobs use the uploader and the objects, stop them first. Stop() joins them while
+  // streamer still points at the object they complete through, reset() nulls it before that.
+  if (streamer)
+    streamer->Stop();
+  streamer.reset();
+
+  if (pipeline_cache && !pipeline_cache->Save())
+    std::cerr << "unable to save the pipeline cache" << std::endl;
+  frame_stats.SetInfo("simulation_dropped_ticks", std::to_string(simulation ? simulation->DroppedTicks() : 0));
+  if (cull_frames > 0)
+  {
+    frame_stats.SetInfo("cull_objects_tested_per_frame", std::to_string(cull_totals.objects_tested / cull_frames));
+    frame_stats.SetInfo("cull_objects_culled_per_frame", std::to_string(cull_totals.objects_culled / cull_frames));
+  }
+  if (resolution)
+  {
+    frame_stats.SetInfo("render_scale", std::to_string(resolution->Scale()));
+    frame_stats.SetInfo("render_samples", std::to_string((uint32_t) resolution->Samples()));
+  }
+  if (pipelines)
+    frame_stats.SetInfo("pipeline_variants", std::to_string(pipelines->Count()));
+  if (allocator)
   {
-    if (!exec_fences.empty() && exec_fences[i] != VK_NULL_HANDLE)
-      vkDestroyFence(device->GetDevice(), exec_fences[i], nullptr);
+    const DeviceAllocator::Stats memory = allocator->GetStats();
+    frame_stats.SetInfo("memory_allocations", std::to_string(memory.allocations));
+    frame_stats.SetInfo("memory_objects", std::to_string(memory.memory_objects));
+    frame_stats.SetInfo("memory_moved_bytes", std::to_string(memory.moved));
+    frame_stats.SetInfo("memory_over_budget", std::to_string(memory.over_budget));
   }
+  if (!profile_output.empty() && !frame_stats.Export(profile_output))
+    std::cerr << "unable to write the profile to " << profile_output << std::endl;
+
+  if (descriptor_pool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device->GetDevice(), descriptor_pool, nullptr);
+  if (descriptor_set_layout != VK_NULL_HANDLE)
+    vkDestroyDescriptorSetLayout(device->GetDevice(), descriptor_set_layout, nullptr);
 }
 
 VisualEngine::VisualEngine(int argc, char const *argv[])
 {
-  settings.Load("test.conf");
+  start_time = std::chrono::steady_clock::now();
+  settings.Load(settings_file);
   PrepareWindow();
   
   exec_directory = Vulkan::Misc::GetExecDirectory(argv[0]);
-  auto vertex_description = GetVertexDescription(0);
 
   if (!std::filesystem::exists(exec_directory))
     throw std::runtime_error("argv[0] is not a valid path.");
 
-  surface = std::make_shared<Vulkan::Surface>(Vulkan::SurfaceConfig().SetAppTitle(Vulkan::Instance::AppName())
-                                              .SetHeight(settings.Height()).SetWidght(settings.Widght()));
-  surface->SetWindowUserPointer(this);
-  surface->SetFramebufferSizeCallback(FrameBufferResizeCallback);
-  surface->SetKeyCallback(KeyboardCallback);
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--headless")
+      headless = true;
+  }
 
   VkPhysicalDeviceFeatures device_features = {};
   device_features.geometryShader = VK_TRUE;
+  device_features.multiDrawIndirect = VK_TRUE;
+  device_features.drawIndirectFirstInstance = VK_TRUE;
+  device_features.pipelineStatisticsQuery = VK_TRUE;
+  device_features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 
-  device = std::make_shared<Vulkan::Device>(Vulkan::DeviceConfig().SetDeviceType(Vulkan::PhysicalDeviceType::Discrete)
-                                            .SetQueueType(Vulkan::QueueType::DrawingType)
-                                            .SetSurface(surface)
-                                            .SetRequiredDeviceFeatures(device_features));
-  
-  descriptors = std::make_shared<Vulkan::Descriptors>(device);
-  command_pool = std::make_shared<Vulkan::CommandPool>(device, device->GetGraphicFamilyQueueIndex().value());
-  swapchain = std::make_shared<Vulkan::SwapChain>(device, Vulkan::SwapChainConfig()
-                                                          .SetImagesCount(2)
-                                                          .SetPresentMode((VkPresentModeKHR) settings.PresentMode()));
-  storage_buffers = std::make_shared<Vulkan::StorageArray>(device);
-  render_pass_bufers = std::make_shared<Vulkan::ImageArray>(device);
-  render_pass = Vulkan::Helpers::CreateOneSubpassRenderPassMultisamplingDepth(device, swapchain, *render_pass_bufers.get(), (VkSampleCountFlagBits) settings.Multisampling());
-
-  frames_in_pipeline = swapchain->GetImagesCount() + 1;
-  storage_buffers->AddBuffer(Vulkan::BufferConfig()
-                            .SetType(Vulkan::StorageType::Uniform)
-                            .AddSubBufferRange(swapchain->GetImagesCount(), 1, sizeof(World)));
-  storage_buffers->EndConfig();
+  if (headless)
+  {
+    // No surface: any device with a graphics queue will do, down to software
+    // implementations such as lavapipe on windowless machines.
+    for (auto type : {Vulkan::PhysicalDeviceType::Discrete, Vulkan::PhysicalDeviceType::Integrated,
+                      Vulkan::PhysicalDeviceType::Virtual, Vulkan::PhysicalDeviceType::CPU})
+    {
+      try
+      {
+        device = std::make_shared<Vulkan::Device>(Vulkan::DeviceConfig().SetDeviceType(type)
+                                                  .SetQueueType(Vulkan::QueueType::DrawingType)
+                                                  .SetRequiredDeviceFeatures(device_features));
+        break;
+      }
+      catch (const std::runtime_error &)
+      {
+        continue;
+      }
+    }
+    if (!device)
+      throw std::runtime_error("failed to find a device for headless rendering!");
+  }
+  else
+  {
+    surface = std::make_shared<Vulkan::Surface>(Vulkan::SurfaceConfig().SetAppTitle(Vulkan::Instance::AppName())
+                                                .SetHeight(settings.Height()).SetWidght(settings.Widght()));
+    surface->SetWindowUserPointer(this);
+    surface->SetFramebufferSizeCallback(FrameBufferResizeCallback);
+    surface->SetKeyCallback(KeyboardCallback);
 
-  image_available_semaphores = std::make_unique<Vulkan::SemaphoreArray>(device);
-  render_finished_semaphores = std::make_unique<Vulkan::SemaphoreArray>(device);
+    device = std::make_shared<Vulkan::Device>(Vulkan::DeviceConfig().SetDeviceType(Vulkan::PhysicalDeviceType::Discrete)
+                                              .SetQueueType(Vulkan::QueueType::DrawingType)
+                                              .SetSurface(surface)
+                                              .SetRequiredDeviceFeatures(device_features));
+  }
+
+  allocator = DeviceAllocator::For(device);
 
-  girl = std::make_unique<TestObject>(device);
-  //girl->LoadModel("Resources/Models/Torus/torus.obj", "Resources/Models/Torus/");
-  girl->LoadModel("Resources/Models/girl/girl.obj", "Resources/Models/girl/");
-  girl->LoadTexture("Resources/Models/girl/girl_mip.png", true);
-
-  Vulkan::DescriptorInfo s_info = {};
-  s_info.type = Vulkan::DescriptorType::ImageSamplerCombined;
-  s_info.image_info.sampler = girl->GetSampler();
-  s_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  s_info.image_info.image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-  s_info.image_info.image_view = girl->GetTextureInfo().image_view;
-  s_info.offset = 0;
-  s_info.size = 0;
-
-  Vulkan::DescriptorInfo d_info = {};
-  d_info.type = d_info.MapStorageType(Vulkan::StorageType::Uniform);
-  d_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-  for (size_t i = 0; i < swapchain->GetImagesCount(); ++i)
-  {
-    d_info.size = storage_buffers->GetInfo(0).sub_buffers[i].size;
-    d_info.offset = storage_buffers->GetInfo(0).sub_buffers[i].offset;
-    d_info.buffer_info.buffer = storage_buffers->GetInfo(0).buffer;
-    descriptors->AddSetLayoutConfig(Vulkan::LayoutConfig()
-                                    .AddBufferOrImage(d_info)
-                                    .AddBufferOrImage(s_info));
-  }
-
-  descriptors->BuildAllSetLayoutConfigs();  
-
-  Vulkan::GraphicPipelineConfig::InputBinding input_binding = {};
-  input_binding.attribute_desc = vertex_description.second;
-  input_binding.binding_desc = vertex_description.first;
-
-  pipelines.AddPipeline(device, swapchain, render_pass, Vulkan::GraphicPipelineConfig()
-                        .UseDepthBias(VK_TRUE)
-                        .UseDepthTesting(VK_TRUE)
-                        .AddShader(Vulkan::ShaderType::Vertex, exec_directory + "tri.vert.spv", "main")
-                        .AddShader(Vulkan::ShaderType::Fragment, exec_directory + "tri.frag.spv", "main")
-                        .AddInputBinding(input_binding)
-                        .SetSamplesCount((VkSampleCountFlagBits) settings.Multisampling())
-                        .AddDescriptorSetLayouts(descriptors->GetDescriptorSetLayouts())
-                        .AddDynamicState(VK_DYNAMIC_STATE_VIEWPORT)
-                        .AddDynamicState(VK_DYNAMIC_STATE_SCISSOR)
-                        .SetFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
-                        .SetCullMode(VK_CULL_MODE_BACK_BIT)
-                        .SetPolygonMode(VK_POLYGON_MODE_FILL)
-                        .SetMinSampleShading(0.5)
-                        .UseSampleShading(VK_TRUE));
-
-  UpdateCommandBuffers();
+  bool cold_pipeline_cache = false;
+  double simulation_rate = 120.0;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--cold-pipeline-cache")
+      cold_pipeline_cache = true;
+    if (std::string(argv[i]) == "--exit-after-first-frame")
+      exit_after_first_frame = true;
+    if (std::string(argv[i]) == "--profile-output" && i + 1 < argc)
+      profile_output = argv[++i];
+    if (std::string(argv[i]) == "--sim-rate" && i + 1 < argc)
+      simulation_rate = std::stod(argv[++i]);
+    if (std::string(argv[i]) == "--gpu-culling")
+      use_gpu_culling = true;
+    if (std::string(argv[i]) == "--frames-in-flight" && i + 1 < argc)
+      settings.FramesInFlight(std::max<size_t>(std::stoul(argv[++i]), 1));
+    if (std::string(argv[i]) == "--low-latency")
+      settings.LowLatency(true);
+  }
+  simulation = std::make_unique<Simulation>(simulation_rate);
+  std::filesystem::path pipeline_cache_file = exec_directory + "pipeline.cache";
+  if (cold_pipeline_cache)
+    std::filesystem::remove(pipeline_cache_file);
+  pipeline_cache = std::make_unique<PipelineCache>(device, pipeline_cache_file);
+
+  vkGetDeviceQueue(device->GetDevice(), device->GetGraphicFamilyQueueIndex().value(), 0, &graphics_queue);
+  if (headless)
+  {
+    // Offscreen images take the swapchain's place, there is no acquire to wait for.
+    offscreen = std::make_unique<OffscreenTarget>(device, device->GetGraphicFamilyQueueIndex().value(),
+                                                  VkExtent2D{(uint32_t) settings.Widght(), (uint32_t) settings.Height()}, 2,
+                                                  (VkSampleCountFlagBits) settings.Multisampling());
+    settings.Multisampling((MSAA_t) offscreen->GetSamplesCount());
+  }
+  else
+  {
+    swapchain = std::make_unique<SwapchainTarget>(device, surface, 2, (VkPresentModeKHR) settings.PresentMode(),
+                                                  (VkSampleCountFlagBits) settings.Multisampling());
+    settings.Multisampling((MSAA_t) swapchain->GetSamplesCount());
+
+    // A missing file is written with the defaults, as a starting point for editing.
+    std::error_code error;
+    if (!std::filesystem::exists(settings_file, error) && !settings.Save(settings_file))
+      std::cerr << "unable to write the settings to " << settings_file << std::endl;
+    settings_time = std::filesystem::last_write_time(settings_file, error);
+  }
+  sample_shading = settings.SampleShading();
+
+  pipeline_statistics = device_features.pipelineStatisticsQuery == VK_TRUE;
   PrepareSyncPrimitives();
+  PrepareImageState();
+  EnableDynamicResolution(settings.DynamicResolution());
+  for (auto &name : gpu_profiler->PassNames())
+    gpu_pass_series.push_back(frame_stats.AddSeries("gpu_" + name));
+  acquire_phase = frame_stats.AddSeries("cpu_acquire");
+  update_phase = frame_stats.AddSeries("cpu_update");
+  cull_phase = frame_stats.AddSeries("cpu_cull");
+  record_phase = frame_stats.AddSeries("cpu_record");
+  submit_phase = frame_stats.AddSeries("cpu_submit");
+  present_phase = frame_stats.AddSeries("cpu_present");
+  latency_series = frame_stats.AddSeries("input_latency");
+
+  VkPhysicalDeviceProperties properties = {};
+  vkGetPhysicalDeviceProperties(device->GetPhysicalDevice(), &properties);
+  frame_stats.SetInfo("device", properties.deviceName);
+  frame_stats.SetInfo("driver_version", std::to_string(properties.driverVersion));
+  frame_stats.SetInfo("build", std::string(__DATE__) + " " + __TIME__);
+  frame_stats.SetInfo("mode", headless ? "headless" : "window");
+  frame_stats.SetInfo("simulation_hz", std::to_string(simulation->Rate()));
+  frame_stats.SetInfo("culling", use_gpu_culling ? "gpu" : "cpu");
+  frame_stats.SetInfo("frames_in_flight", std::to_string(timeline->FramesInFlight()));
+  frame_stats.SetInfo("low_latency", settings.LowLatency() ? "on" : "off");
+  frame_stats.SetInfo("resolution", std::to_string(TargetExtent().width) + "x" + std::to_string(TargetExtent().height));
+
+  // VK-nn creates queues for the graphics family only, so uploads share it and skip ownership transfers.
+  uploader = std::make_shared<UploadManager>(device, device->GetGraphicFamilyQueueIndex().value(), device->GetGraphicFamilyQueueIndex().value());
+  girl = std::make_unique<TestObject>(device, uploader);
+
+  for (int i = 1; i + 1 < argc; ++i)
+  {
+    if (std::string(argv[i]) == "--objects")
+      settings.ObjectsCount(std::stoul(argv[i + 1]));
+  }
+  objects.resize(std::max<size_t>(settings.ObjectsCount(), 1));
+  frame_stats.SetInfo("objects", std::to_string(objects.size()));
+
+  // Assets stream in on worker threads, the object is drawn once its mesh and
+  // the smallest texture level are resident. Callbacks run in UpdateStreaming.
+  streamer = std::make_unique<AssetStreamer>();
+  streamer->Enqueue([this]()
+  {
+    //bool loaded = girl->LoadModel("Resources/Models/Torus/torus.obj", "Resources/Models/Torus/");
+    bool loaded = girl->LoadModel("Resources/Models/girl/girl.obj", "Resources/Models/girl/", ModelConfig()
+                                                                                              .SetVertexFormat(VertexFormat::Packed)
+                                                                                              .UseMeshOptimization(true)
+                                                                                              .UseOverdrawOptimization(true)
+                                                                                              .SetLodLevels(4));
+    uploader->Flush();
+    streamer->Complete([this, loaded]()
+    {
+      if (!loaded)
+        throw std::runtime_error("failed to load model!");
+      model_loaded = true;
+    });
+  });
+  streamer->Enqueue([this]()
+  {
+    auto on_mip_uploaded = [this](const uint32_t mip, const uint64_t value)
+    {
+      streamer->Complete([this, mip, value]() { pending_mips.push_back({mip, value}); });
+    };
+    // Blocks written by --compress-texture are preferred, the PNG gets its mips generated at load.
+    if (!girl->LoadTexture("Resources/Models/girl/girl.ktx2", true, on_mip_uploaded))
+      girl->LoadTexture("Resources/Models/girl/girl.png", true, on_mip_uploaded, TextureConfig().SetMipFilter(MipGenerator::Filter::Kaiser));
+  });
+
+  PrepareFrameRing();
+  PrepareDescriptors();
+  material_table = std::make_unique<MaterialTable>(device);
 }
 
 void VisualEngine::Start()
 {
-  priv_frame_time = std::chrono::high_resolution_clock::now();
-  event_handler_thread = std::thread(&VisualEngine::EventHadler, this);
-  if (event_handler_thread.joinable())
-    event_handler_thread.join();
+  // Nothing to show without a window, headless runs are driven through RenderFrame. Their
+  // simulation never starts, so every run renders the same state.
+  if (headless)
+  {
+    WaitForAssets();
+    return;
+  }
+
+  // Events are polled and frames drawn on this thread, input and motion advance on the simulation's.
+  simulation->Start();
+  EventHadler();
+  simulation->Stop();
 }
 
 void VisualEngine::EventHadler()
@@ -127,8 +256,12 @@ void VisualEngine::EventHadler()
   while (!surface->IsWindowShouldClose()) 
   {
     surface->PollEvents();
+    input_time = std::chrono::steady_clock::now();
     Draw(*this);
+    if (exit_after_first_frame && drawing)
+      break;
   }
+  auto queue_lock = uploader->LockQueues();
   vkDeviceWaitIdle(device->GetDevice());
 }
 
@@ -141,25 +274,22 @@ void VisualEngine::FrameBufferResizeCallback(GLFWwindow* window, int width, int
 void VisualEngine::KeyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
   auto app = reinterpret_cast<VisualEngine*>(glfwGetWindowUserPointer(window));
-  if (key == GLFW_KEY_UP && action == GLFW_PRESS)
-    app->up_key_down = true;
-  if (key == GLFW_KEY_UP && action == GLFW_RELEASE)
-    app->up_key_down = false;
+  if (action != GLFW_PRESS && action != GLFW_RELEASE)
+    return;
 
-  if (key == GLFW_KEY_DOWN && action == GLFW_PRESS)
-    app->down_key_down = true;
-  if (key == GLFW_KEY_DOWN && action == GLFW_RELEASE)
-    app->down_key_down = false;
-
-  if (key == GLFW_KEY_LEFT && action == GLFW_PRESS)
-    app->left_key_down = true;
-  if (key == GLFW_KEY_LEFT && action == GLFW_RELEASE)
-    app->left_key_down = false;
-
-  if (key == GLFW_KEY_RIGHT && action == GLFW_PRESS)
-    app->right_key_down = true;
-  if (key == GLFW_KEY_RIGHT && action == GLFW_RELEASE)
-    app->right_key_down = false;
+  const bool pressed = action == GLFW_PRESS;
+  if (key == GLFW_KEY_UP)
+    app->simulation->SetInput(Simulation::RotateUp, pressed);
+  if (key == GLFW_KEY_DOWN)
+    app->simulation->SetInput(Simulation::RotateDown, pressed);
+  if (key == GLFW_KEY_LEFT)
+    app->simulation->SetInput(Simulation::RotateLeft, pressed);
+  if (key == GLFW_KEY_RIGHT)
+    app->simulation->SetInput(Simulation::RotateRight, pressed);
+  if (key == GLFW_KEY_F7 && pressed)
+    app->allocator->Print(std::cout);
+  if (key == GLFW_KEY_F8 && pressed)
+    app->defragmenting = true;
 }
 
 void VisualEngine::Draw(VisualEngine &obj)
@@ -167,125 +297,909 @@ void VisualEngine::Draw(VisualEngine &obj)
   obj.DrawFrame();
 }
 
-void VisualEngine::UpdateCommandBuffers()
+void VisualEngine::WaitForAssets()
+{
+  // Frames keep being drawn so streaming callbacks are delivered. Results are queued before
+  // a job counts as done, so one more update after the streamer went idle delivers all of them.
+  while (true)
+  {
+    bool idle = streamer->IsIdle();
+    DrawFrame();
+    if (idle && drawing && pending_mips.empty())
+      break;
+  }
+
+  auto queue_lock = uploader->LockQueues();
+  vkQueueWaitIdle(graphics_queue);
+}
+
+void VisualEngine::SetCamera(const glm::vec3 &eye, const glm::vec3 &target)
+{
+  camera_eye = eye;
+  camera_target = target;
+}
+
+bool VisualEngine::ReadFrame(std::vector<uint8_t> &pixels)
+{
+  if (!offscreen)
+    return false;
+
+  auto queue_lock = uploader->LockQueues();
+  offscreen->ReadBack(graphics_queue, last_image, pixels);
+  return true;
+}
+
+void VisualEngine::BuildFrameGraph()
+{
+  // The passes only change with drawing, culling and upscaling, the buffers and images they use
+  // are looked up when recording.
+  const uint32_t key = (drawing ? 1u : 0u) | (drawing && gpu_culling ? 2u : 0u) | (scaled ? 4u : 0u);
+  if (frame_graph && key == frame_graph_key)
+    return;
+
+  std::shared_ptr<RenderGraph> old_graph = std::move(frame_graph);
+  retired.Retire(timeline->Submitted(), [old_graph]() mutable { old_graph.reset(); });
+  frame_graph = std::make_unique<RenderGraph>(device);
+  frame_graph_key = key;
+
+  std::vector<RenderGraph::Use> main_uses;
+  if (drawing && gpu_culling)
+  {
+    const RenderGraph::Resource instances = frame_graph->ImportBuffer("instances");
+    const RenderGraph::Resource draws = frame_graph->ImportBuffer("draws");
+    frame_graph->AddPass("cull", {{instances, RenderGraph::Access::ComputeWrite}, {draws, RenderGraph::Access::ComputeWrite}},
+                         [this](const VkCommandBuffer command_buffer, const size_t image_index)
+                         {
+                           gpu_profiler->BeginPass(command_buffer, image_index, cull_pass);
+                           gpu_culling->Dispatch(command_buffer, image_index, (uint32_t) frame_offsets[image_index].cull);
+                           gpu_profiler->EndPass(command_buffer, image_index, cull_pass);
+                         });
+    main_uses.push_back({instances, RenderGraph::Access::VertexShaderRead});
+    main_uses.push_back({draws, RenderGraph::Access::IndirectRead});
+  }
+
+  // Without upscaling the render pass transitions the target images on its own, multisampled
+  // color and depth stay inside it as lazily allocated attachments of RenderTargets.
+  RenderGraph::Resource scene = 0;
+  RenderGraph::Resource output = 0;
+  if (scaled)
+  {
+    scene = frame_graph->ImportImage("scene", VK_IMAGE_ASPECT_COLOR_BIT, [this](const size_t image_index) { return scaled->GetImage(image_index); });
+    // Acquired images are waited for at the transfer stage, their contents are discarded.
+    output = frame_graph->ImportImage("swapchain", VK_IMAGE_ASPECT_COLOR_BIT, [this](const size_t image_index) { return swapchain->GetImage(image_index); },
+                                      VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    main_uses.push_back({scene, RenderGraph::Access::ColorAttachment, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+  }
+
+  frame_graph->AddPass("main", main_uses, [this](const VkCommandBuffer command_buffer, const size_t image_index)
+                       {
+                         RecordMainPass(command_buffer, image_index);
+                       });
+  if (scaled)
+  {
+    frame_graph->AddPass("upscale", {{scene, RenderGraph::Access::TransferRead}, {output, RenderGraph::Access::TransferWrite}},
+                         [this](const VkCommandBuffer command_buffer, const size_t image_index)
+                         {
+                           gpu_profiler->BeginPass(command_buffer, image_index, upscale_pass);
+                           scaled->RecordUpscale(command_buffer, image_index, swapchain->GetImage(image_index), swapchain->GetExtent());
+                           gpu_profiler->EndPass(command_buffer, image_index, upscale_pass);
+                         });
+  }
+  frame_graph->Compile();
+  frame_stats.SetInfo("render_graph_passes", std::to_string(frame_graph->PassesCount()));
+}
+
+void VisualEngine::RecordCommandBuffer(const size_t image_index)
+{
+  command_pool->ResetCommandBuffer(image_index);
+  BuildFrameGraph();
+
+  auto &command_buffer = command_pool->GetCommandBuffer(image_index).BeginCommandBuffer();
+  gpu_profiler->Reset(command_buffer.GetCommandBuffer(), image_index);
+  frame_graph->Execute(command_buffer.GetCommandBuffer(), image_index);
+  command_buffer.EndCommandBuffer();
+}
+
+void VisualEngine::RecordMainPass(const VkCommandBuffer command_buffer, const size_t image_index)
 {
-  auto descriptor_sets = descriptors->GetDescriptorSets();
-  auto frame_buffers = render_pass->GetFrameBuffers();
+  // Until assets are resident the pass only clears.
+  VkFramebuffer framebuffer = TargetFrameBuffer(image_index);
+  std::vector<VkCommandBuffer> secondaries;
+  if (drawing)
+  {
+    secondaries = recorder->Record(image_index, TargetRenderPass(), framebuffer, draw_list.size(),
+                                   [this, image_index](const VkCommandBuffer command_buffer, const size_t begin, const size_t end)
+                                   {
+                                     RecordDrawRange(command_buffer, image_index, begin, end);
+                                   });
+  }
+
+  // Clear values follow the attachments of RenderTargets: multisampled color, depth,
+  // resolved color. Without multisampling the pass has two.
+  VkClearValue clear_values[3] = {};
+  clear_values[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+  clear_values[1].depthStencil = {1.0f, 0};
+  clear_values[2].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
 
+  VkRenderPassBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  begin_info.renderPass = TargetRenderPass();
+  begin_info.framebuffer = framebuffer;
+  begin_info.renderArea = {{0, 0}, TargetExtent()};
+  begin_info.clearValueCount = 3;
+  begin_info.pClearValues = clear_values;
+
+  gpu_profiler->BeginPass(command_buffer, image_index, main_pass);
+  vkCmdBeginRenderPass(command_buffer, &begin_info, drawing ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+  if (!secondaries.empty())
+    vkCmdExecuteCommands(command_buffer, (uint32_t) secondaries.size(), secondaries.data());
+  vkCmdEndRenderPass(command_buffer);
+  gpu_profiler->EndPass(command_buffer, image_index, main_pass);
+}
+
+void VisualEngine::RecordDrawRange(const VkCommandBuffer command_buffer, const size_t image_index, const size_t begin, const size_t end)
+{
   VkViewport port = {};
   port.x = 0.0f;
   port.y = 0.0f;
-  port.width = (float) this->swapchain->GetExtent().width;
-  port.height = (float) this->swapchain->GetExtent().height;
+  port.width = (float) TargetExtent().width;
+  port.height = (float) TargetExtent().height;
   port.minDepth = 0.0f;
   port.maxDepth = 1.0f;
 
   VkRect2D scissor = {};
   scissor.offset = {0, 0};
-  scissor.extent = swapchain->GetExtent();
+  scissor.extent = TargetExtent();
 
-  for (size_t i = 0; i < render_pass->GetFrameBuffers().size(); ++i)
+  // Secondary buffers inherit no state, every range binds everything it draws with.
+  // The frame ring slot of an image is fixed, so are its dynamic offsets.
+  const FrameOffsets &offsets = frame_offsets[image_index];
+  const VkDeviceSize instances_offset = gpu_culling ? gpu_culling->GetInstancesOffset(image_index) : offsets.instances;
+  const uint32_t dynamic_offsets[] = {(uint32_t) offsets.world, (uint32_t) instances_offset};
+  const VkDescriptorSet descriptor_sets[] = {descriptor_set, material_table->GetSet()};
+  auto vertex_buffers = girl->GetVertexBuffers();
+  auto vertex_offsets = girl->GetVertexBuffersOffsets();
+  vkCmdBindVertexBuffers(command_buffer, 0, (uint32_t) vertex_buffers.size(), vertex_buffers.data(), vertex_offsets.data());
+  vkCmdBindIndexBuffer(command_buffer, girl->GetModelIndicesInfo().buffer, girl->GetModelIndicesInfo().sub_buffers[0].offset, girl->GetIndexType());
+  vkCmdSetViewport(command_buffer, 0, 1, &port);
+  vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+  // One statistics slot per batch, the slots of all batches are summed on readback.
+  // Variants share their set layouts, sets bound once stay valid across pipeline switches.
+  const GraphicsPipeline *bound = nullptr;
+  for (size_t i = begin; i < end; ++i)
   {
-    command_pool->ResetCommandBuffer(i);
-    command_pool->GetCommandBuffer(i)
-                  .BeginCommandBuffer()
-                  .BindVertexBuffers({girl->GetModelVerticesInfo().buffer}, {0}, 0, 1)
-                  .BindIndexBuffer(girl->GetModelIndicesInfo().buffer, VK_INDEX_TYPE_UINT32, 0)
-                  .SetViewport({port})
-                  .SetScissor({scissor})
-                  .BeginRenderPass(render_pass, i)
-                  .BindPipeline(pipelines.GetPipeline(0), VK_PIPELINE_BIND_POINT_GRAPHICS)
-                  .BindDescriptorSets(pipelines.GetLayout(0), VK_PIPELINE_BIND_POINT_GRAPHICS, descriptors->GetDescriptorSets(), 0, {})
-                  .DrawIndexed(girl->GetModelIndicesInfo().sub_buffers[0].elements, 0, 0, 1, 0)
-                  .EndRenderPass()
-                  .EndCommandBuffer();
+    const GraphicsPipeline &variant = pipelines->Get(VariantFeatures(draw_list[i]));
+    if (&variant != bound)
+    {
+      vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, variant.GetPipeline());
+      if (!bound)
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, variant.GetLayout(), 0, 2, descriptor_sets, 2, dynamic_offsets);
+      bound = &variant;
+    }
+    gpu_profiler->BeginStatistics(command_buffer, image_index, (uint32_t) i);
+    if (gpu_culling)
+      gpu_culling->Draw(command_buffer, image_index);
+    else
+      vkCmdDrawIndexedIndirect(command_buffer, frame_ring->GetBuffer(), offsets.commands + draw_list[i].command_offset,
+                               draw_list[i].commands_count, sizeof(VkDrawIndexedIndirectCommand));
+    gpu_profiler->EndStatistics(command_buffer, image_index, (uint32_t) i);
   }
 }
 
-void VisualEngine::UpdateWorldUniformBuffers(uint32_t image_index)
+void VisualEngine::PrepareObjects()
 {
-  auto current_time = std::chrono::high_resolution_clock::now();
-  float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - priv_frame_time).count();
-  
-  //surface->SetWindowTitle(Vulkan::Instance::AppName() + " FPS:" + std::to_string(1.0 / time));
-  World bf = {};
-  bf.light = {10.0f, 10.0f, 10.0f, 1.0f};
-  float x = 0;
-  float y = 0;
-  float z = 0;
-  if (up_key_down)
+  glm::vec3 extent = girl->GetBoundsMax() - girl->GetBoundsMin();
+  float spacing = std::max(std::max(extent.x, extent.z), 1.0f) * 1.5f;
+  size_t side = (size_t) std::ceil(std::sqrt((double) objects.size()));
+
+  for (size_t i = 0; i < objects.size(); ++i)
   {
-    //girl->Move(glm::vec3(-30.0f * time, 0.0, -30.0f * time));
-    x = time * -1.0f;
+    glm::vec3 offset = {((float) (i % side) - (side - 1) * 0.5f) * spacing, 0.0f, ((float) (i / side) - (side - 1) * 0.5f) * spacing};
+    objects[i] = glm::translate(glm::mat4(1.0f), offset);
   }
-  if (down_key_down)
+  scene_radius = (float) side * spacing * 0.75f;
+
+  Aabb bounds = {girl->GetBoundsMin(), girl->GetBoundsMax()};
+  std::vector<Aabb> boxes(objects.size());
+  for (size_t i = 0; i < objects.size(); ++i)
+    boxes[i] = bounds.Transformed(objects[i] * bvh_transform);
+  scene_bvh.Build(boxes);
+}
+
+void VisualEngine::PreparePipeline()
+{
+  auto pipeline_config = PipelineConfig();
+  for (auto &vertex_description : GetVertexDescriptions(girl->GetVertexFormat(), girl->HasConstantColor()))
+    pipeline_config.AddInputBinding(vertex_description);
+
+  std::string vertex_shader = girl->GetVertexFormat() == VertexFormat::Packed ? "tri_packed.vert.spv" : "tri.vert.spv";
+  auto start = std::chrono::steady_clock::now();
+  pipelines = std::make_unique<PipelineVariants>(device, *pipeline_cache, TargetRenderPass(), pipeline_config
+                                                 .UseDepthBias(true)
+                                                 .UseDepthTesting(true)
+                                                 .AddShader(VK_SHADER_STAGE_VERTEX_BIT, exec_directory + vertex_shader)
+                                                 .AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, exec_directory + "tri.frag.spv")
+                                                 .AddSpecializationConstant(VK_SHADER_STAGE_FRAGMENT_BIT, 0, material_table->TexturesCapacity())
+                                                 .SetSamplesCount(TargetSamplesCount())
+                                                 .AddDescriptorSetLayouts({descriptor_set_layout, material_table->GetLayout()})
+                                                 .AddDynamicState(VK_DYNAMIC_STATE_VIEWPORT)
+                                                 .AddDynamicState(VK_DYNAMIC_STATE_SCISSOR)
+                                                 .SetFace(VK_FRONT_FACE_COUNTER_CLOCKWISE)
+                                                 .SetCullMode(VK_CULL_MODE_BACK_BIT)
+                                                 .SetPolygonMode(VK_POLYGON_MODE_FILL),
+                                                 sample_shading);
+  // Variants of the draw list are compiled now, not on the recording threads.
+  for (auto &batch : draw_list)
+    pipelines->Get(VariantFeatures(batch));
+  startup_stats.pipeline_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  startup_stats.warm_pipeline_cache = pipeline_cache->IsWarm();
+#ifdef DEBUG
+  std::cout << __func__ << ": " << startup_stats.pipeline_ms << " ms with a " << (startup_stats.warm_pipeline_cache ? "warm" : "cold") << " cache" << std::endl;
+#endif
+}
+
+void VisualEngine::RebuildPipeline()
+{
+  // Nothing to rebuild before assets are resident, the first pipelines pick up the current state.
+  if (!pipelines)
+    return;
+
+  std::shared_ptr<PipelineVariants> old_pipelines = std::move(pipelines);
+  retired.Retire(timeline->Submitted(), [old_pipelines]() mutable { old_pipelines.reset(); });
+  PreparePipeline();
+}
+
+void VisualEngine::ReloadSettings()
+{
+  if (!surface)
+    return;
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - settings_check_time < std::chrono::seconds(1))
+    return;
+  settings_check_time = now;
+
+  std::error_code error;
+  auto time = std::filesystem::last_write_time(settings_file, error);
+  if (error || time == settings_time)
+    return;
+  settings_time = time;
+
+  // Keys missing from the file keep their current values.
+  Settings loaded = settings;
+  if (loaded.Load(settings_file))
+    ApplySettings(loaded);
+}
+
+void VisualEngine::ApplySettings(const Settings &loaded)
+{
+  // Window size and mode, the device and the objects count are only read at start.
+  if (loaded.Lighting() != settings.Lighting() || loaded.Texturing() != settings.Texturing())
+  {
+    settings.Lighting(loaded.Lighting());
+    settings.Texturing(loaded.Texturing());
+    for (auto &batch : draw_list)
+    {
+      batch.features = DrawFeatures();
+      if (pipelines)
+        pipelines->Get(VariantFeatures(batch));
+    }
+    InvalidateCommandBuffers();
+  }
+
+  if (loaded.PresentMode() != settings.PresentMode())
+  {
+    settings.PresentMode(loaded.PresentMode());
+    swapchain->SetPresentMode((VkPresentModeKHR) settings.PresentMode());
+    resize_flag = true;
+  }
+
+  if (loaded.FramesInFlight() != settings.FramesInFlight() || loaded.LowLatency() != settings.LowLatency())
   {
-    //girl->Move(glm::vec3(30.0f * time, 0.0, 30.0f * time));
-    x = time * 1.0f;
+    settings.FramesInFlight(loaded.FramesInFlight());
+    settings.LowLatency(loaded.LowLatency());
+    // Fences are only replaced once every frame completed, so latency is booked first.
+    timeline->WaitIdle();
+    RecordLatency();
+    timeline->SetFramesInFlight(FramesInFlight());
+    frame_stats.SetInfo("frames_in_flight", std::to_string(timeline->FramesInFlight()));
+    frame_stats.SetInfo("low_latency", settings.LowLatency() ? "on" : "off");
   }
-  if (left_key_down)
+
+  const bool quality_changed = loaded.Multisampling() != settings.Multisampling() || loaded.SampleShading() != settings.SampleShading();
+  const bool resolution_changed = loaded.DynamicResolution() != settings.DynamicResolution() || loaded.FrameBudget() != settings.FrameBudget() ||
+                                  loaded.MinRenderScale() != settings.MinRenderScale() || loaded.AdaptiveQuality() != settings.AdaptiveQuality();
+  if (!quality_changed && !resolution_changed)
+    return;
+
+  settings.Multisampling(loaded.Multisampling());
+  settings.SampleShading(loaded.SampleShading());
+  settings.DynamicResolution(loaded.DynamicResolution());
+  settings.FrameBudget(loaded.FrameBudget());
+  settings.MinRenderScale(loaded.MinRenderScale());
+  settings.AdaptiveQuality(loaded.AdaptiveQuality());
+
+  // The controller starts over from the new full quality.
+  EnableDynamicResolution(false);
+  if (quality_changed)
+    ApplyQuality((VkSampleCountFlagBits) settings.Multisampling(), settings.SampleShading());
+  EnableDynamicResolution(settings.DynamicResolution());
+}
+
+void VisualEngine::ApplyQuality(const VkSampleCountFlagBits samples, const float shading)
+{
+  sample_shading = shading;
+  if (!scaled && swapchain && samples != swapchain->GetSamplesCount())
   {
-    y = time * 1.0f;
+    // The swapchain replaces its render pass with the next recreation, which rebuilds the pipelines too.
+    swapchain->SetSamplesCount(samples);
+    resize_flag = true;
+    return;
   }
-  if (right_key_down)
+
+  if (scaled && samples != scaled->GetSamplesCount())
   {
-    y = time * -1.0f;
+    scaled->SetSamplesCount(samples, retired, timeline->Submitted());
+    RebuildPipeline();
   }
-  girl->Rotate(x, y, z);
-  bf.model = girl->ObjectTransforations();
-  bf.view = glm::lookAt(glm::vec3(10.0f, 10.0f, 10.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-  bf.proj = glm::perspective(glm::radians(45.0f), swapchain->GetExtent().width / (float) swapchain->GetExtent().height, 0.1f, 100.0f);
+  else if (pipelines && shading > 0.0f && shading != pipelines->GetMinSampleShading())
+    RebuildPipeline();
+  else if (pipelines)
+  {
+    // Turning sample shading on or off only switches variants.
+    for (auto &batch : draw_list)
+      pipelines->Get(VariantFeatures(batch));
+  }
+  InvalidateCommandBuffers();
+}
+
+void VisualEngine::EnableDynamicResolution(const bool enable)
+{
+  if (enable == (scaled != nullptr))
+    return;
+  if (enable && (!swapchain || !swapchain->IsTransferDst()))
+  {
+    std::cerr << "dynamic resolution needs swapchain images that can be blitted to" << std::endl;
+    return;
+  }
+
+  if (enable)
+  {
+    scaled = std::make_unique<ScaledTarget>(device, swapchain->GetFormat(), (VkSampleCountFlagBits) settings.Multisampling());
+    scaled->Resize(swapchain->GetExtent(), swapchain->GetImagesCount(), retired, timeline->Submitted());
+
+    DynamicResolution::Config config;
+    config.budget_ms = settings.FrameBudget();
+    config.min_scale = settings.MinRenderScale();
+    config.adaptive_quality = settings.AdaptiveQuality();
+    resolution = std::make_unique<DynamicResolution>(config, scaled->GetSamplesCount(), settings.SampleShading());
+    sample_shading = resolution->SampleShading();
+  }
+  else
+  {
+    std::shared_ptr<ScaledTarget> old_scaled = std::move(scaled);
+    retired.Retire(timeline->Submitted(), [old_scaled]() mutable { old_scaled.reset(); });
+    resolution.reset();
+    sample_shading = settings.SampleShading();
+  }
+
+  // The render pass changes between the swapchain's and the scaled one.
+  RebuildPipeline();
+  InvalidateCommandBuffers();
+  frame_stats.SetInfo("dynamic_resolution", enable ? "on" : "off");
+}
+
+void VisualEngine::UpdateStreaming()
+{
+  streamer->Update();
+
+  if (model_loaded && !model_resident && uploader->IsComplete(girl->GetModelUploadValue()))
+    model_resident = true;
+
+  while (!pending_mips.empty() && uploader->IsComplete(pending_mips.front().second))
+  {
+    resident_mip = (float) pending_mips.front().first;
+    pending_mips.pop_front();
+  }
+
+  if (!drawing && model_resident && resident_mip >= 0.0f)
+    OnAssetsResident();
+}
+
+void VisualEngine::OnAssetsResident()
+{
+  if (girl->GetLods().size() > max_lods)
+    throw std::runtime_error("too many LOD levels!");
+
+  // One time stall: the texture descriptor and the command buffers change under frames in flight.
+  {
+    auto queue_lock = uploader->LockQueues();
+    vkQueueWaitIdle(graphics_queue);
+  }
+
+  PrepareObjects();
+
+  // Only the new texture's array element is written, the material ID goes into every instance.
+  Material material;
+  material.texture_index = material_table->AddTexture(girl->GetTextureInfo().image_view, girl->GetSampler());
+  girl_material = material_table->AddMaterial(material);
+
+  // One batch per LOD: instances are grouped by LOD every frame in UpdateInstances, so the
+  // list never changes with the object count or the selected levels. Culled on the GPU,
+  // all objects are one batch drawn with the compacted commands.
+  // A batch never mixes materials: the fragment shader indexes the texture array with the
+  // material's texture, which core Vulkan only allows with a dynamically uniform index.
+  draw_list.clear();
+  if (use_gpu_culling)
+  {
+    PrepareGpuCulling();
+    WriteFrameRingDescriptors();
+    draw_list.push_back({0, 1, DrawFeatures(), girl_material});
+  }
+  else
+  {
+    for (size_t l = 0; l < girl->GetLods().size(); ++l)
+      draw_list.push_back({l * sizeof(VkDrawIndexedIndirectCommand), 1, DrawFeatures(), girl_material});
+  }
+  PreparePipeline();
+
+  drawing = true;
+  InvalidateCommandBuffers();
+}
+
+uint32_t VisualEngine::DrawFeatures() const
+{
+  // A single object is the only instance of its draw: CPU culling writes it first and every
+  // other LOD command has no instances. Compacted GPU draws point at their own slots.
+  uint32_t features = 0;
+  if (settings.Texturing())
+    features |= PipelineVariants::Textured;
+  if (settings.Lighting())
+    features |= PipelineVariants::Lit;
+  if (use_gpu_culling || objects.size() > 1)
+    features |= PipelineVariants::Instanced;
+  return features;
+}
+
+void VisualEngine::PrepareFrameRing()
+{
+  // A ring slot per swapchain image: command buffers are recorded per image and
+  // the image's last frame value guards its slot.
+  VkDeviceSize alignment = FrameRing::OffsetAlignment(device->GetPhysicalDevice());
+  VkDeviceSize frame_size = FrameRing::AlignedSize(sizeof(World), alignment)
+                          + FrameRing::AlignedSize(max_lods * sizeof(VkDrawIndexedIndirectCommand), alignment)
+                          + FrameRing::AlignedSize(objects.size() * sizeof(InstanceData), alignment)
+                          + FrameRing::AlignedSize(sizeof(CullParams), alignment);
+
+  frame_ring = std::make_unique<FrameRing>(device, frame_size, TargetImagesCount(),
+                                           VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  frame_offsets.resize(TargetImagesCount());
+  for (size_t i = 0; i < frame_offsets.size(); ++i)
+    frame_offsets[i] = AllocateFrame(i);
+}
+
+FrameOffsets VisualEngine::AllocateFrame(const size_t image_index)
+{
+  FrameOffsets offsets = {};
+  frame_ring->BeginFrame(image_index);
+  offsets.world = frame_ring->Allocate(sizeof(World));
+  offsets.commands = frame_ring->Allocate(max_lods * sizeof(VkDrawIndexedIndirectCommand));
+  offsets.instances = frame_ring->Allocate(objects.size() * sizeof(InstanceData));
+  offsets.cull = frame_ring->Allocate(sizeof(CullParams));
+  return offsets;
+}
+
+void VisualEngine::PrepareDescriptors()
+{
+  // Frame data only, textures live in the MaterialTable's set. Binding 1 stays unused so
+  // instance data keeps its binding in the shaders.
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  bindings[0].binding = 0;
+  bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  bindings[0].descriptorCount = 1;
+  bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  bindings[1].binding = 2;
+  bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  bindings[1].descriptorCount = 1;
+  bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+  VkDescriptorSetLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layout_info.bindingCount = 2;
+  layout_info.pBindings = bindings;
+  if (vkCreateDescriptorSetLayout(device->GetDevice(), &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor set layout!");
+
+  VkDescriptorPoolSize pool_sizes[2] = {};
+  for (size_t i = 0; i < 2; ++i)
+  {
+    pool_sizes[i].type = bindings[i].descriptorType;
+    pool_sizes[i].descriptorCount = 1;
+  }
+
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 2;
+  pool_info.pPoolSizes = pool_sizes;
+  if (vkCreateDescriptorPool(device->GetDevice(), &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS)
+    throw std::runtime_error("failed to create descriptor pool!");
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &descriptor_set_layout;
+  if (vkAllocateDescriptorSets(device->GetDevice(), &alloc_info, &descriptor_set) != VK_SUCCESS)
+    throw std::runtime_error("failed to allocate descriptor set!");
+
+  WriteFrameRingDescriptors();
+}
+
+void VisualEngine::WriteFrameRingDescriptors()
+{
+  VkDescriptorBufferInfo world_info = {frame_ring->GetBuffer(), 0, sizeof(World)};
+  VkDescriptorBufferInfo instances_info = {frame_ring->GetBuffer(), 0, objects.size() * sizeof(InstanceData)};
+  if (gpu_culling)
+    instances_info = {gpu_culling->GetInstancesBuffer(), 0, gpu_culling->GetInstancesRange()};
+
+  VkWriteDescriptorSet writes[2] = {};
+  for (uint32_t i = 0; i < 2; ++i)
+  {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptor_set;
+    writes[i].descriptorCount = 1;
+  }
+  writes[0].dstBinding = 0;
+  writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  writes[0].pBufferInfo = &world_info;
+  writes[1].dstBinding = 2;
+  writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+  writes[1].pBufferInfo = &instances_info;
+  vkUpdateDescriptorSets(device->GetDevice(), 2, writes, 0, nullptr);
+}
+
+void VisualEngine::PrepareGpuCulling()
+{
+  // Object matrices are uploaded once, the first dispatch waits for them here.
+  gpu_culling.reset();
+  gpu_culling = std::make_unique<GpuCulling>(device, *pipeline_cache, exec_directory + "cull.comp.spv", *uploader, objects,
+                                             TargetImagesCount(), frame_ring->GetBuffer(), sizeof(InstanceData));
+  uploader->Flush();
+  uploader->Wait(gpu_culling->GetUploadValue());
+}
+
+void VisualEngine::UpdateCullParams(const FrameOffsets &offsets, const World &world, const glm::mat4 &object_transform)
+{
+  // Everything the compute pass needs, the same amount of data whatever the object count.
+  CullParams params = {};
+  Frustum frustum = Frustum::FromMatrix(world.proj * world.view);
+  for (size_t i = 0; i < 6; ++i)
+    params.planes[i] = frustum.planes[i];
+  params.object_transform = object_transform;
+  params.vertex_transform = girl->GetVertexTransform();
+  params.eye = glm::vec4(glm::vec3(glm::inverse(world.view)[3]), std::fabs(world.proj[1][1]) * TargetExtent().height * 0.5f);
+  params.bounds_min = glm::vec4(girl->GetBoundsMin(), 1.0f);
+  params.bounds_max = glm::vec4(girl->GetBoundsMax(), 0.0f);
+  params.sphere = glm::vec4(girl->GetSphereCenter(), girl->GetSphereRadius());
+  params.objects_count = (uint32_t) objects.size();
+  params.lods_count = (uint32_t) girl->GetLods().size();
+  // The one batch draws every object with a single material.
+  params.material = draw_list[0].material;
+  for (size_t l = 0; l < girl->GetLods().size(); ++l)
+    params.lods[l] = {girl->GetLods()[l].index_offset, girl->GetLods()[l].index_count, girl->GetLods()[l].error, 0.0f};
+  *frame_ring->Data<CullParams>(offsets.cull) = params;
+}
+
+void VisualEngine::UpdateSceneBounds(const glm::mat4 &object_transform)
+{
+  // Every object shares the simulated transform, while it holds still the tree is left alone.
+  if (object_transform == bvh_transform)
+    return;
+  bvh_transform = object_transform;
+
+  Aabb bounds = {girl->GetBoundsMin(), girl->GetBoundsMax()};
+  for (size_t i = 0; i < objects.size(); ++i)
+    scene_bvh.Update(i, bounds.Transformed(objects[i] * object_transform));
+  scene_bvh.Refit();
+}
+
+void VisualEngine::CullObjects(const World &world, const glm::mat4 &object_transform)
+{
+  frame_stats.Begin(cull_phase);
+  UpdateSceneBounds(object_transform);
+  visible_objects.clear();
+  cull_stats = scene_bvh.Cull(Frustum::FromMatrix(world.proj * world.view), visible_objects);
+  frame_stats.End(cull_phase);
+
+  cull_totals.objects_tested += cull_stats.objects_tested;
+  cull_totals.objects_culled += cull_stats.objects_culled;
+  ++cull_frames;
+}
+
+void VisualEngine::UpdateInstances(const FrameOffsets &offsets, const World &world, const glm::mat4 &object_transform)
+{
+  const auto &lods = girl->GetLods();
+  glm::vec3 eye = glm::vec3(glm::inverse(world.view)[3]);
+  float projection_scale = std::fabs(world.proj[1][1]) * TargetExtent().height * 0.5f;
+
+  // Only visible objects get instances, culled ones leave the end of the instance block unused.
+  CullObjects(world, object_transform);
+
+  // Counting sort by LOD: the first pass picks levels, the second writes instances grouped by level.
+  instance_lods.resize(visible_objects.size());
+  lod_instances.assign(lods.size() + 1, 0);
+  for (size_t v = 0; v < visible_objects.size(); ++v)
+  {
+    instance_lods[v] = (uint8_t) girl->SelectLod(objects[visible_objects[v]] * object_transform, eye, projection_scale);
+    lod_instances[instance_lods[v] + 1]++;
+  }
+
+  auto commands = frame_ring->Data<VkDrawIndexedIndirectCommand>(offsets.commands);
+  for (size_t l = 0; l < lods.size(); ++l)
+  {
+    commands[l].indexCount = lods[l].index_count;
+    commands[l].instanceCount = lod_instances[l + 1];
+    commands[l].firstIndex = lods[l].index_offset;
+    commands[l].vertexOffset = 0;
+    commands[l].firstInstance = lod_instances[l];
+    lod_instances[l + 1] += lod_instances[l];
+  }
+
+  auto instances = frame_ring->Data<InstanceData>(offsets.instances);
+  glm::mat4 vertex_transform = girl->GetVertexTransform();
+  for (size_t v = 0; v < visible_objects.size(); ++v)
+  {
+    // Normals are stored unquantized, so the normal matrix leaves out the packed bounds transform.
+    glm::mat4 model = objects[visible_objects[v]] * object_transform;
+    auto &instance = instances[lod_instances[instance_lods[v]]++];
+    instance.model = model * vertex_transform;
+    glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    instance.normal[0] = glm::vec4(normal[0], 0.0f);
+    instance.normal[1] = glm::vec4(normal[1], 0.0f);
+    instance.normal[2] = glm::vec4(normal[2], 0.0f);
+    instance.material = glm::uvec4(draw_list[instance_lods[v]].material, 0, 0, 0);
+  }
+}
+
+void VisualEngine::UpdateWorldUniformBuffers(uint32_t image_index)
+{
+  World bf = {};
+  bf.light = {10.0f, 10.0f, 10.0f, 1.0f};
+  bf.texture_lod = {std::max(resident_mip, 0.0f), 0.0f, 0.0f, 0.0f};
+  bf.view = glm::lookAt(camera_eye, camera_target, glm::vec3(0.0f, 1.0f, 0.0f));
+  bf.proj = glm::perspective(glm::radians(45.0f), TargetExtent().width / (float) TargetExtent().height, 0.1f, 100.0f);
   bf.proj[1][1] *= -1;
 
-  storage_buffers->SetSubBufferData(0, image_index, std::vector<World>{bf});
-  priv_frame_time = std::chrono::high_resolution_clock::now();
+  // The ring is write-combined memory, everything read back on the CPU stays on the stack.
+  FrameOffsets offsets = AllocateFrame(image_index);
+  *frame_ring->Data<World>(offsets.world) = bf;
+  if (drawing)
+  {
+    glm::mat4 object_transform = simulation->Sample(std::chrono::steady_clock::now()).Transform();
+    if (gpu_culling)
+      UpdateCullParams(offsets, bf, object_transform);
+    else
+      UpdateInstances(offsets, bf, object_transform);
+  }
+}
+
+void VisualEngine::DefragmentMemory()
+{
+  if (!defragmenting)
+    return;
+
+  // Moved buffers are rebound in descriptor sets shared by every frame, so nothing may be in
+  // flight. Each step is bounded to keep the stall short, it ends once nothing moves.
+  VkDeviceSize moved = 0;
+  {
+    auto queue_lock = uploader->LockQueues();
+    vkQueueWaitIdle(graphics_queue);
+    moved = allocator->Defragment(graphics_queue, defragment_step);
+  }
+  if (moved == 0)
+  {
+    defragmenting = false;
+    allocator->Print(std::cout);
+    return;
+  }
+
+  WriteFrameRingDescriptors();
+  InvalidateCommandBuffers();
 }
 
 void VisualEngine::DrawFrame()
 {
+  UpdateStreaming();
+  ReloadSettings();
+  DefragmentMemory();
+
   uint32_t image_index = 0;
-  vkWaitForFences(device->GetDevice(), 1, &exec_fences[current_frame], VK_TRUE, UINT64_MAX);
-  VkResult res = vkAcquireNextImageKHR(device->GetDevice(), swapchain->GetSwapChain(), UINT64_MAX, (*image_available_semaphores)[current_frame], VK_NULL_HANDLE, &image_index);
+  frame_stats.Begin(acquire_phase);
+  // Low latency lets the GPU drain first: the input sampled below then goes out with the next
+  // submission instead of queuing behind frames_in_flight others. Otherwise Begin only waits
+  // for the frame whose fence and acquire semaphore the next one reuses.
+  if (settings.LowLatency())
+    timeline->Wait(timeline->Submitted());
+  const size_t slot = timeline->Slot();
+  VkFence fence = timeline->Begin();
+  timeline->Poll();
+  RecordLatency();
+  retired.Collect(timeline->Completed());
+
+  if (swapchain && resize_flag && !RecreateSwapchain())
+    return;
+
+  VkResult res = VK_SUCCESS;
+  if (offscreen)
+    image_index = (uint32_t) (timeline->NextValue() % TargetImagesCount());
+  else
+    res = vkAcquireNextImageKHR(device->GetDevice(), swapchain->GetSwapChain(), UINT64_MAX, (*image_available_semaphores)[slot], VK_NULL_HANDLE, &image_index);
+  frame_stats.End(acquire_phase);
 
-  if (res != VK_SUCCESS)
+  // Nothing was acquired from an out of date swapchain, the next frame replaces it first.
+  // A suboptimal image still presents fine, it is drawn and the swapchain replaced afterwards.
+  if (res == VK_ERROR_OUT_OF_DATE_KHR)
   {
-    if (res == VK_SUBOPTIMAL_KHR || res == VK_ERROR_OUT_OF_DATE_KHR || resize_flag)
-    {
-      ReBuildPipelines();
-      return;
-    }
-    else
-      throw std::runtime_error("failed to acquire swap chain image!");
+    resize_flag = true;
+    return;
   }
+  if (res == VK_SUBOPTIMAL_KHR)
+    resize_flag = true;
+  else if (res != VK_SUCCESS)
+    throw std::runtime_error("failed to acquire swap chain image!");
+
+  timeline->Wait(image_values[image_index]);
+  CollectGpuTimings(image_index);
 
-  if (in_process[image_index] != VK_NULL_HANDLE) 
+  if (recorded_versions[image_index] != draw_list_version)
   {
-    vkWaitForFences(device->GetDevice(), 1, &in_process[image_index], VK_TRUE, UINT64_MAX);
+    frame_stats.Begin(record_phase);
+    RecordCommandBuffer(image_index);
+    recorded_versions[image_index] = draw_list_version;
+    frame_stats.End(record_phase);
   }
 
-  in_process[image_index] = exec_fences[current_frame];
+  // Late latching: events that arrived while waiting and recording still make it into this
+  // frame, the simulation and camera are sampled right after. Headless frames have no input.
+  if (settings.LowLatency() || !surface)
+  {
+    if (surface)
+      surface->PollEvents();
+    input_time = std::chrono::steady_clock::now();
+  }
 
+  frame_stats.Begin(update_phase);
   UpdateWorldUniformBuffers(image_index);
+  frame_stats.End(update_phase);
 
-  std::vector<VkSemaphore> wait_semaphores = { (*image_available_semaphores)[current_frame] };  
-  std::vector<VkSemaphore> signal_semaphores = { (*render_finished_semaphores)[current_frame] };
-  std::vector<VkPipelineStageFlags> wait_stages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; 
-  VkSwapchainKHR swapchains[] = { swapchain->GetSwapChain() };
+  VkSemaphore wait_semaphores[] = { (*image_available_semaphores)[slot] };
+  VkSemaphore signal_semaphores[] = { (*render_finished_semaphores)[image_index] };
+  // The scaled pass never touches the swapchain image, only the upscale has to wait for it.
+  VkPipelineStageFlags wait_stages[] = { scaled ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+  VkCommandBuffer command_buffers[] = { command_pool->GetCommandBuffer(image_index).GetCommandBuffer() };
+  VkSwapchainKHR swapchains[] = { swapchain ? swapchain->GetSwapChain() : VK_NULL_HANDLE };
+
+  // Offscreen images are neither acquired nor presented, the fence alone orders them.
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.waitSemaphoreCount = offscreen ? 0 : 1;
+  submit_info.pWaitSemaphores = wait_semaphores;
+  submit_info.pWaitDstStageMask = wait_stages;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = command_buffers;
+  submit_info.signalSemaphoreCount = offscreen ? 0 : 1;
+  submit_info.pSignalSemaphores = signal_semaphores;
 
   VkPresentInfoKHR present_info = {};
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-  present_info.waitSemaphoreCount = (uint32_t) signal_semaphores.size();
-  present_info.pWaitSemaphores = signal_semaphores.data();
+  present_info.waitSemaphoreCount = 1;
+  present_info.pWaitSemaphores = signal_semaphores;
   present_info.swapchainCount = 1;
   present_info.pSwapchains = swapchains;
   present_info.pImageIndices = &image_index;
   present_info.pResults = nullptr;
 
-  vkResetFences(device->GetDevice(), 1, &exec_fences[current_frame]);
-  command_pool->ExecuteBuffer(image_index, exec_fences[current_frame], signal_semaphores, wait_stages, wait_semaphores);
-  vkQueuePresentKHR(device->GetPresentQueue(), &present_info);
+  {
+    auto queue_lock = uploader->LockQueues();
+    frame_stats.Begin(submit_phase);
+    if (vkQueueSubmit(graphics_queue, 1, &submit_info, fence) != VK_SUCCESS)
+      throw std::runtime_error("failed to submit draw command buffer!");
+    image_values[image_index] = timeline->Signal();
+    latency_frames.push_back({image_values[image_index], input_time});
+    frame_stats.End(submit_phase);
+    gpu_profiler->Submitted(image_index);
+    last_image = image_index;
+
+    if (!offscreen)
+    {
+      frame_stats.Begin(present_phase);
+      VkResult present = vkQueuePresentKHR(device->GetPresentQueue(), &present_info);
+      frame_stats.End(present_phase);
+      if (present == VK_SUBOPTIMAL_KHR || present == VK_ERROR_OUT_OF_DATE_KHR)
+        resize_flag = true;
+    }
+  }
+
+  if (drawing && startup_stats.first_frame_ms == 0.0)
+    startup_stats.first_frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+
+  frame_stats.EndFrame();
+  UpdateWindowTitle();
+}
+
+void VisualEngine::RecordLatency()
+{
+  // Booked into the frame that sees the completion, like the GPU timings, the latest one wins
+  // when several complete at once. Without display timing extensions the time an image reaches
+  // the screen is unknown, so this is input to the end of rendering, plus however long the
+  // completion went unnoticed: up to a frame, unless low latency waits for it.
+  while (!latency_frames.empty() && latency_frames.front().first <= timeline->Completed())
+  {
+    auto &frame = latency_frames.front();
+    frame_stats.Record(latency_series, std::chrono::duration<double, std::milli>(timeline->CompletionTime(frame.first) - frame.second).count());
+    latency_frames.pop_front();
+  }
+}
+
+void VisualEngine::CollectGpuTimings(const uint32_t image_index)
+{
+  // The results belong to the image's previous submission, a few frames back, and are
+  // booked into the current frame: series stay aligned, only shifted by the latency.
+  GpuFrameTimings timings;
+  if (!gpu_profiler->Collect(image_index, timings))
+    return;
+
+  double gpu_ms = 0.0;
+  for (size_t p = 0; p < timings.pass_ms.size() && p < gpu_pass_series.size(); ++p)
+  {
+    frame_stats.Record(gpu_pass_series[p], timings.pass_ms[p]);
+    if (!std::isnan(timings.pass_ms[p]))
+      gpu_ms += timings.pass_ms[p];
+  }
+  if (drawing && gpu_profiler->HasStatistics())
+    frame_stats.RecordStatistics(timings.statistics);
+
+  // Runs before this image records, so a change applies to the frame about to be drawn.
+  if (!resolution || !drawing || std::isnan(timings.pass_ms[main_pass]))
+    return;
+  switch (resolution->Update(gpu_ms))
+  {
+    case DynamicResolution::Change::Scale:
+      scaled->SetScale(resolution->Scale());
+      InvalidateCommandBuffers();
+      break;
+    case DynamicResolution::Change::Quality:
+      ApplyQuality(resolution->Samples(), resolution->SampleShading());
+      break;
+    default:
+      break;
+  }
+}
+
+void VisualEngine::UpdateWindowTitle()
+{
+  if (!surface)
+    return;
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - title_time < std::chrono::seconds(1))
+    return;
+  title_time = now;
 
-  current_frame = (current_frame + 1) % frames_in_pipeline;
+  SeriesSummary frame = frame_stats.Summary(FrameStats::frame_series);
+  SeriesSummary gpu = frame_stats.Summary(gpu_pass_series[main_pass]);
+  SeriesSummary latency = frame_stats.Summary(latency_series);
+  char title[256];
+  int length = std::snprintf(title, sizeof(title), " FPS: %.1f frame p50/p99: %.2f/%.2f ms gpu: %.2f ms latency: %.1f ms stutters: %zu",
+                             frame_stats.Fps(), frame.p50, frame.p99, gpu.p50, latency.p50, frame_stats.Stutters());
+  // The compute pass keeps its visible count on the GPU.
+  if (!gpu_culling && length > 0 && (size_t) length < sizeof(title))
+    length += std::snprintf(title + length, sizeof(title) - length, " visible: %zu/%zu", cull_stats.objects - cull_stats.objects_culled, cull_stats.objects);
+  if (resolution && length > 0 && (size_t) length < sizeof(title))
+    std::snprintf(title + length, sizeof(title) - length, " scale: %.2f msaa: x%u", resolution->Scale(), (uint32_t) resolution->Samples());
+  surface->SetWindowTitle(Vulkan::Instance::AppName() + title);
 }
 
 void VisualEngine::PrepareShaders()
@@ -300,37 +1214,71 @@ void VisualEngine::PrepareWindow()
 
 void VisualEngine::PrepareSyncPrimitives()
 {
-  VkFenceCreateInfo fence_info = {};
-  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  // One frame more than there are swapchain images keeps the CPU busy while every image waits
+  // for presentation. Offscreen images are reused as soon as their frame completes.
+  max_frames_in_flight = offscreen ? TargetImagesCount() : TargetImagesCount() + 1;
+  timeline = std::make_unique<FrameTimeline>(device, FramesInFlight());
 
-  exec_fences.resize(frames_in_pipeline);
-  in_process.resize(swapchain->GetImagesCount(), VK_NULL_HANDLE);
-
-  for (size_t i = 0; i < frames_in_pipeline; ++i)
-  {
+  image_available_semaphores = std::make_unique<Vulkan::SemaphoreArray>(device);
+  for (size_t i = 0; i < max_frames_in_flight; ++i)
     image_available_semaphores->Add();
+}
+
+void VisualEngine::PrepareImageState()
+{
+  // Everything recorded or written per target image.
+  const uint32_t queue_family = device->GetGraphicFamilyQueueIndex().value();
+  command_pool = std::make_shared<Vulkan::CommandPool>(device, queue_family);
+  recorder = std::make_unique<ParallelRecorder>(device, queue_family, TargetImagesCount());
+  recorded_versions.assign(TargetImagesCount(), 0);
+  image_values.assign(TargetImagesCount(), 0);
+  render_finished_semaphores = std::make_unique<Vulkan::SemaphoreArray>(device);
+  for (size_t i = 0; i < TargetImagesCount(); ++i)
     render_finished_semaphores->Add();
 
-    if (vkCreateFence(device->GetDevice(), &fence_info, nullptr, &exec_fences[i]) != VK_SUCCESS)
-      throw std::runtime_error("failed to create fences!");
-  }
+  gpu_profiler = std::make_unique<GpuProfiler>(device, queue_family, TargetImagesCount(), pipeline_statistics, 8, (uint32_t) max_lods);
+  main_pass = gpu_profiler->AddPass("main");
+  cull_pass = gpu_profiler->AddPass("cull");
+  upscale_pass = gpu_profiler->AddPass("upscale");
 }
 
-void VisualEngine::ReBuildPipelines()
+bool VisualEngine::RecreateSwapchain()
 {
-  std::pair<int32_t, int32_t> size = {0, 0};
-  do
+  // A minimized window has nothing to present to, sleep until the next event instead of spinning.
+  auto size = surface->GetFramebufferSize();
+  const uint64_t render_pass_version = swapchain->GetRenderPassVersion();
+  if (size.first == 0 || size.second == 0 ||
+      !swapchain->Recreate({(uint32_t) size.first, (uint32_t) size.second}, retired, timeline->Submitted()))
   {
-    size = surface->GetFramebufferSize();
     surface->WaitEvents();
-  } while (size.first == 0 || size.second == 0);
-      
-  vkDeviceWaitIdle(device->GetDevice());
+    return false;
+  }
   resize_flag = false;
-  swapchain->ReCreate();
-  render_pass = Vulkan::Helpers::CreateOneSubpassRenderPassMultisamplingDepth(device, swapchain, *render_pass_bufers.get(), (VkSampleCountFlagBits) settings.Multisampling());
+  if (scaled)
+    scaled->Resize(swapchain->GetExtent(), swapchain->GetImagesCount(), retired, timeline->Submitted());
 
-  UpdateCommandBuffers();
-}
+  // Per image state is sized for the first swapchain. Drivers keep the image count across
+  // recreation in practice, one handing out more is rare enough to rebuild behind an idle device.
+  if (swapchain->GetImagesCount() > recorded_versions.size())
+  {
+    {
+      auto queue_lock = uploader->LockQueues();
+      vkDeviceWaitIdle(device->GetDevice());
+    }
+    timeline->Poll();
+    retired.Collect(timeline->Completed());
+    PrepareImageState();
+    PrepareFrameRing();
+    if (gpu_culling)
+      PrepareGpuCulling();
+    WriteFrameRingDescriptors();
+  }
 
+  if (!scaled && swapchain->GetRenderPassVersion() != render_pass_version)
+    RebuildPipeline();
+
+  // Images re-record lazily after their last frame completed, which also covers the old framebuffers.
+  frame_stats.SetInfo("resolution", std::to_string(TargetExtent().width) + "x" + std::to_string(TargetExtent().height));
+  InvalidateCommandBuffers();
+  return true;
+}
@@ -4,12 +4,8 @@
 #include "../VK-nn/Vulkan/Instance.h"
 #include "../VK-nn/Vulkan/Device.h"
 #include "../VK-nn/Vulkan/Surface.h"
-#include "../VK-nn/Vulkan/SwapChain.h"
-#include "../VK-nn/Vulkan/Pipelines.h"
-#include "../VK-nn/Vulkan/RenderPass.h"
 #include "../VK-nn/Vulkan/Descriptors.h"
 #include "../VK-nn/Vulkan/StorageArray.h"
-#include "../VK-nn/Vulkan/ImageArray.h"
 #include "../VK-nn/Vulkan/CommandPool.h"
 #include "../VK-nn/Vulkan/Sampler.h"
 #include "../VK-nn/Vulkan/Fence.h"
@@ -17,6 +13,26 @@
 
 #include "Settings.h"
 #include "TestObject.h"
+#include "FrameRing.h"
+#include "AssetStreamer.h"
+#include "PipelineCache.h"
+#include "GraphicsPipeline.h"
+#include "ParallelRecorder.h"
+#include "GpuProfiler.h"
+#include "FrameStats.h"
+#include "OffscreenTarget.h"
+#include "SwapchainTarget.h"
+#include "RetireQueue.h"
+#include "Simulation.h"
+#include "SceneBvh.h"
+#include "GpuCulling.h"
+#include "MaterialTable.h"
+#include "ScaledTarget.h"
+#include "DynamicResolution.h"
+#include "PipelineVariants.h"
+#include "DeviceAllocator.h"
+#include "RenderGraph.h"
+#include "FrameTimeline.h"
 
 #define GLFW_INCLUDE_VULKAN
 #define GLM_FORCE_RADIANS
@@ -25,62 +41,222 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <memory>
-#include <thread>
+#include <deque>
+#include <filesystem>
 
 struct World 
 {
-  glm::mat4 model;
   glm::mat4 view;
   glm::mat4 proj;
   glm::vec4 light;
+  glm::vec4 texture_lod; // x: finest resident texture mip level
+};
+
+// Per instance data read by the vertex shader through gl_InstanceIndex (std430 layout).
+struct InstanceData
+{
+  glm::mat4 model;
+  glm::vec4 normal[3]; // mat3 normal matrix, one column per element
+  glm::uvec4 material; // x: index into the MaterialTable
+};
+
+// Where one frame's data lives in the frame ring, recorded into the command buffers.
+struct FrameOffsets
+{
+  VkDeviceSize world;
+  VkDeviceSize commands;
+  VkDeviceSize instances;
+  VkDeviceSize cull;
+};
+
+// A run of indirect commands in a frame's command block, the unit the draw list is split by.
+struct DrawBatch
+{
+  VkDeviceSize command_offset; // relative to FrameOffsets::commands
+  uint32_t commands_count;
+  uint32_t features;           // PipelineVariants features, sample shading is added when drawn
+  uint32_t material;           // MaterialTable ID of every instance the batch draws
+};
+
+// Timings of one start, filled once the first frame with assets has been submitted.
+struct StartupStats
+{
+  double first_frame_ms = 0.0;
+  double pipeline_ms = 0.0;
+  bool warm_pipeline_cache = false;
 };
 
 class VisualEngine
 {
 private:
   Settings settings;
+  // Reread once a second when it changed, see ApplySettings for what takes effect at runtime.
+  std::string settings_file = "test.conf";
+  std::filesystem::file_time_type settings_time;
+  std::chrono::steady_clock::time_point settings_check_time;
+  float sample_shading = 0.0f;
 
   std::shared_ptr<Vulkan::Device> device;
-  std::shared_ptr<Vulkan::SwapChain> swapchain;
+  // Shared by every GpuBuffer and attachment. F7 prints its state, F8 defragments it a step per frame.
+  std::shared_ptr<DeviceAllocator> allocator;
+  bool defragmenting = false;
+  static constexpr VkDeviceSize defragment_step = 16 * 1024 * 1024;
   std::shared_ptr<Vulkan::Surface> surface;
-  std::shared_ptr<Vulkan::RenderPass> render_pass;
-  Vulkan::Pipelines pipelines;
+  std::unique_ptr<SwapchainTarget> swapchain;
+  std::unique_ptr<PipelineCache> pipeline_cache;
+  std::unique_ptr<PipelineVariants> pipelines;
+  std::unique_ptr<OffscreenTarget> offscreen;
+  // With dynamic resolution the scene is drawn into scaled and stretched onto the swapchain image.
+  std::unique_ptr<ScaledTarget> scaled;
+  std::unique_ptr<DynamicResolution> resolution;
+  bool headless = false;
+  size_t last_image = 0;
 
-  std::shared_ptr<Vulkan::StorageArray> storage_buffers;
-  std::shared_ptr<Vulkan::ImageArray> render_pass_bufers;
-  std::shared_ptr<Vulkan::Descriptors> descriptors;
   std::shared_ptr<Vulkan::CommandPool> command_pool;
+  std::unique_ptr<ParallelRecorder> recorder;
+  std::vector<DrawBatch> draw_list;
+  // Bumped whenever recorded commands go stale, images re-record lazily when they come up.
+  uint64_t draw_list_version = 1;
+  std::vector<uint64_t> recorded_versions;
+  // Passes of every frame, rebuilt when the set of passes changes.
+  std::unique_ptr<RenderGraph> frame_graph;
+  uint32_t frame_graph_key = 0;
+  std::unique_ptr<GpuProfiler> gpu_profiler;
+  bool pipeline_statistics = false;
+  uint32_t main_pass = 0;
+  uint32_t cull_pass = 0;
+  uint32_t upscale_pass = 0;
+  VkQueue graphics_queue = VK_NULL_HANDLE;
+  std::shared_ptr<UploadManager> uploader;
+
+  VkDescriptorSetLayout descriptor_set_layout = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+  VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+  // Set 1, every texture and material, bound once with the frame data.
+  std::unique_ptr<MaterialTable> material_table;
+  uint32_t girl_material = 0;
 
   std::unique_ptr<TestObject> girl;
+  std::vector<glm::mat4> objects;
+  std::unique_ptr<FrameRing> frame_ring;
+  std::vector<FrameOffsets> frame_offsets;
+  std::vector<uint32_t> lod_instances;
+  std::vector<uint8_t> instance_lods;
+  // Objects are culled against a BVH over their world boxes, refitted when the object transform changes.
+  SceneBvh scene_bvh;
+  glm::mat4 bvh_transform = glm::mat4(1.0f);
+  std::vector<uint32_t> visible_objects;
+  CullStats cull_stats;
+  CullStats cull_totals;
+  size_t cull_frames = 0;
+  // --gpu-culling moves culling, LOD selection and instance writes into a compute pass.
+  bool use_gpu_culling = false;
+  std::unique_ptr<GpuCulling> gpu_culling;
+  static constexpr size_t max_lods = 8;
+
+  std::unique_ptr<AssetStreamer> streamer;
+  std::deque<std::pair<uint32_t, uint64_t>> pending_mips;
+  float resident_mip = -1.0f;
+  bool model_loaded = false;
+  bool model_resident = false;
+  bool drawing = false;
   
-  size_t frames_in_pipeline = 0;
-  size_t current_frame = 0;
-  std::chrono::_V2::system_clock::time_point priv_frame_time;
-  std::thread event_handler_thread;
+  std::chrono::steady_clock::time_point start_time;
+  StartupStats startup_stats;
+  bool exit_after_first_frame = false;
+
+  FrameStats frame_stats;
+  size_t acquire_phase = 0;
+  size_t update_phase = 0;
+  size_t cull_phase = 0;
+  size_t record_phase = 0;
+  size_t submit_phase = 0;
+  size_t present_phase = 0;
+  std::vector<size_t> gpu_pass_series;
+  std::filesystem::path profile_output;
+  std::chrono::steady_clock::time_point title_time;
+
+  std::unique_ptr<Simulation> simulation;
   std::string exec_directory = "";
  
+  // Acquire semaphores per frame in flight, up to max_frames_in_flight, and present semaphores
+  // per target image: an image is acquired again only after its last present was queued.
   std::unique_ptr<Vulkan::SemaphoreArray> image_available_semaphores;
   std::unique_ptr<Vulkan::SemaphoreArray> render_finished_semaphores;
-  std::vector<VkFence> exec_fences;
-  std::vector<VkFence> in_process;
+  size_t max_frames_in_flight = 0;
+  // Frames are numbered on submission, image_values remember the last frame drawn into each
+  // image. Objects replaced while frames were in flight wait in retired until they complete.
+  std::unique_ptr<FrameTimeline> timeline;
+  std::vector<uint64_t> image_values;
+  RetireQueue retired;
+  // Input is read when events are polled, a frame's latency runs from the poll it sampled to
+  // the completion of its submission, as far as the timeline has seen it.
+  std::chrono::steady_clock::time_point input_time;
+  std::deque<std::pair<uint64_t, std::chrono::steady_clock::time_point>> latency_frames;
+  size_t latency_series = 0;
+
+  glm::vec3 camera_eye = {10.0f, 10.0f, 10.0f};
+  glm::vec3 camera_target = {0.0f, 1.0f, 0.0f};
+  float scene_radius = 0.0f;
 
-  bool resize_flag;
-  bool up_key_down = false;
-  bool down_key_down = false;
-  bool left_key_down = false;
-  bool right_key_down = false;
+  bool resize_flag = false;
 
-  void UpdateCommandBuffers();
+  // The swapchain or, in headless mode, the offscreen images frames are rendered into. With dynamic
+  // resolution the scaled images take the swapchain's place, at their current render extent.
+  VkExtent2D TargetExtent() const { return offscreen ? offscreen->GetExtent() : scaled ? scaled->GetRenderExtent() : swapchain->GetExtent(); }
+  size_t TargetImagesCount() const { return offscreen ? offscreen->GetImagesCount() : swapchain->GetImagesCount(); }
+  VkRenderPass TargetRenderPass() const { return offscreen ? offscreen->GetRenderPass() : scaled ? scaled->GetRenderPass() : swapchain->GetRenderPass(); }
+  VkFramebuffer TargetFrameBuffer(const size_t image_index) const
+  {
+    return offscreen ? offscreen->GetFrameBuffer(image_index) : scaled ? scaled->GetFrameBuffer(image_index) : swapchain->GetFrameBuffer(image_index);
+  }
+  VkSampleCountFlagBits TargetSamplesCount() const
+  {
+    return offscreen ? offscreen->GetSamplesCount() : scaled ? scaled->GetSamplesCount() : swapchain->GetSamplesCount();
+  }
+
+  void InvalidateCommandBuffers() { ++draw_list_version; }
+  uint32_t DrawFeatures() const;
+  uint32_t VariantFeatures(const DrawBatch &batch) const { return batch.features | (sample_shading > 0.0f ? PipelineVariants::SampleShading : 0); }
+  void BuildFrameGraph();
+  void RecordCommandBuffer(const size_t image_index);
+  void RecordMainPass(const VkCommandBuffer command_buffer, const size_t image_index);
+  void RecordDrawRange(const VkCommandBuffer command_buffer, const size_t image_index, const size_t begin, const size_t end);
+  void PrepareObjects();
+  void PreparePipeline();
+  void RebuildPipeline();
+  void ReloadSettings();
+  void ApplySettings(const Settings &loaded);
+  void ApplyQuality(const VkSampleCountFlagBits samples, const float shading);
+  void EnableDynamicResolution(const bool enable);
+  void UpdateStreaming();
+  void DefragmentMemory();
+  void OnAssetsResident();
+  void UpdateSceneBounds(const glm::mat4 &object_transform);
+  void CullObjects(const World &world, const glm::mat4 &object_transform);
+  void UpdateInstances(const FrameOffsets &offsets, const World &world, const glm::mat4 &object_transform);
+  void UpdateCullParams(const FrameOffsets &offsets, const World &world, const glm::mat4 &object_transform);
+  void PrepareGpuCulling();
+  FrameOffsets AllocateFrame(const size_t image_index);
+  void PrepareFrameRing();
+  void PrepareDescriptors();
+  void WriteFrameRingDescriptors();
+  void PrepareImageState();
   void DrawFrame();
   void EventHadler();
   void PrepareShaders();
   void PrepareWindow();
   void PrepareSyncPrimitives();
-  void ReBuildPipelines();
+  size_t FramesInFlight() const { return std::clamp<size_t>(settings.FramesInFlight(), 1, max_frames_in_flight); }
+  void RecordLatency();
+  bool RecreateSwapchain();
   void UpdateWorldUniformBuffers(uint32_t image_index);
+  void CollectGpuTimings(const uint32_t image_index);
+  void UpdateWindowTitle();
 
   static void FrameBufferResizeCallback(GLFWwindow* window, int width, int height);  
   static void KeyboardCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -91,6 +267,20 @@ public:
   VisualEngine(const VisualEngine &obj) = delete;
   VisualEngine& operator= (const VisualEngine &obj) = delete;
   void Start();
+  StartupStats GetStartupStats() const { return startup_stats; }
+
+  // Headless runs (--headless) render into offscreen images and are driven frame by frame.
+  bool IsHeadless() const { return headless; }
+  // Draws until every asset, including the finest texture level, is resident.
+  void WaitForAssets();
+  void RenderFrame() { DrawFrame(); }
+  void SetCamera(const glm::vec3 &eye, const glm::vec3 &target);
+  // Radius around the origin that holds every object, valid once assets are resident.
+  float GetSceneRadius() const { return scene_radius; }
+  VkExtent2D GetFrameExtent() const { return TargetExtent(); }
+  // RGBA8 pixels of the last submitted frame, headless only.
+  bool ReadFrame(std::vector<uint8_t> &pixels);
+  FrameStats &GetFrameStats() { return frame_stats; }
   ~VisualEngine();
 };
 
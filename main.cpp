@@ -1,13 +1,57 @@
 #include <iostream>
+#include <string>
 #include "VisualEngine/engine.h"
+#include "VisualEngine/MeshCache.h"
+#include "VisualEngine/Benchmark.h"
+#include "VisualEngine/TextureCompressor.h"
 
 int main(int argc, char const *argv[])
 {
   try
   {
+    if (argc > 2 && std::string(argv[1]) == "--build-mesh-cache")
+    {
+      for (int i = 2; i < argc; ++i)
+      {
+        std::filesystem::path obj_file = argv[i];
+        if (!MeshCache::Build(obj_file, obj_file.parent_path()))
+        {
+          std::cerr << "Failed to build mesh cache for " << obj_file << '\n';
+          return 1;
+        }
+      }
+      return 0;
+    }
+
+    if (argc > 3 && std::string(argv[1]) == "--compress-texture")
+    {
+      TextureCompressor::Format format = TextureCompressor::Format::BC7;
+      if (argc > 4 && !TextureCompressor::ParseFormat(argv[4], format))
+      {
+        std::cerr << "Unknown texture format " << argv[4] << ", expected bc1, bc3, bc5 or bc7\n";
+        return 1;
+      }
+      const bool generate_mips = argc > 5 && std::string(argv[5]) == "mips";
+      if (!TextureCompressor::CompressFile(argv[2], argv[3], format, generate_mips, format != TextureCompressor::Format::BC5))
+      {
+        std::cerr << "Failed to compress " << argv[2] << '\n';
+        return 1;
+      }
+      return 0;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--bench-obj-import")
+      return Benchmark::ObjImport(argv[2]);
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-startup")
+      return Benchmark::Startup(argc, argv);
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-headless")
+      return Benchmark::Headless(argc, argv);
+
     VisualEngine engine(argc, argv);
     engine.Start();
-  } 
+  }
   catch(const std::exception& e)
   {
     std::cerr << e.what() << '\n';